@@ -1,4 +1,6 @@
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #ifndef _WIN32
 #define MM_API __attribute__((visibility ("default")))
 #else
@@ -7,19 +9,153 @@
 #include "midimonster.h"
 #include "backend.h"
 
+/*
+ * Slab storage for core structures. Elements are allocated from blocks
+ * growing geometrically in size, so element addresses stay stable while
+ * the number of allocations stays logarithmic.
+ */
+typedef struct /*_mm_slab*/ {
+	size_t element;
+	size_t base;
+	size_t elements;
+	size_t blocks;
+	uint8_t** block;
+	memory_account* account;
+} slab;
+
+/* Handling of events exceeding the per-instance event budget */
+typedef enum /*_mm_overload_policy*/ {
+	overload_coalesce = 0,
+	overload_drop_oldest,
+	overload_shed
+} overload_policy;
+
+/* Core-private instance storage, the public instance structure must be the first member */
+typedef struct /*_mm_instance_store*/ {
+	instance inst;
+	slab channels;
+	//open-addressed channel lookup table by ident, sized to a power of two
+	size_t index_alloc;
+	channel** index;
+	//number of events and delivery offset while partitioning a notification batch
+	size_t pending;
+	size_t offset;
+
+	size_t budget;
+	overload_policy overload;
+	uint64_t coalesced;
+	uint64_t dropped;
+	uint64_t warning;
+	//coalesced events exceeding the budget, delivered in the next round
+	size_t deferred;
+	size_t deferred_alloc;
+	channel** deferred_channel;
+	channel_value* deferred_value;
+
+	//position in the instance list, identifying the instance in traces
+	size_t position;
+
+	//memory allocated for the instance and reported for memory managed by the backend itself
+	memory_account memory;
+	memory_account external;
+
+	latency_class latency;
+} instance_store;
+
+/* Core-private channel properties, indexed by channel id */
+typedef struct /*_mm_channel_info*/ {
+	//latency class (+1), 0 for channels using their instance class
+	uint8_t latency;
+	//number of vector components, 0 for scalar channels
+	uint8_t components;
+	//native integer resolution in bits, 0 if not declared
+	uint8_t resolution;
+} channel_info;
+
+/* Core-private backend data, allocated separately since the backend array may move */
+typedef struct /*_mm_backend_store*/ {
+	memory_account memory;
+	latency_class latency;
+} backend_store;
+
+#define SLAB_INIT(type, count) {.element = sizeof(type), .base = (count)}
+#define SLAB_BLOCK(s, b) ((s)->base << (b))
+#define INSTANCE_CHANNELS(i) (&(((instance_store*) (i))->channels))
+
 static size_t nbackends = 0;
 static backend* backends = NULL;
+static backend_store** backend_data = NULL;
+static size_t nchannels = 0;
 static size_t ninstances = 0;
+static size_t instances_alloc = 0;
 static instance** instances = NULL;
-static size_t nchannels = 0;
-static channel** channels = NULL;
+/* Instances in delivery order, sorted by latency class when starting */
+static instance** schedule = NULL;
+static slab instance_slab = SLAB_INIT(instance_store, 8);
+
+static size_t info_alloc = 0;
+static channel_info* info = NULL;
+
+/* Notification batch reordered by destination instance */
+static size_t notify_alloc = 0;
+static channel** notify_channel = NULL;
+static channel_value* notify_value = NULL;
+/* Number of events deferred by all instances */
+static size_t deferred_events = 0;
+
+/* Per-channel markers used while coalescing events, indexed by channel id */
+static size_t marks_alloc = 0;
+static uint64_t* mark = NULL;
+static uint64_t mark_stamp = 0;
+
+static void* slab_alloc(slab* s){
+	size_t capacity = s->base * (((size_t) 1 << s->blocks) - 1);
+	uint8_t** new_block = NULL;
+
+	//all blocks full, allocate the next one
+	if(s->elements == capacity){
+		new_block = memory_realloc(s->account, s->block, (s->blocks + 1) * sizeof(uint8_t*));
+		if(!new_block){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		s->block = new_block;
 
-int backends_handle(size_t nfds, managed_fd* fds){
+		s->block[s->blocks] = memory_calloc(s->account, SLAB_BLOCK(s, s->blocks), s->element);
+		if(!s->block[s->blocks]){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		s->blocks++;
+		capacity += SLAB_BLOCK(s, s->blocks - 1);
+	}
+
+	//the new element is located in the last block
+	s->elements++;
+	return s->block[s->blocks - 1] + (SLAB_BLOCK(s, s->blocks - 1) - (capacity - s->elements) - 1) * s->element;
+}
+
+static void slab_free(slab* s){
+	size_t u;
+	for(u = 0; u < s->blocks; u++){
+		memory_free(s->block[u]);
+	}
+	memory_free(s->block);
+	s->block = NULL;
+	s->blocks = 0;
+	s->elements = 0;
+}
+
+int backends_handle(size_t nfds, managed_fd* fds, latency_class class){
 	size_t u, p, n;
 	int rv = 0;
 	managed_fd xchg;
 
 	for(u = 0; u < nbackends && !rv; u++){
+		if(backend_data[u]->latency != class){
+			continue;
+		}
+
 		n = 0;
 
 		for(p = 0; p < nfds; p++){
@@ -32,7 +168,11 @@ int backends_handle(size_t nfds, managed_fd* fds){
 		}
 
 		DBGPF("Notifying backend %s of %lu waiting FDs\n", backends[u].name, n);
+		mm_trace(mm_trace_process_enter, u, n);
+		memory_owner(&backend_data[u]->memory);
 		rv |= backends[u].process(n, fds);
+		memory_owner(NULL);
+		mm_trace(mm_trace_process_exit, u, n);
 		if(rv){
 			fprintf(stderr, "Backend %s failed to handle input\n", backends[u].name);
 		}
@@ -40,86 +180,509 @@ int backends_handle(size_t nfds, managed_fd* fds){
 	return rv;
 }
 
+int instance_configure(instance* inst, char* option, char* value){
+	instance_store* store = (instance_store*) inst;
+
+	if(!strcmp(option, "budget")){
+		store->budget = strtoul(value, NULL, 10);
+		return 0;
+	}
+	else if(!strcmp(option, "overload")){
+		if(!strcmp(value, "coalesce")){
+			store->overload = overload_coalesce;
+		}
+		else if(!strcmp(value, "drop-oldest")){
+			store->overload = overload_drop_oldest;
+		}
+		else if(!strcmp(value, "shed")){
+			store->overload = overload_shed;
+		}
+		else{
+			fprintf(stderr, "Unknown overload policy %s\n", value);
+			return 1;
+		}
+		return 0;
+	}
+
+	else if(!strcmp(option, "latency")){
+		return latency_parse(value, &store->latency);
+	}
+
+	fprintf(stderr, "Unknown core instance option %s\n", option);
+	return 1;
+}
+
+int latency_parse(char* name, latency_class* class){
+	latency_class u;
+	for(u = 0; u < latency_classes; u++){
+		if(!strcmp(name, latency_name(u))){
+			*class = u;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "Unknown latency class %s\n", name);
+	return 1;
+}
+
+char* latency_name(latency_class class){
+	switch(class){
+		case latency_realtime:
+			return "realtime";
+		case latency_normal:
+			return "normal";
+		case latency_bulk:
+			return "bulk";
+		default:
+			return "unknown";
+	}
+}
+
+//grow the channel property store to cover a channel
+static channel_info* channel_properties(channel* c){
+	size_t alloc = info_alloc;
+	channel_info* new_info = NULL;
+
+	if(!c->id){
+		return NULL;
+	}
+
+	if(c->id >= info_alloc){
+		for(alloc = max(info_alloc, 64); alloc <= c->id; alloc *= 2){
+		}
+
+		new_info = memory_realloc(memory_core(memory_routing), info, alloc * sizeof(channel_info));
+		if(!new_info){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		memset(new_info + info_alloc, 0, (alloc - info_alloc) * sizeof(channel_info));
+		info = new_info;
+		info_alloc = alloc;
+	}
+	return info + c->id;
+}
+
+int channel_latency_set(channel* c, latency_class class){
+	channel_info* properties = NULL;
+
+	if(!c->id){
+		fprintf(stderr, "Latency classes can not be applied to channels not managed by the core\n");
+		return 1;
+	}
+
+	properties = channel_properties(c);
+	if(!properties){
+		return 1;
+	}
+	properties->latency = class + 1;
+	return 0;
+}
+
+latency_class channel_latency(channel* c){
+	//classes assigned to the channel take precedence over the instance class
+	if(c->id && c->id < info_alloc && info[c->id].latency){
+		return info[c->id].latency - 1;
+	}
+	return ((instance_store*) c->instance)->latency;
+}
+
+MM_API int mm_channel_components(channel* c, uint8_t components){
+	channel_info* properties = NULL;
+
+	if(!c->id || components > MM_VECTOR_COMPONENTS){
+		fprintf(stderr, "Invalid vector channel on instance %s (%u components)\n", c->instance->name, components);
+		return 1;
+	}
+
+	properties = channel_properties(c);
+	if(!properties){
+		return 1;
+	}
+	properties->components = (components > 1) ? components : 0;
+	return 0;
+}
+
+MM_API int mm_channel_resolution(channel* c, uint8_t bits){
+	channel_info* properties = NULL;
+
+	if(!c->id || bits > 32){
+		fprintf(stderr, "Invalid channel resolution on instance %s (%u bits)\n", c->instance->name, bits);
+		return 1;
+	}
+
+	properties = channel_properties(c);
+	if(!properties){
+		return 1;
+	}
+	properties->resolution = bits;
+	return 0;
+}
+
+static uint8_t channel_resolution(channel* c){
+	return (c->id && c->id < info_alloc) ? info[c->id].resolution : 0;
+}
+
+//raw values are only passed through unchanged between channels of equal shape and resolution
+int channel_needs_conversion(channel* from, channel* to){
+	return channel_components(from) != channel_components(to)
+		|| (channel_resolution(to) && channel_resolution(from) != channel_resolution(to));
+}
+
+uint8_t channel_components(channel* c){
+	if(c->id && c->id < info_alloc && info[c->id].components){
+		return info[c->id].components;
+	}
+	return 1;
+}
+
+void channel_convert(channel* from, channel* to, channel_value* v){
+	uint8_t u, source = channel_components(from), target = channel_components(to), resolution = channel_resolution(to);
+	uint16_t first;
+
+	if(source == target){
+		//scalar channels of differing resolution
+		if(resolution){
+			v->raw.u64 = clamp(v->normalised, 1.0, 0.0) * (double) ((1ull << resolution) - 1) + 0.5;
+		}
+	}
+	else if(source == 1){
+		//apply scalar values to all components
+		first = clamp(v->normalised, 1.0, 0.0) * 65535.0 + 0.5;
+		for(u = 0; u < MM_VECTOR_COMPONENTS; u++){
+			v->raw.component[u] = (u < target) ? first : 0;
+		}
+	}
+	else if(target == 1){
+		//scalar targets receive the first component
+		v->raw.u64 = resolution ? (clamp(v->normalised, 1.0, 0.0) * (double) ((1ull << resolution) - 1) + 0.5) : v->raw.component[0];
+	}
+	else{
+		//components missing in the source are cleared
+		for(u = min(source, target); u < MM_VECTOR_COMPONENTS; u++){
+			v->raw.component[u] = 0;
+		}
+	}
+}
+
+//reduce the events for one instance to the latest value per channel, preserving their order
+static size_t instance_coalesce(size_t n, channel** c, channel_value* v){
+	size_t p, keep = 0, alloc = marks_alloc;
+	uint64_t* new_mark = NULL;
+
+	if(nchannels >= marks_alloc){
+		for(alloc = max(marks_alloc, 64); alloc <= nchannels; alloc *= 2){
+		}
+
+		new_mark = memory_realloc(memory_core(memory_events), mark, alloc * sizeof(uint64_t));
+		if(!new_mark){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return n;
+		}
+		memset(new_mark + marks_alloc, 0, (alloc - marks_alloc) * sizeof(uint64_t));
+		mark = new_mark;
+		marks_alloc = alloc;
+	}
+
+	mark_stamp++;
+	for(p = n; p > 0; p--){
+		if(!c[p - 1]->id){
+			continue;
+		}
+
+		if(mark[c[p - 1]->id] == mark_stamp){
+			//a later event for this channel exists
+			c[p - 1] = NULL;
+			continue;
+		}
+		mark[c[p - 1]->id] = mark_stamp;
+	}
+
+	for(p = 0; p < n; p++){
+		if(c[p]){
+			c[keep] = c[p];
+			v[keep] = v[p];
+			keep++;
+		}
+	}
+	return keep;
+}
+
+//store events exceeding the budget of an instance for delivery in the next round
+static int instance_defer(instance_store* store, size_t n, channel** c, channel_value* v){
+	size_t alloc = store->deferred_alloc;
+	channel** new_channel = NULL;
+	channel_value* new_value = NULL;
+
+	if(n > store->deferred_alloc){
+		for(alloc = max(store->deferred_alloc, 64); alloc < n; alloc *= 2){
+		}
+
+		new_channel = memory_realloc(memory_core(memory_events), store->deferred_channel, alloc * sizeof(channel*));
+		new_value = new_channel ? memory_realloc(memory_core(memory_events), store->deferred_value, alloc * sizeof(channel_value)) : NULL;
+		if(!new_channel || !new_value){
+			fprintf(stderr, "Failed to allocate memory\n");
+			store->deferred_channel = new_channel ? new_channel : store->deferred_channel;
+			return 1;
+		}
+		store->deferred_channel = new_channel;
+		store->deferred_value = new_value;
+		store->deferred_alloc = alloc;
+	}
+
+	memcpy(store->deferred_channel, c, n * sizeof(channel*));
+	memcpy(store->deferred_value, v, n * sizeof(channel_value));
+	store->deferred = n;
+	deferred_events += n;
+	return 0;
+}
+
+//keep the events for the most urgent channels, dropping the newest events of the least urgent latency class first
+static void instance_shed(instance_store* store, size_t n, channel** c, channel_value* v){
+	size_t p, keep = 0, remaining = store->budget, quota[latency_classes] = {0};
+	latency_class class;
+
+	for(p = 0; p < n; p++){
+		quota[channel_latency(c[p])]++;
+	}
+
+	for(class = latency_realtime; class < latency_classes; class++){
+		quota[class] = min(quota[class], remaining);
+		remaining -= quota[class];
+	}
+
+	for(p = 0; p < n; p++){
+		class = channel_latency(c[p]);
+		if(quota[class]){
+			quota[class]--;
+			c[keep] = c[p];
+			v[keep] = v[p];
+			keep++;
+		}
+	}
+}
+
+//apply the event budget of an instance to the events pending for it
+static size_t instance_overload(instance_store* store, size_t n, channel** c, channel_value* v){
+	size_t pending = n;
+
+	switch(store->overload){
+		case overload_coalesce:
+			n = instance_coalesce(n, c, v);
+			store->coalesced += pending - n;
+			//the remaining events carry the latest values of distinct channels and must not be lost
+			if(n > store->budget){
+				if(instance_defer(store, n - store->budget, c + store->budget, v + store->budget)){
+					store->dropped += n - store->budget;
+				}
+			}
+			break;
+		case overload_drop_oldest:
+			memmove(c, c + (n - store->budget), store->budget * sizeof(channel*));
+			memmove(v, v + (n - store->budget), store->budget * sizeof(channel_value));
+			store->dropped += n - store->budget;
+			break;
+		case overload_shed:
+			instance_shed(store, n, c, v);
+			store->dropped += n - store->budget;
+			break;
+	}
+
+	if(n > store->budget){
+		n = store->budget;
+		if(mm_timestamp() - store->warning > 1000){
+			fprintf(stderr, "Instance %s overloaded with %" PRIsize_t " pending events (budget %" PRIsize_t "), %" PRIsize_t " events deferred, %" PRIu64 " dropped so far\n",
+					store->inst.name, pending, store->budget, store->deferred, store->dropped);
+			store->warning = mm_timestamp();
+		}
+	}
+	return n;
+}
+
+int backends_deferred(){
+	return deferred_events ? 1 : 0;
+}
+
 int backends_notify(size_t nev, channel** c, channel_value* v){
-	size_t u, p, n;
+	size_t u, p, n, offset = 0, total = nev + deferred_events;
 	int rv = 0;
-	channel_value xval;
-	channel* xchnl;
+	instance_store* store = NULL;
+	//the delivery schedule is built on start, use the creation order until then
+	instance** order = schedule ? schedule : instances;
+	channel** new_channel = NULL;
+	channel_value* new_value = NULL;
+
+	if(total > notify_alloc){
+		new_channel = memory_realloc(memory_core(memory_events), notify_channel, max(total, notify_alloc * 2) * sizeof(channel*));
+		new_value = new_channel ? memory_realloc(memory_core(memory_events), notify_value, max(total, notify_alloc * 2) * sizeof(channel_value)) : NULL;
+		if(!new_channel || !new_value){
+			fprintf(stderr, "Failed to allocate memory\n");
+			notify_channel = new_channel ? new_channel : notify_channel;
+			return 1;
+		}
+		notify_channel = new_channel;
+		notify_value = new_value;
+		notify_alloc = max(total, notify_alloc * 2);
+	}
+
+	//partition the batch by instance in linear time, keeping the event order per instance
+	for(p = 0; p < nev; p++){
+		((instance_store*) c[p]->instance)->pending++;
+	}
+
+	for(u = 0; u < ninstances; u++){
+		store = (instance_store*) order[u];
+		store->offset = offset;
+
+		//events deferred in the previous round precede the new events
+		if(store->deferred){
+			memcpy(notify_channel + offset, store->deferred_channel, store->deferred * sizeof(channel*));
+			memcpy(notify_value + offset, store->deferred_value, store->deferred * sizeof(channel_value));
+			store->offset += store->deferred;
+			store->pending += store->deferred;
+			store->deferred = 0;
+		}
+		offset += store->pending;
+	}
+	deferred_events = 0;
+
+	for(p = 0; p < nev; p++){
+		store = (instance_store*) c[p]->instance;
+		notify_channel[store->offset] = c[p];
+		notify_value[store->offset] = v[p];
+		store->offset++;
+	}
 
 	//TODO eliminate duplicates
 	for(u = 0; u < ninstances && !rv; u++){
-		n = 0;
+		store = (instance_store*) order[u];
+		n = store->pending;
+		c = notify_channel + store->offset - n;
+		v = notify_value + store->offset - n;
+		store->pending = 0;
 
-		for(p = 0; p < nev; p++){
-			if(c[p]->instance == instances[u]){
-				xval = v[n];
-				xchnl = c[n];
-				
-				v[n] = v[p];
-				c[n] = c[p];
+		if(store->budget && n > store->budget){
+			n = instance_overload(store, n, c, v);
+		}
 
-				v[p] = xval;
-				c[p] = xchnl;
-				n++;
+		DBGPF("Calling handler for instance %s with %lu events\n", order[u]->name, n);
+		mm_trace(mm_trace_handle_enter, store->position, n);
+		memory_owner(&store->memory);
+		rv |= order[u]->backend->handle(order[u], n, c, v);
+		memory_owner(NULL);
+		mm_trace(mm_trace_handle_exit, store->position, n);
+	}
+
+	//reset the counters of instances skipped after a failed handler
+	for(; u < ninstances; u++){
+		((instance_store*) order[u])->pending = 0;
+	}
+
+	return 0;
+}
+
+//spread the channel identifiers over the lookup table
+static size_t channel_slot(uint64_t ident, size_t alloc){
+	uint64_t hash = ident * 0x9E3779B97F4A7C15ull;
+	return (hash ^ (hash >> 32)) & (alloc - 1);
+}
+
+static int channel_index_build(instance_store* store, size_t alloc){
+	size_t b, u, n, slot;
+	channel* chan = NULL;
+	channel** index = memory_calloc(&store->memory, alloc, sizeof(channel*));
+
+	if(!index){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	for(b = 0, n = 0; b < store->channels.blocks; b++){
+		chan = (channel*) store->channels.block[b];
+		for(u = 0; u < SLAB_BLOCK(&store->channels, b) && n < store->channels.elements; u++, n++){
+			for(slot = channel_slot(chan[u].ident, alloc); index[slot]; slot = (slot + 1) & (alloc - 1)){
 			}
+			index[slot] = chan + u;
 		}
-
-		DBGPF("Calling handler for instance %s with %lu events\n", instances[u]->name, n);
-		rv |= instances[u]->backend->handle(instances[u], n, c, v);
 	}
 
+	memory_free(store->index);
+	store->index = index;
+	store->index_alloc = alloc;
 	return 0;
 }
 
 MM_API channel* mm_channel(instance* inst, uint64_t ident, uint8_t create){
-	size_t u;
-	for(u = 0; u < nchannels; u++){
-		if(channels[u]->instance == inst && channels[u]->ident == ident){
-			DBGPF("Requested channel %lu on instance %s already exists, reusing\n", ident, inst->name);
-			return channels[u];
+	size_t slot;
+	instance_store* data = (instance_store*) inst;
+	slab* store = INSTANCE_CHANNELS(inst);
+	channel* chan = NULL;
+
+	if(data->index_alloc){
+		for(slot = channel_slot(ident, data->index_alloc); data->index[slot]; slot = (slot + 1) & (data->index_alloc - 1)){
+			if(data->index[slot]->ident == ident){
+				DBGPF("Requested channel %" PRIu64 " on instance %s already exists, reusing\n", ident, inst->name);
+				return data->index[slot];
+			}
 		}
 	}
 
 	if(!create){
-		DBGPF("Requested unknown channel %lu on instance %s\n", ident, inst->name);
+		DBGPF("Requested unknown channel %" PRIu64 " on instance %s\n", ident, inst->name);
 		return NULL;
 	}
 
-	DBGPF("Creating previously unknown channel %lu on instance %s\n", ident, inst->name);
-	channel** new_chan = realloc(channels, (nchannels + 1) * sizeof(channel*));
-	if(!new_chan){
-		fprintf(stderr, "Failed to allocate memory\n");
-		nchannels = 0;
+	DBGPF("Creating previously unknown channel %" PRIu64 " on instance %s\n", ident, inst->name);
+	//keep the lookup table at most half full
+	if(2 * (store->elements + 1) > data->index_alloc
+			&& channel_index_build(data, data->index_alloc ? data->index_alloc * 2 : 32)){
 		return NULL;
 	}
 
-	channels = new_chan;
-	channels[nchannels] = calloc(1, sizeof(channel));
-	if(!channels[nchannels]){
-		fprintf(stderr, "Failed to allocate memory\n");
+	chan = slab_alloc(store);
+	if(!chan){
 		return NULL;
 	}
 
-	channels[nchannels]->instance = inst;
-	channels[nchannels]->ident = ident;
-	return channels[nchannels++];
+	chan->instance = inst;
+	chan->ident = ident;
+	for(slot = channel_slot(ident, data->index_alloc); data->index[slot]; slot = (slot + 1) & (data->index_alloc - 1)){
+	}
+	data->index[slot] = chan;
+	//dense channel identifiers start at 1, 0 marks channels not known to the core
+	chan->id = ++nchannels;
+	return chan;
 }
 
 MM_API instance* mm_instance(){
-	instance** new_inst = realloc(instances, (ninstances + 1) * sizeof(instance*));
-	if(!new_inst){
-		//TODO free
-		fprintf(stderr, "Failed to allocate memory\n");
-		ninstances = 0;
-		return NULL;
+	instance_store* store = NULL;
+	instance** new_inst = NULL;
+
+	//grow the instance index geometrically
+	if(ninstances == instances_alloc){
+		new_inst = memory_realloc(memory_core(memory_instances), instances, (instances_alloc ? instances_alloc * 2 : 8) * sizeof(instance*));
+		if(!new_inst){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		instances = new_inst;
+		instances_alloc = instances_alloc ? instances_alloc * 2 : 8;
 	}
-	instances = new_inst;
-	instances[ninstances] = calloc(1, sizeof(instance));
-	if(!instances[ninstances]){
-		fprintf(stderr, "Failed to allocate memory\n");
+
+	instance_slab.account = memory_core(memory_instances);
+	store = slab_alloc(&instance_slab);
+	if(!store){
 		return NULL;
 	}
 
+	store->channels.element = sizeof(channel);
+	store->channels.base = 16;
+	store->channels.account = &store->memory;
+	store->latency = latency_normal;
+	store->position = ninstances;
+	//charge the remaining allocations of the creating backend to the new instance
+	memory_owner(&store->memory);
+	instances[ninstances] = &(store->inst);
 	return instances[ninstances++];
 }
 
@@ -168,29 +731,71 @@ MM_API int mm_backend_instances(char* name, size_t* ninst, instance*** inst){
 
 void instances_free(){
 	size_t u;
+	instance_store* store = NULL;
 	for(u = 0; u < ninstances; u++){
+		store = (instance_store*) instances[u];
+		if(store->coalesced || store->dropped){
+			fprintf(stderr, "Instance %s coalesced %" PRIu64 " and dropped %" PRIu64 " events due to overload\n", store->inst.name, store->coalesced, store->dropped);
+		}
+		memory_free(store->deferred_channel);
+		memory_free(store->deferred_value);
+
 		free(instances[u]->name);
 		instances[u]->name = NULL;
 		instances[u]->backend = NULL;
-		free(instances[u]);
 		instances[u] = NULL;
 	}
-	free(instances);
-	ninstances = 0;
+	memory_free(instances);
+	instances = NULL;
+	memory_free(schedule);
+	schedule = NULL;
+	ninstances = instances_alloc = 0;
+	slab_free(&instance_slab);
+
+	//backend accounts are kept until all memory charged to them has been released
+	for(u = 0; backend_data && backend_data[u]; u++){
+		free(backend_data[u]);
+	}
+	free(backend_data);
+	backend_data = NULL;
 }
 
 void channels_free(){
-	size_t u;
-	for(u = 0; u < nchannels; u++){
-		DBGPF("Destroying channel %lu on instance %s\n", channels[u]->ident, channels[u]->instance->name);
-		if(channels[u]->impl){
-			channels[u]->instance->backend->channel_free(channels[u]);
+	size_t u, b, p, n;
+	slab* store = NULL;
+	channel* chan = NULL;
+
+	for(u = 0; u < ninstances; u++){
+		store = INSTANCE_CHANNELS(instances[u]);
+		for(b = 0, n = 0; b < store->blocks; b++){
+			chan = (channel*) store->block[b];
+			for(p = 0; p < SLAB_BLOCK(store, b) && n < store->elements; p++, n++){
+				DBGPF("Destroying channel %" PRIu64 " on instance %s\n", chan[p].ident, instances[u]->name);
+				if(chan[p].impl){
+					instances[u]->backend->channel_free(chan + p);
+				}
+			}
 		}
-		free(channels[u]);
-		channels[u] = NULL;
+		slab_free(store);
+		memory_free(((instance_store*) instances[u])->index);
+		((instance_store*) instances[u])->index = NULL;
+		((instance_store*) instances[u])->index_alloc = 0;
 	}
-	free(channels);
 	nchannels = 0;
+
+	memory_free(notify_channel);
+	memory_free(notify_value);
+	notify_channel = NULL;
+	notify_value = NULL;
+	notify_alloc = 0;
+
+	memory_free(mark);
+	mark = NULL;
+	marks_alloc = 0;
+
+	memory_free(info);
+	info = NULL;
+	info_alloc = 0;
 }
 
 backend* backend_match(char* name){
@@ -217,9 +822,16 @@ struct timeval backend_timeout(){
 	size_t u;
 	uint32_t res, secs = 1, msecs = 0;
 
+	//deliver deferred events without waiting
+	if(deferred_events){
+		secs = 0;
+	}
+
 	for(u = 0; u < nbackends; u++){
 		if(backends[u].interval){
+			memory_owner(&backend_data[u]->memory);
 			res = backends[u].interval();
+			memory_owner(NULL);
 			if((res / 1000) < secs){
 				secs = res / 1000;
 				msecs = res % 1000;
@@ -246,6 +858,21 @@ MM_API int mm_backend_register(backend b){
 			return 1;
 		}
 		backends[nbackends] = b;
+
+		//the backend data list is kept NULL-terminated for teardown
+		backend_data = realloc(backend_data, (nbackends + 2) * sizeof(backend_store*));
+		if(!backend_data){
+			fprintf(stderr, "Failed to allocate memory\n");
+			nbackends = 0;
+			return 1;
+		}
+		backend_data[nbackends] = calloc(1, sizeof(backend_store));
+		backend_data[nbackends + 1] = NULL;
+		if(!backend_data[nbackends]){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		backend_data[nbackends]->latency = latency_normal;
 		nbackends++;
 
 		fprintf(stderr, "Registered backend %s\n", b.name);
@@ -254,9 +881,126 @@ MM_API int mm_backend_register(backend b){
 	return 1;
 }
 
+MM_API void mm_memory_external(instance* inst, size_t bytes){
+	instance_store* store = (instance_store*) inst;
+	store->external.current = bytes;
+	store->external.allocations++;
+	if(bytes > store->external.peak){
+		store->external.peak = bytes;
+	}
+}
+
+memory_account* backend_memory(backend* b){
+	return &backend_data[b - backends]->memory;
+}
+
+memory_account* instance_memory(instance* inst){
+	return &((instance_store*) inst)->memory;
+}
+
+void backends_memory_report(){
+	size_t u, p, n;
+	uint64_t requests;
+	instance_store* store = NULL;
+	char name[64];
+
+	for(u = 0; u < nbackends; u++){
+		//backends allocating memory directly would only be reported with the channel storage managed by the core
+		requests = backend_data[u]->memory.requests;
+		for(p = 0, n = 0; p < ninstances; p++){
+			if(instances[p]->backend == backends + u){
+				requests += ((instance_store*) instances[p])->memory.requests;
+				n++;
+			}
+		}
+
+		snprintf(name, sizeof(name), "backend %s", backends[u].name);
+		if(requests || !n){
+			memory_print(name, &backend_data[u]->memory);
+		}
+		else{
+			fprintf(stderr, "\t%-32s %12s\n", name, "not accounted");
+		}
+
+		for(p = 0; p < ninstances; p++){
+			if(instances[p]->backend != backends + u){
+				continue;
+			}
+			store = (instance_store*) instances[p];
+			snprintf(name, sizeof(name), "  instance %s", instances[p]->name);
+			memory_print(name, &store->memory);
+			if(store->external.peak){
+				snprintf(name, sizeof(name), "  instance %s (external)", instances[p]->name);
+				memory_print(name, &store->external);
+			}
+		}
+	}
+}
+
+static uint64_t backend_clock(){
+	#ifdef _WIN32
+	return GetTickCount();
+	#else
+	struct timespec current;
+	if(clock_gettime(CLOCK_MONOTONIC, &current)){
+		fprintf(stderr, "Failed to read monotonic clock: %s\n", strerror(errno));
+		return 0;
+	}
+	return current.tv_sec * 1000 + current.tv_nsec / 1000000;
+	#endif
+}
+
+//order the instances for delivery, keeping the creation order in the instance list returned to backends
+static int backends_schedule(){
+	size_t u, p;
+	instance* xchg = NULL;
+
+	for(u = 0; u < nbackends; u++){
+		backend_data[u]->latency = latency_classes;
+	}
+
+	memory_free(schedule);
+	schedule = memory_calloc(memory_core(memory_instances), ninstances + 1, sizeof(instance*));
+	if(!schedule){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	//stable insertion sort, keeping the creation order within each class
+	for(u = 0; u < ninstances; u++){
+		schedule[u] = instances[u];
+		for(p = u; p > 0 && ((instance_store*) schedule[p - 1])->latency > ((instance_store*) schedule[p])->latency; p--){
+			xchg = schedule[p - 1];
+			schedule[p - 1] = schedule[p];
+			schedule[p] = xchg;
+		}
+	}
+
+	for(u = 0; u < ninstances; u++){
+		p = instances[u]->backend - backends;
+		backend_data[p]->latency = min(backend_data[p]->latency, ((instance_store*) instances[u])->latency);
+		if(((instance_store*) instances[u])->latency != latency_normal){
+			DBGPF("Instance %s scheduled in latency class %s\n", instances[u]->name, latency_name(((instance_store*) instances[u])->latency));
+		}
+	}
+
+	for(u = 0; u < nbackends; u++){
+		if(backend_data[u]->latency == latency_classes){
+			backend_data[u]->latency = latency_normal;
+		}
+	}
+	return 0;
+}
+
 int backends_start(){
 	int rv = 0, current;
 	size_t u, p;
+	uint64_t start, total = backend_clock();
+
+	if(backends_schedule()){
+		return 1;
+	}
+
 	for(u = 0; u < nbackends; u++){
 		//only start backends that have instances
 		for(p = 0; p < ninstances && instances[p]->backend != backends + u; p++){
@@ -266,20 +1010,38 @@ int backends_start(){
 			continue;
 		}
 
+		start = backend_clock();
+		memory_owner(&backend_data[u]->memory);
 		current = backends[u].start();
+		memory_owner(NULL);
 		if(current){
 			fprintf(stderr, "Failed to start backend %s\n", backends[u].name);
 		}
+		else{
+			fprintf(stderr, "Started backend %s in %" PRIu64 " msec\n", backends[u].name, backend_clock() - start);
+		}
 		rv |= current;
 	}
+
+	//backends may have reassigned channel identifiers while starting
+	for(u = 0; u < ninstances; u++){
+		if(((instance_store*) instances[u])->index_alloc
+				&& channel_index_build((instance_store*) instances[u], ((instance_store*) instances[u])->index_alloc)){
+			rv = 1;
+		}
+	}
+
+	fprintf(stderr, "Backend startup took %" PRIu64 " msec\n", backend_clock() - total);
 	return rv;
 }
 
 int backends_stop(){
 	size_t u;
 	for(u = 0; u < nbackends; u++){
+		memory_owner(&backend_data[u]->memory);
 		backends[u].shutdown();
 	}
+	memory_owner(NULL);
 	free(backends);
 	nbackends = 0;
 	return 0;
@@ -1,8 +1,18 @@
 #include <sys/types.h>
+#include "memory.h"
+
+/* Latency classes, served in ascending order within each core iteration */
+typedef enum /*_mm_latency_class*/ {
+	latency_realtime = 0,
+	latency_normal,
+	latency_bulk,
+	latency_classes
+} latency_class;
 
 /* Internal API */
-int backends_handle(size_t nfds, managed_fd* fds);
+int backends_handle(size_t nfds, managed_fd* fds, latency_class class);
 int backends_notify(size_t nev, channel** c, channel_value* v);
+int backends_deferred();
 backend* backend_match(char* name);
 instance* instance_match(char* name);
 struct timeval backend_timeout();
@@ -10,10 +20,24 @@ int backends_start();
 int backends_stop();
 void instances_free();
 void channels_free();
+int instance_configure(instance* inst, char* option, char* value);
+void backends_memory_report();
+memory_account* backend_memory(backend* b);
+memory_account* instance_memory(instance* inst);
+int latency_parse(char* name, latency_class* class);
+char* latency_name(latency_class class);
+int channel_latency_set(channel* c, latency_class class);
+latency_class channel_latency(channel* c);
+uint8_t channel_components(channel* c);
+int channel_needs_conversion(channel* from, channel* to);
+void channel_convert(channel* from, channel* to, channel_value* v);
 
 /* Backend API */
 MM_API channel* mm_channel(instance* inst, uint64_t ident, uint8_t create);
+MM_API int mm_channel_components(channel* c, uint8_t components);
+MM_API int mm_channel_resolution(channel* c, uint8_t bits);
 MM_API instance* mm_instance();
 MM_API instance* mm_instance_find(char* name, uint64_t ident);
 MM_API int mm_backend_instances(char* name, size_t* ninst, instance*** inst);
 MM_API int mm_backend_register(backend b);
+MM_API void mm_memory_external(instance* inst, size_t bytes);
@@ -25,7 +25,7 @@ static int artnet_listener(char* host, char* port){
 	}
 
 	//store fd
-	artnet_fd = realloc(artnet_fd, (artnet_fds + 1) * sizeof(artnet_descriptor));
+	artnet_fd = mm_realloc(artnet_fd, (artnet_fds + 1) * sizeof(artnet_descriptor));
 	if(!artnet_fd){
 		close(fd);
 		fprintf(stderr, "Failed to allocate memory\n");
@@ -104,7 +104,7 @@ static instance* artnet_instance(){
 		return NULL;
 	}
 
-	data = calloc(1, sizeof(artnet_instance_data));
+	data = mm_calloc(1, sizeof(artnet_instance_data));
 	if(!data){
 		fprintf(stderr, "Failed to allocate memory\n");
 		return NULL;
@@ -128,6 +128,19 @@ static int artnet_configure_instance(instance* inst, char* option, char* value){
 		data->uni = strtoul(value, NULL, 0);
 		return 0;
 	}
+	else if(!strcmp(option, "merge")){
+		if(!strcmp(value, "ltp")){
+			data->merge = merge_ltp;
+		}
+		else if(!strcmp(value, "htp")){
+			data->merge = merge_htp;
+		}
+		else{
+			fprintf(stderr, "Unknown merge mode %s for ArtNet instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
 	else if(!strcmp(option, "iface") || !strcmp(option, "interface")){
 		data->fd_index = strtoul(value, NULL, 0);
 
@@ -156,11 +169,56 @@ static int artnet_configure_instance(instance* inst, char* option, char* value){
 	return 1;
 }
 
+//pixel channels spanning consecutive slots: rgb<pixel>[@<first slot>] or rgbw<pixel>[@<first slot>]
+static channel* artnet_vector_channel(instance* inst, char* spec){
+	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
+	uint8_t components = (spec[3] == 'w') ? 4 : 3;
+	char* spec_next = spec + components;
+	unsigned pixel = strtoul(spec_next, &spec_next, 10), first = 1, u;
+	channel* chan = NULL;
+
+	if(*spec_next == '@'){
+		first = strtoul(spec_next + 1, &spec_next, 10);
+	}
+
+	if(!pixel || !first || *spec_next){
+		fprintf(stderr, "Invalid ArtNet pixel channel specification %s\n", spec);
+		return NULL;
+	}
+
+	first += (pixel - 1) * components - 1;
+	if(first + components > 512){
+		fprintf(stderr, "ArtNet pixel channel %s exceeds the universe\n", spec);
+		return NULL;
+	}
+
+	//all slots must be unmapped or already mapped to this pixel
+	for(u = first; u < first + components; u++){
+		if(IS_ACTIVE(data->data.map[u])
+				&& data->data.map[u] != ((u == first) ? (MAP_VECTOR | (first + components - 1)) : (MAP_COMPONENT | first))){
+			fprintf(stderr, "ArtNet channel %u already mapped in another mode for spec %s\n", u + 1, spec);
+			return NULL;
+		}
+		data->data.map[u] = (u == first) ? (MAP_VECTOR | (first + components - 1)) : (MAP_COMPONENT | first);
+	}
+
+	chan = mm_channel(inst, first, 1);
+	if(!chan || mm_channel_components(chan, components)){
+		return NULL;
+	}
+	return chan;
+}
+
 static channel* artnet_channel(instance* inst, char* spec){
 	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
 	char* spec_next = spec;
-	unsigned chan_a = strtoul(spec, &spec_next, 10);
-	unsigned chan_b = 0;
+	unsigned chan_a, chan_b = 0;
+	channel* chan = NULL;
+
+	if(!strncmp(spec, "rgb", 3)){
+		return artnet_vector_channel(inst, spec);
+	}
+	chan_a = strtoul(spec, &spec_next, 10);
 
 	//primary channel sanity check
 	if(!chan_a || chan_a > 512){
@@ -197,7 +255,12 @@ static channel* artnet_channel(instance* inst, char* spec){
 	}
 	data->data.map[chan_a] = (*spec_next == '+') ? (MAP_COARSE | chan_b) : (MAP_SINGLE | chan_a);
 
-	return mm_channel(inst, chan_a, 1);
+	//values are copied as integers between channels of the same resolution
+	chan = mm_channel(inst, chan_a, 1);
+	if(!chan || mm_channel_resolution(chan, (*spec_next == '+') ? 16 : 8)){
+		return NULL;
+	}
+	return chan;
 }
 
 static int artnet_transmit(instance* inst){
@@ -217,6 +280,7 @@ static int artnet_transmit(instance* inst){
 	};
 	memcpy(frame.data, data->data.out, 512);
 
+	mm_trace(mm_trace_transmit, artnet_fd[data->fd_index].fd, sizeof(frame));
 	if(sendto(artnet_fd[data->fd_index].fd, (uint8_t*) &frame, sizeof(frame), 0, (struct sockaddr*) &data->dest_addr, data->dest_len) < 0){
 		fprintf(stderr, "Failed to output ArtNet frame for instance %s: %s\n", inst->name, strerror(errno));
 	}
@@ -231,7 +295,8 @@ static int artnet_transmit(instance* inst){
 }
 
 static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v){
-	size_t u, mark = 0;
+	size_t u, p, mark = 0;
+	uint8_t component;
 	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
 
 	if(!data->dest_len){
@@ -241,8 +306,18 @@ static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v)
 
 	//FIXME maybe introduce minimum frame interval
 	for(u = 0; u < num; u++){
-		if(IS_WIDE(data->data.map[c[u]->ident])){
-			uint32_t val = v[u].normalised * ((double) 0xFFFF);
+		if(IS_VECTOR(data->data.map[c[u]->ident])){
+			//scale the 16-bit components to consecutive slots
+			for(p = 0; c[u]->ident + p <= MAPPED_CHANNEL(data->data.map[c[u]->ident]); p++){
+				component = (v[u].raw.component[p] * 255 + 0x7FFF) / 0xFFFF;
+				if(data->data.out[c[u]->ident + p] != component){
+					mark = 1;
+					data->data.out[c[u]->ident + p] = component;
+				}
+			}
+		}
+		else if(IS_WIDE(data->data.map[c[u]->ident])){
+			uint32_t val = v[u].raw.u64;
 			//the primary (coarse) channel is the one registered to the core, so we don't have to check for that
 			if(data->data.out[c[u]->ident] != ((val >> 8) & 0xFF)){
 				mark = 1;
@@ -254,9 +329,9 @@ static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v)
 				data->data.out[MAPPED_CHANNEL(data->data.map[c[u]->ident])] = val & 0xFF;
 			}
 		}
-		else if(data->data.out[c[u]->ident] != (v[u].normalised * 255.0)){
+		else if(data->data.out[c[u]->ident] != v[u].raw.u64){
 			mark = 1;
-			data->data.out[c[u]->ident] = v[u].normalised * 255.0;
+			data->data.out[c[u]->ident] = v[u].raw.u64;
 		}
 	}
 
@@ -267,24 +342,106 @@ static int artnet_set(instance* inst, size_t num, channel** c, channel_value* v)
 	return 0;
 }
 
-static inline int artnet_process_frame(instance* inst, artnet_pkt* frame){
-	size_t p, max_mark = 0;
+static void artnet_source_report(instance* inst, artnet_source* source, char* state){
+	fprintf(stderr, "ArtNet instance %s source %s %s: %" PRIu64 " frames, %" PRIu64 " slot changes\n", inst->name, source->name, state, source->frames, source->changes);
+}
+
+//find the source of a frame, registering new sources and dropping the ones that timed out
+static artnet_source* artnet_source_find(instance* inst, struct sockaddr_storage* addr, socklen_t addr_len){
+	size_t u;
+	uint64_t timestamp = mm_timestamp();
+	char host[INET6_ADDRSTRLEN] = "", port[8] = "";
+	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
+	artnet_source* source = NULL;
+
+	for(u = 0; u < data->sources;){
+		if(timestamp - data->source[u].last_frame > ARTNET_SOURCE_TIMEOUT){
+			artnet_source_report(inst, data->source + u, "timed out");
+			data->sources--;
+			memmove(data->source + u, data->source + u + 1, (data->sources - u) * sizeof(artnet_source));
+			continue;
+		}
+
+		if(data->source[u].addr_len == addr_len && !memcmp(&data->source[u].addr, addr, addr_len)){
+			source = data->source + u;
+		}
+		u++;
+	}
+
+	if(!source){
+		if(data->sources == ARTNET_MAX_SOURCES){
+			if(!data->rejected){
+				fprintf(stderr, "ArtNet instance %s ignoring additional sources, merging is limited to %d sources\n", inst->name, ARTNET_MAX_SOURCES);
+			}
+			data->rejected++;
+			return NULL;
+		}
+
+		source = data->source + data->sources;
+		memset(source, 0, sizeof(artnet_source));
+		memcpy(&source->addr, addr, addr_len);
+		source->addr_len = addr_len;
+		getnameinfo((struct sockaddr*) addr, addr_len, host, sizeof(host), port, sizeof(port), NI_NUMERICHOST | NI_NUMERICSERV);
+		snprintf(source->name, sizeof(source->name), "%s port %s", host, port);
+		data->sources++;
+		fprintf(stderr, "ArtNet instance %s receiving from %s (%" PRIsize_t " active sources)\n", inst->name, source->name, data->sources);
+	}
+
+	source->last_frame = timestamp;
+	return source;
+}
+
+static inline int artnet_process_frame(instance* inst, artnet_pkt* frame, struct sockaddr_storage* addr, socklen_t addr_len){
+	size_t p, u, max_mark = 0, length = be16toh(frame->length);
 	uint16_t wide_val = 0;
+	uint8_t merged[512];
+	uint64_t changed[512 / 64], mask;
 	channel* chan = NULL;
 	channel_value val;
+	artnet_source* source = NULL;
 	artnet_instance_data* data = (artnet_instance_data*) inst->impl;
 
-	if(be16toh(frame->length) > 512){
+	if(length > 512){
 		fprintf(stderr, "Invalid ArtNet frame channel count\n");
 		return 1;
 	}
 
-	//read data, mark update channels
-	for(p = 0; p < be16toh(frame->length); p++){
-		if(IS_ACTIVE(data->data.map[p]) && frame->data[p] != data->data.in[p]){
-			data->data.in[p] = frame->data[p];
-			data->data.map[p] |= MAP_MARK;
-			max_mark = p;
+	source = artnet_source_find(inst, addr, addr_len);
+	if(!source){
+		return 0;
+	}
+
+	if(data->merge == merge_htp){
+		//highest value of all active sources
+		memcpy(source->data, frame->data, length);
+		memcpy(merged, data->source[0].data, sizeof(merged));
+		for(u = 1; u < data->sources; u++){
+			mmbackend_merge_htp(sizeof(merged), data->source[u].data, merged);
+		}
+	}
+	else{
+		//latest change of any source, the first frame of a new source takes over completely
+		memcpy(merged, data->data.in, sizeof(merged));
+		if(!source->frames){
+			memcpy(source->data, frame->data, length);
+			memcpy(merged, frame->data, length);
+		}
+		else{
+			mmbackend_merge_ltp(length, frame->data, source->data, merged);
+		}
+	}
+
+	source->frames++;
+	source->changes += mmbackend_update_u8(sizeof(merged), merged, data->data.in, changed);
+
+	//mark mapped channels with changed slots
+	for(u = 0; u < sizeof(changed) / sizeof(uint64_t); u++){
+		for(mask = changed[u]; mask; mask &= mask - 1){
+			p = u * 64 + __builtin_ctzll(mask);
+			if(IS_ACTIVE(data->data.map[p])){
+				data->data.map[p] |= MAP_MARK;
+				max_mark = p;
+			}
 		}
 	}
 
@@ -292,7 +449,7 @@ static inline int artnet_process_frame(instance* inst, artnet_pkt* frame){
 	for(p = 0; p <= max_mark; p++){
 		if(data->data.map[p] & MAP_MARK){
 			data->data.map[p] &= ~MAP_MARK;
-			if(data->data.map[p] & MAP_FINE){
+			if(data->data.map[p] & (MAP_FINE | MAP_COMPONENT)){
 				chan = mm_channel(inst, MAPPED_CHANNEL(data->data.map[p]), 0);
 			}
 			else{
@@ -304,7 +461,16 @@ static inline int artnet_process_frame(instance* inst, artnet_pkt* frame){
 				return 1;
 			}
 
-			if(IS_WIDE(data->data.map[p])){
+			if(IS_VECTOR(data->data.map[p])){
+				//one event for all components of a pixel, 8-bit slots are scaled to 16 bits
+				memset(&val, 0, sizeof(val));
+				for(u = chan->ident; u <= MAPPED_CHANNEL(data->data.map[chan->ident]); u++){
+					data->data.map[u] &= ~MAP_MARK;
+					val.raw.component[u - chan->ident] = data->data.in[u] * 0x0101;
+				}
+				val.normalised = (double) data->data.in[chan->ident] / 255.0;
+			}
+			else if(IS_WIDE(data->data.map[p])){
 				data->data.map[MAPPED_CHANNEL(data->data.map[p])] &= ~MAP_MARK;
 				wide_val = data->data.in[p] << ((data->data.map[p] & MAP_COARSE) ? 8 : 0);
 				wide_val |= data->data.in[MAPPED_CHANNEL(data->data.map[p])] << ((data->data.map[p] & MAP_COARSE) ? 0 : 8);
@@ -332,6 +498,8 @@ static int artnet_handle(size_t num, managed_fd* fds){
 	uint64_t timestamp = mm_timestamp();
 	ssize_t bytes_read;
 	char recv_buf[ARTNET_RECV_BUF];
+	struct sockaddr_storage source;
+	socklen_t source_len;
 	artnet_instance_id inst_id = {
 		.label = 0
 	};
@@ -357,7 +525,8 @@ static int artnet_handle(size_t num, managed_fd* fds){
 
 	for(u = 0; u < num; u++){
 		do{
-			bytes_read = recv(fds[u].fd, recv_buf, sizeof(recv_buf), 0);
+			source_len = sizeof(source);
+			bytes_read = recvfrom(fds[u].fd, recv_buf, sizeof(recv_buf), 0, (struct sockaddr*) &source, &source_len);
 			if(bytes_read > 0 && bytes_read > sizeof(artnet_hdr)){
 				if(!memcmp(frame->magic, "Art-Net\0", 8) && be16toh(frame->opcode) == OpDmx){
 					//find matching instance
@@ -365,7 +534,7 @@ static int artnet_handle(size_t num, managed_fd* fds){
 					inst_id.fields.net = frame->net;
 					inst_id.fields.uni = frame->universe;
 					inst = mm_instance_find(BACKEND_NAME, inst_id.label);
-					if(inst && artnet_process_frame(inst, frame)){
+					if(inst && artnet_process_frame(inst, frame, &source, source_len)){
 						fprintf(stderr, "Failed to process ArtNet frame\n");
 					}
 				}
@@ -433,8 +602,8 @@ static int artnet_start(){
 
 		//if enabled for output, add to keepalive tracking
 		if(data->dest_len){
-			artnet_fd[data->fd_index].output_instance = realloc(artnet_fd[data->fd_index].output_instance, (artnet_fd[data->fd_index].output_instances + 1) * sizeof(artnet_instance_id));
-			artnet_fd[data->fd_index].last_frame = realloc(artnet_fd[data->fd_index].last_frame, (artnet_fd[data->fd_index].output_instances + 1) * sizeof(uint64_t));
+			artnet_fd[data->fd_index].output_instance = mm_realloc(artnet_fd[data->fd_index].output_instance, (artnet_fd[data->fd_index].output_instances + 1) * sizeof(artnet_instance_id));
+			artnet_fd[data->fd_index].last_frame = mm_realloc(artnet_fd[data->fd_index].last_frame, (artnet_fd[data->fd_index].output_instances + 1) * sizeof(uint64_t));
 
 			if(!artnet_fd[data->fd_index].output_instance || !artnet_fd[data->fd_index].last_frame){
 				fprintf(stderr, "Failed to allocate memory\n");
@@ -461,24 +630,32 @@ bail:
 }
 
 static int artnet_shutdown(){
-	size_t n, p;
+	size_t n, p, u;
 	instance** inst = NULL;
+	artnet_instance_data* data = NULL;
 	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
 		fprintf(stderr, "Failed to fetch instance list\n");
 		return 1;
 	}
 
 	for(p = 0; p < n; p++){
-		free(inst[p]->impl);
+		data = (artnet_instance_data*) inst[p]->impl;
+		for(u = 0; u < data->sources; u++){
+			artnet_source_report(inst[p], data->source + u, "active");
+		}
+		if(data->rejected){
+			fprintf(stderr, "ArtNet instance %s ignored %" PRIu64 " frames from additional sources\n", inst[p]->name, data->rejected);
+		}
+		mm_free(inst[p]->impl);
 	}
 	free(inst);
 
 	for(p = 0; p < artnet_fds; p++){
 		close(artnet_fd[p].fd);
-		free(artnet_fd[p].output_instance);
-		free(artnet_fd[p].last_frame);
+		mm_free(artnet_fd[p].output_instance);
+		mm_free(artnet_fd[p].last_frame);
 	}
-	free(artnet_fd);
+	mm_free(artnet_fd);
 
 	fprintf(stderr, "ArtNet backend shut down\n");
 	return 0;
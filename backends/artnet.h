@@ -17,15 +17,21 @@ static int artnet_shutdown();
 #define ARTNET_VERSION 14
 #define ARTNET_RECV_BUF 4096
 #define ARTNET_KEEPALIVE_INTERVAL 2000
+/* Sources not sending for this long are dropped from merging */
+#define ARTNET_SOURCE_TIMEOUT 10000
+#define ARTNET_MAX_SOURCES 4
 
 #define MAP_COARSE 0x0200
 #define MAP_FINE 0x0400
 #define MAP_SINGLE 0x0800
 #define MAP_MARK 0x1000
+#define MAP_VECTOR 0x2000
+#define MAP_COMPONENT 0x4000
 #define MAPPED_CHANNEL(a) ((a) & 0x01FF)
 #define IS_ACTIVE(a) ((a) & 0xFE00)
 #define IS_WIDE(a) ((a) & (MAP_FINE | MAP_COARSE))
 #define IS_SINGLE(a) ((a) & MAP_SINGLE)
+#define IS_VECTOR(a) ((a) & (MAP_VECTOR | MAP_COMPONENT))
 
 typedef struct /*_artnet_universe_model*/ {
 	uint8_t seq;
@@ -34,6 +40,21 @@ typedef struct /*_artnet_universe_model*/ {
 	uint16_t map[512];
 } artnet_universe;
 
+typedef enum /*_artnet_merge_mode*/ {
+	merge_ltp = 0,
+	merge_htp
+} artnet_merge_mode;
+
+typedef struct /*_artnet_source*/ {
+	struct sockaddr_storage addr;
+	socklen_t addr_len;
+	char name[64];
+	uint8_t data[512];
+	uint64_t last_frame;
+	uint64_t frames;
+	uint64_t changes;
+} artnet_source;
+
 typedef struct /*_artnet_instance_model*/ {
 	uint8_t net;
 	uint8_t uni;
@@ -41,6 +62,11 @@ typedef struct /*_artnet_instance_model*/ {
 	socklen_t dest_len;
 	artnet_universe data;
 	size_t fd_index;
+
+	artnet_merge_mode merge;
+	size_t sources;
+	artnet_source source[ARTNET_MAX_SOURCES];
+	uint64_t rejected;
 } artnet_instance_data;
 
 typedef union /*_artnet_instance_id*/ {
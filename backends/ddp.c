@@ -0,0 +1,323 @@
+#include <string.h>
+#include <errno.h>
+
+#include "libmmbackend.h"
+#include "ddp.h"
+
+#define BACKEND_NAME "ddp"
+
+int init(){
+	backend ddp = {
+		.name = BACKEND_NAME,
+		.conf = ddp_configure,
+		.create = ddp_instance,
+		.conf_instance = ddp_configure_instance,
+		.channel = ddp_channel,
+		.handle = ddp_set,
+		.process = ddp_handle,
+		.start = ddp_start,
+		.shutdown = ddp_shutdown,
+		.interval = ddp_interval
+	};
+
+	if(sizeof(ddp_pkt) != DDP_HEADER_LENGTH + DDP_MAX_DATA || DDP_HEADER_LENGTH != 10){
+		fprintf(stderr, "DDP packet structure misaligned\n");
+		return 1;
+	}
+
+	//register backend
+	if(mm_backend_register(ddp)){
+		fprintf(stderr, "Failed to register DDP backend\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int ddp_configure(char* option, char* value){
+	fprintf(stderr, "The DDP backend does not take any global configuration\n");
+	return 1;
+}
+
+static int ddp_configure_instance(instance* inst, char* option, char* value){
+	ddp_instance_data* data = (ddp_instance_data*) inst->impl;
+	char* host = NULL, *port = NULL;
+
+	if(!strcmp(option, "destination") || !strcmp(option, "dest")){
+		mmbackend_parse_hostspec(value, &host, &port);
+		if(!host){
+			fprintf(stderr, "Invalid destination address %s for DDP instance %s\n", value, inst->name);
+			return 1;
+		}
+
+		mm_free(data->host);
+		mm_free(data->port);
+		data->host = mm_strdup(host);
+		data->port = mm_strdup(port ? port : DDP_PORT);
+		if(!data->host || !data->port){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "id")){
+		data->id = strtoul(value, NULL, 10);
+		if(!data->id){
+			fprintf(stderr, "Invalid destination ID %s for DDP instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "type")){
+		if(!strcmp(value, "rgb")){
+			data->type = DDP_TYPE_RGB;
+		}
+		else if(!strcmp(value, "rgbw")){
+			data->type = DDP_TYPE_RGBW;
+		}
+		else{
+			fprintf(stderr, "Unknown data type %s for DDP instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown instance option %s for DDP instance %s\n", option, inst->name);
+	return 1;
+}
+
+static instance* ddp_instance(){
+	ddp_instance_data* data = NULL;
+	instance* inst = mm_instance();
+	if(!inst){
+		return NULL;
+	}
+
+	data = mm_calloc(1, sizeof(ddp_instance_data));
+	if(!data){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	data->fd = -1;
+	data->id = DDP_DEFAULT_ID;
+	data->type = DDP_TYPE_RGB;
+	inst->impl = data;
+	return inst;
+}
+
+static channel* ddp_channel(instance* inst, char* spec){
+	ddp_instance_data* data = (ddp_instance_data*) inst->impl;
+	char* spec_next = spec;
+	unsigned long offset = strtoul(spec, &spec_next, 10);
+	channel* chan = NULL;
+
+	if(spec_next == spec || *spec_next || !offset || offset > DDP_MAX_SIZE){
+		fprintf(stderr, "Invalid DDP channel specification %s\n", spec);
+		return NULL;
+	}
+
+	//grow the output buffer to cover the channel
+	if(offset > data->size){
+		data->data = mm_realloc(data->data, offset);
+		if(!data->data){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		memset(data->data + data->size, 0, offset - data->size);
+		data->size = offset;
+	}
+
+	chan = mm_channel(inst, offset - 1, 1);
+	if(!chan || mm_channel_resolution(chan, 8)){
+		return NULL;
+	}
+	return chan;
+}
+
+static int ddp_transmit(instance* inst, size_t start, size_t end){
+	ddp_instance_data* data = (ddp_instance_data*) inst->impl;
+	size_t n = 0, length;
+
+	//split the range into packets, the last one pushes the frame to the outputs
+	for(; start < end; start += length, n++){
+		length = min(end - start, DDP_MAX_DATA);
+		data->sequence = (data->sequence % 15) + 1;
+
+		data->packet[n].flags = DDP_VERSION | ((start + length == end) ? DDP_FLAG_PUSH : 0);
+		data->packet[n].sequence = data->sequence;
+		data->packet[n].type = data->type;
+		data->packet[n].id = data->id;
+		data->packet[n].offset = htobe32(start);
+		data->packet[n].length = htobe16(length);
+		memcpy(data->packet[n].data, data->data + start, length);
+		data->packet_length[n] = DDP_HEADER_LENGTH + length;
+	}
+
+	data->dirty_start = data->dirty_end = 0;
+	data->last_frame = mm_timestamp();
+	if(mmbackend_send_datagrams(data->fd, n, data->packet_data, data->packet_length)){
+		fprintf(stderr, "Failed to output DDP frame for instance %s\n", inst->name);
+	}
+	return 0;
+}
+
+static int ddp_set(instance* inst, size_t num, channel** c, channel_value* v){
+	ddp_instance_data* data = (ddp_instance_data*) inst->impl;
+	size_t u, offset;
+
+	if(!num){
+		return 0;
+	}
+
+	if(data->fd < 0){
+		fprintf(stderr, "DDP instance %s not enabled for output (%" PRIsize_t " channel events)\n", inst->name, num);
+		return 0;
+	}
+
+	for(u = 0; u < num; u++){
+		offset = c[u]->ident;
+		if(data->data[offset] != v[u].raw.u64){
+			data->data[offset] = v[u].raw.u64;
+			if(data->dirty_start == data->dirty_end){
+				data->dirty_start = offset;
+				data->dirty_end = offset + 1;
+			}
+			else{
+				data->dirty_start = min(data->dirty_start, offset);
+				data->dirty_end = max(data->dirty_end, offset + 1);
+			}
+		}
+	}
+
+	//output all changes of one batch as one frame
+	if(data->dirty_start != data->dirty_end){
+		return ddp_transmit(inst, data->dirty_start, data->dirty_end);
+	}
+	return 0;
+}
+
+static int ddp_handle(size_t num, managed_fd* fds){
+	size_t n, u;
+	instance** inst = NULL;
+	ddp_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	//periodically retransmit the full buffer for controllers that missed a frame or restarted
+	for(u = 0; u < n; u++){
+		data = (ddp_instance_data*) inst[u]->impl;
+		if(data->last_frame && now - data->last_frame >= DDP_KEEPALIVE_INTERVAL){
+			ddp_transmit(inst[u], 0, data->size);
+		}
+	}
+
+	free(inst);
+	return 0;
+}
+
+static uint32_t ddp_interval(){
+	size_t n, u;
+	instance** inst = NULL;
+	ddp_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+	uint32_t next = DDP_KEEPALIVE_INTERVAL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return next;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (ddp_instance_data*) inst[u]->impl;
+		if(data->last_frame){
+			next = (now - data->last_frame >= DDP_KEEPALIVE_INTERVAL) ? 0 : min(next, DDP_KEEPALIVE_INTERVAL - (now - data->last_frame));
+		}
+	}
+
+	free(inst);
+	return next;
+}
+
+static int ddp_start(){
+	size_t n, u, p;
+	instance** inst = NULL;
+	ddp_instance_data* data = NULL;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (ddp_instance_data*) inst[u]->impl;
+		if(!data->host){
+			fprintf(stderr, "DDP instance %s has no destination configured\n", inst[u]->name);
+			continue;
+		}
+
+		if(!data->size){
+			fprintf(stderr, "DDP instance %s has no channels mapped\n", inst[u]->name);
+			continue;
+		}
+
+		//each controller is addressed through its own connected socket
+		data->fd = mmbackend_socket(data->host, data->port, SOCK_DGRAM, 0, 0);
+		if(data->fd < 0){
+			fprintf(stderr, "Failed to create socket for DDP instance %s\n", inst[u]->name);
+			goto bail;
+		}
+
+		data->packets = (data->size + DDP_MAX_DATA - 1) / DDP_MAX_DATA;
+		data->packet = mm_calloc(data->packets, sizeof(ddp_pkt));
+		data->packet_data = mm_calloc(data->packets, sizeof(uint8_t*));
+		data->packet_length = mm_calloc(data->packets, sizeof(size_t));
+		if(!data->packet || !data->packet_data || !data->packet_length){
+			fprintf(stderr, "Failed to allocate memory\n");
+			goto bail;
+		}
+
+		for(p = 0; p < data->packets; p++){
+			data->packet_data[p] = (uint8_t*) (data->packet + p);
+		}
+	}
+
+	fprintf(stderr, "DDP backend registered %" PRIsize_t " instances\n", n);
+	rv = 0;
+bail:
+	free(inst);
+	return rv;
+}
+
+static int ddp_shutdown(){
+	size_t n, u;
+	instance** inst = NULL;
+	ddp_instance_data* data = NULL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (ddp_instance_data*) inst[u]->impl;
+		if(data->fd >= 0){
+			close(data->fd);
+		}
+		mm_free(data->host);
+		mm_free(data->port);
+		mm_free(data->data);
+		mm_free(data->packet);
+		mm_free(data->packet_data);
+		mm_free(data->packet_length);
+		mm_free(inst[u]->impl);
+	}
+
+	free(inst);
+	fprintf(stderr, "DDP backend shut down\n");
+	return 0;
+}
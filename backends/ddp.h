@@ -0,0 +1,61 @@
+#include "midimonster.h"
+
+int init();
+static int ddp_configure(char* option, char* value);
+static int ddp_configure_instance(instance* inst, char* option, char* value);
+static instance* ddp_instance();
+static channel* ddp_channel(instance* inst, char* spec);
+static int ddp_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int ddp_handle(size_t num, managed_fd* fds);
+static uint32_t ddp_interval();
+static int ddp_start();
+static int ddp_shutdown();
+
+#define DDP_PORT "4048"
+/* Maximum payload per packet, 480 RGB pixels */
+#define DDP_MAX_DATA 1440
+/* Maximum number of output bytes per instance */
+#define DDP_MAX_SIZE (1 << 20)
+#define DDP_KEEPALIVE_INTERVAL 1000
+
+#define DDP_VERSION 0x40
+#define DDP_FLAG_PUSH 0x01
+#define DDP_TYPE_RGB 0x0B
+#define DDP_TYPE_RGBW 0x1B
+#define DDP_DEFAULT_ID 1
+
+#pragma pack(push, 1)
+typedef struct /*_ddp_pkt*/ {
+	uint8_t flags;
+	uint8_t sequence;
+	uint8_t type;
+	uint8_t id;
+	uint32_t offset;
+	uint16_t length;
+	uint8_t data[DDP_MAX_DATA];
+} ddp_pkt;
+#pragma pack(pop)
+
+#define DDP_HEADER_LENGTH (sizeof(ddp_pkt) - DDP_MAX_DATA)
+
+typedef struct /*_ddp_instance_model*/ {
+	char* host;
+	char* port;
+	int fd;
+	uint8_t id;
+	uint8_t type;
+	uint8_t sequence;
+
+	//output buffer and the range modified since the last transmission
+	size_t size;
+	uint8_t* data;
+	size_t dirty_start;
+	size_t dirty_end;
+	uint64_t last_frame;
+
+	//packet scratch space for one frame
+	size_t packets;
+	ddp_pkt* packet;
+	uint8_t** packet_data;
+	size_t* packet_length;
+} ddp_instance_data;
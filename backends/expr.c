@@ -0,0 +1,653 @@
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "expr.h"
+
+#define BACKEND_NAME "expr"
+
+/* Parser state while compiling one expression */
+typedef struct /*_expr_parser*/ {
+	expr_instance_data* data;
+	char* source;
+	char* pos;
+	size_t depth;
+} expr_parser;
+
+static struct {
+	char* name;
+	expr_opcode op;
+	size_t arguments;
+} expr_functions[] = {
+	{"min", op_min, 2},
+	{"max", op_max, 2},
+	{"abs", op_abs, 1},
+	{"clamp", op_clamp, 3}
+};
+
+int init(){
+	backend expr = {
+		.name = BACKEND_NAME,
+		.conf = expr_configure,
+		.create = expr_instance,
+		.conf_instance = expr_configure_instance,
+		.channel = expr_channel,
+		.handle = expr_set,
+		.process = expr_handle,
+		.start = expr_start,
+		.shutdown = expr_shutdown
+	};
+
+	//register backend
+	if(mm_backend_register(expr)){
+		fprintf(stderr, "Failed to register expr backend\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int expr_configure(char* option, char* value){
+	fprintf(stderr, "The expr backend does not take any global configuration\n");
+	return 1;
+}
+
+static size_t expr_variable(expr_instance_data* data, char* name, size_t length){
+	size_t u;
+
+	for(u = 0; u < data->variables; u++){
+		if(strlen(data->name[u]) == length && !strncmp(data->name[u], name, length)){
+			return u;
+		}
+	}
+
+	data->name = mm_realloc(data->name, (u + 1) * sizeof(char*));
+	data->value = mm_realloc(data->value, (u + 1) * sizeof(double));
+	data->channel = mm_realloc(data->channel, (u + 1) * sizeof(channel*));
+	if(!data->name || !data->value || !data->channel){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return SIZE_MAX;
+	}
+
+	data->name[u] = mm_calloc(length + 1, sizeof(char));
+	if(!data->name[u]){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return SIZE_MAX;
+	}
+	memcpy(data->name[u], name, length);
+	data->value[u] = 0.0;
+	data->channel[u] = NULL;
+	data->variables++;
+	return u;
+}
+
+static int expr_emit(expr_parser* p, expr_opcode op, uint32_t arg){
+	expr_instance_data* data = p->data;
+
+	data->op = mm_realloc(data->op, (data->instructions + 1) * sizeof(uint8_t));
+	data->arg = mm_realloc(data->arg, (data->instructions + 1) * sizeof(uint32_t));
+	if(!data->op || !data->arg){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	data->op[data->instructions] = op;
+	data->arg[data->instructions] = arg;
+	data->instructions++;
+
+	//track the evaluation stack depth
+	switch(op){
+		case op_const:
+		case op_var:
+			p->depth++;
+			data->stack_depth = max(data->stack_depth, p->depth);
+			break;
+		case op_neg:
+		case op_not:
+		case op_abs:
+			break;
+		case op_clamp:
+			p->depth -= 2;
+			break;
+		default:
+			p->depth--;
+			break;
+	}
+	return 0;
+}
+
+static void expr_skip(expr_parser* p){
+	for(; *p->pos && isspace(*p->pos); p->pos++){
+	}
+}
+
+static int expr_accept(expr_parser* p, char* token){
+	expr_skip(p);
+	if(!strncmp(p->pos, token, strlen(token))){
+		p->pos += strlen(token);
+		return 1;
+	}
+	return 0;
+}
+
+static int expr_parse_or(expr_parser* p);
+
+static int expr_parse_primary(expr_parser* p){
+	char* end = NULL;
+	double number;
+	size_t u, length, arguments, variable;
+
+	expr_skip(p);
+	if(expr_accept(p, "(")){
+		if(expr_parse_or(p)){
+			return 1;
+		}
+		if(!expr_accept(p, ")")){
+			fprintf(stderr, "Missing closing parenthesis in expression %s\n", p->source);
+			return 1;
+		}
+		return 0;
+	}
+
+	if(isdigit(*p->pos) || *p->pos == '.'){
+		number = strtod(p->pos, &end);
+		if(end == p->pos){
+			fprintf(stderr, "Invalid number in expression %s\n", p->source);
+			return 1;
+		}
+		p->pos = end;
+
+		p->data->constant = mm_realloc(p->data->constant, (p->data->constants + 1) * sizeof(double));
+		if(!p->data->constant){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		p->data->constant[p->data->constants] = number;
+		p->data->constants++;
+		return expr_emit(p, op_const, p->data->constants - 1);
+	}
+
+	if(!*p->pos){
+		fprintf(stderr, "Unexpected end of expression %s\n", p->source);
+		return 1;
+	}
+	else if(!isalpha(*p->pos) && *p->pos != '_'){
+		fprintf(stderr, "Unexpected character '%c' in expression %s\n", *p->pos, p->source);
+		return 1;
+	}
+
+	for(length = 0; isalnum(p->pos[length]) || p->pos[length] == '_'; length++){
+	}
+
+	//function call
+	for(u = 0; u < sizeof(expr_functions) / sizeof(expr_functions[0]); u++){
+		if(strlen(expr_functions[u].name) == length && !strncmp(p->pos, expr_functions[u].name, length)){
+			p->pos += length;
+			if(!expr_accept(p, "(")){
+				fprintf(stderr, "Missing argument list for function %s in expression %s\n", expr_functions[u].name, p->source);
+				return 1;
+			}
+
+			for(arguments = 0; arguments < expr_functions[u].arguments; arguments++){
+				if((arguments && !expr_accept(p, ",")) || expr_parse_or(p)){
+					fprintf(stderr, "Function %s requires %" PRIsize_t " arguments in expression %s\n", expr_functions[u].name, expr_functions[u].arguments, p->source);
+					return 1;
+				}
+			}
+
+			if(!expr_accept(p, ")")){
+				fprintf(stderr, "Function %s requires %" PRIsize_t " arguments in expression %s\n", expr_functions[u].name, expr_functions[u].arguments, p->source);
+				return 1;
+			}
+			return expr_emit(p, expr_functions[u].op, 0);
+		}
+	}
+
+	//variable reference, unknown names become input variables
+	variable = expr_variable(p->data, p->pos, length);
+	if(variable == SIZE_MAX){
+		return 1;
+	}
+	p->pos += length;
+	return expr_emit(p, op_var, variable);
+}
+
+static int expr_parse_unary(expr_parser* p){
+	if(expr_accept(p, "-")){
+		return expr_parse_unary(p) || expr_emit(p, op_neg, 0);
+	}
+	else if(expr_accept(p, "!")){
+		return expr_parse_unary(p) || expr_emit(p, op_not, 0);
+	}
+	return expr_parse_primary(p);
+}
+
+static int expr_parse_product(expr_parser* p){
+	if(expr_parse_unary(p)){
+		return 1;
+	}
+
+	while(1){
+		if(expr_accept(p, "*")){
+			if(expr_parse_unary(p) || expr_emit(p, op_mul, 0)){
+				return 1;
+			}
+		}
+		else if(expr_accept(p, "/")){
+			if(expr_parse_unary(p) || expr_emit(p, op_div, 0)){
+				return 1;
+			}
+		}
+		else{
+			return 0;
+		}
+	}
+}
+
+static int expr_parse_sum(expr_parser* p){
+	if(expr_parse_product(p)){
+		return 1;
+	}
+
+	while(1){
+		if(expr_accept(p, "+")){
+			if(expr_parse_product(p) || expr_emit(p, op_add, 0)){
+				return 1;
+			}
+		}
+		else if(expr_accept(p, "-")){
+			if(expr_parse_product(p) || expr_emit(p, op_sub, 0)){
+				return 1;
+			}
+		}
+		else{
+			return 0;
+		}
+	}
+}
+
+static int expr_parse_comparison(expr_parser* p){
+	//two-character operators need to be tested first
+	char* operators[] = {"<=", ">=", "==", "!=", "<", ">"};
+	expr_opcode ops[] = {op_le, op_ge, op_eq, op_ne, op_lt, op_gt};
+	size_t u;
+
+	if(expr_parse_sum(p)){
+		return 1;
+	}
+
+	for(u = 0; u < sizeof(ops) / sizeof(expr_opcode); u++){
+		if(expr_accept(p, operators[u])){
+			return expr_parse_sum(p) || expr_emit(p, ops[u], 0);
+		}
+	}
+	return 0;
+}
+
+static int expr_parse_and(expr_parser* p){
+	if(expr_parse_comparison(p)){
+		return 1;
+	}
+
+	while(expr_accept(p, "&&")){
+		if(expr_parse_comparison(p) || expr_emit(p, op_and, 0)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int expr_parse_or(expr_parser* p){
+	if(expr_parse_and(p)){
+		return 1;
+	}
+
+	while(expr_accept(p, "||")){
+		if(expr_parse_and(p) || expr_emit(p, op_or, 0)){
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int expr_configure_instance(instance* inst, char* option, char* value){
+	expr_instance_data* data = (expr_instance_data*) inst->impl;
+	size_t variable = SIZE_MAX, u;
+	expr_parser parser = {
+		.data = data,
+		.source = value,
+		.pos = value
+	};
+
+	for(u = 0; option[u]; u++){
+		if(!isalnum(option[u]) && option[u] != '_'){
+			fprintf(stderr, "Invalid expression variable name %s on instance %s\n", option, inst->name);
+			return 1;
+		}
+	}
+
+	data->expression = mm_realloc(data->expression, (data->expressions + 1) * sizeof(expr_expression));
+	if(!data->expression){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+	data->expression[data->expressions].start = data->instructions;
+
+	if(expr_parse_or(&parser)){
+		return 1;
+	}
+
+	expr_skip(&parser);
+	if(*parser.pos){
+		fprintf(stderr, "Trailing characters %s in expression %s\n", parser.pos, value);
+		return 1;
+	}
+
+	//the target may not have been referenced before, including by its own expression
+	for(u = 0; u < data->variables; u++){
+		if(!strcmp(data->name[u], option)){
+			fprintf(stderr, "Variable %s on instance %s is already used, expressions can only reference previously defined variables\n", option, inst->name);
+			return 1;
+		}
+	}
+
+	variable = expr_variable(data, option, strlen(option));
+	if(variable == SIZE_MAX){
+		return 1;
+	}
+
+	data->expression[data->expressions].variable = variable;
+	data->expression[data->expressions].length = data->instructions - data->expression[data->expressions].start;
+	data->expressions++;
+	return 0;
+}
+
+static instance* expr_instance(){
+	instance* i = mm_instance();
+	if(!i){
+		return NULL;
+	}
+
+	i->impl = mm_calloc(1, sizeof(expr_instance_data));
+	if(!i->impl){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	return i;
+}
+
+static channel* expr_channel(instance* inst, char* spec){
+	expr_instance_data* data = (expr_instance_data*) inst->impl;
+	size_t variable = expr_variable(data, spec, strlen(spec));
+
+	if(variable == SIZE_MAX){
+		return NULL;
+	}
+
+	if(!data->channel[variable]){
+		data->channel[variable] = mm_channel(inst, variable, 1);
+	}
+	return data->channel[variable];
+}
+
+static double expr_evaluate(expr_instance_data* data, expr_expression* expression){
+	double* stack = data->stack;
+	size_t u, top = 0;
+
+	for(u = expression->start; u < expression->start + expression->length; u++){
+		switch(data->op[u]){
+			case op_const:
+				stack[top++] = data->constant[data->arg[u]];
+				break;
+			case op_var:
+				stack[top++] = data->value[data->arg[u]];
+				break;
+			case op_add:
+				top--;
+				stack[top - 1] += stack[top];
+				break;
+			case op_sub:
+				top--;
+				stack[top - 1] -= stack[top];
+				break;
+			case op_mul:
+				top--;
+				stack[top - 1] *= stack[top];
+				break;
+			case op_div:
+				top--;
+				stack[top - 1] = (stack[top] != 0.0) ? stack[top - 1] / stack[top] : 0.0;
+				break;
+			case op_neg:
+				stack[top - 1] = -stack[top - 1];
+				break;
+			case op_not:
+				stack[top - 1] = (stack[top - 1] == 0.0) ? 1.0 : 0.0;
+				break;
+			case op_lt:
+				top--;
+				stack[top - 1] = (stack[top - 1] < stack[top]) ? 1.0 : 0.0;
+				break;
+			case op_gt:
+				top--;
+				stack[top - 1] = (stack[top - 1] > stack[top]) ? 1.0 : 0.0;
+				break;
+			case op_le:
+				top--;
+				stack[top - 1] = (stack[top - 1] <= stack[top]) ? 1.0 : 0.0;
+				break;
+			case op_ge:
+				top--;
+				stack[top - 1] = (stack[top - 1] >= stack[top]) ? 1.0 : 0.0;
+				break;
+			case op_eq:
+				top--;
+				stack[top - 1] = (stack[top - 1] == stack[top]) ? 1.0 : 0.0;
+				break;
+			case op_ne:
+				top--;
+				stack[top - 1] = (stack[top - 1] != stack[top]) ? 1.0 : 0.0;
+				break;
+			case op_and:
+				top--;
+				stack[top - 1] = (stack[top - 1] != 0.0 && stack[top] != 0.0) ? 1.0 : 0.0;
+				break;
+			case op_or:
+				top--;
+				stack[top - 1] = (stack[top - 1] != 0.0 || stack[top] != 0.0) ? 1.0 : 0.0;
+				break;
+			case op_min:
+				top--;
+				stack[top - 1] = min(stack[top - 1], stack[top]);
+				break;
+			case op_max:
+				top--;
+				stack[top - 1] = max(stack[top - 1], stack[top]);
+				break;
+			case op_abs:
+				stack[top - 1] = fabs(stack[top - 1]);
+				break;
+			case op_clamp:
+				top -= 2;
+				stack[top - 1] = clamp(stack[top - 1], stack[top + 1], stack[top]);
+				break;
+		}
+	}
+
+	return stack[0];
+}
+
+static void expr_invalidate(expr_instance_data* data, size_t variable, size_t* last){
+	size_t u;
+
+	for(u = data->dependency_offset[variable]; u < data->dependency_offset[variable + 1]; u++){
+		data->dirty[data->dependency[u]] = 1;
+		*last = max(*last, data->dependency[u] + 1);
+	}
+}
+
+/*
+ * Evaluate all dirty expressions in definition order. Expressions only reference
+ * previously defined variables, so dependents always follow their inputs.
+ */
+static void expr_update(expr_instance_data* data, size_t first, size_t last){
+	size_t u, variable;
+	double result;
+	channel_value event;
+
+	for(u = first; u < last; u++){
+		if(!data->dirty[u]){
+			continue;
+		}
+		data->dirty[u] = 0;
+
+		variable = data->expression[u].variable;
+		result = expr_evaluate(data, data->expression + u);
+		if(result == data->value[variable]){
+			continue;
+		}
+
+		data->value[variable] = result;
+		expr_invalidate(data, variable, &last);
+
+		if(data->channel[variable]){
+			event.normalised = clamp(result, 1.0, 0.0);
+			event.raw.dbl = result;
+			mm_channel_event(data->channel[variable], event);
+		}
+	}
+}
+
+static int expr_set(instance* inst, size_t num, channel** c, channel_value* v){
+	expr_instance_data* data = (expr_instance_data*) inst->impl;
+	size_t n, first = data->expressions, last = 0;
+
+	for(n = 0; n < num; n++){
+		if(data->value[c[n]->ident] != v[n].normalised){
+			data->value[c[n]->ident] = v[n].normalised;
+			expr_invalidate(data, c[n]->ident, &last);
+		}
+	}
+
+	//find the first expression to update
+	for(n = 0; n < last; n++){
+		if(data->dirty[n]){
+			first = n;
+			break;
+		}
+	}
+
+	expr_update(data, first, last);
+	return 0;
+}
+
+static int expr_handle(size_t num, managed_fd* fds){
+	//no events generated here
+	return 0;
+}
+
+static int expr_start(){
+	size_t n, u, p, d;
+	instance** inst = NULL;
+	expr_instance_data* data = NULL;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (expr_instance_data*) inst[u]->impl;
+
+		data->stack = mm_calloc(max(data->stack_depth, 1), sizeof(double));
+		data->dirty = mm_calloc(max(data->expressions, 1), sizeof(uint8_t));
+		data->dependency_offset = mm_calloc(data->variables + 1, sizeof(size_t));
+		if(!data->stack || !data->dirty || !data->dependency_offset){
+			fprintf(stderr, "Failed to allocate memory\n");
+			goto bail;
+		}
+
+		//count variable references, each expression is listed once per variable it reads
+		for(p = 0; p < data->expressions; p++){
+			for(d = data->expression[p].start; d < data->expression[p].start + data->expression[p].length; d++){
+				if(data->op[d] == op_var){
+					data->dependency_offset[data->arg[d] + 1]++;
+				}
+			}
+		}
+
+		for(p = 0; p < data->variables; p++){
+			data->dependency_offset[p + 1] += data->dependency_offset[p];
+		}
+
+		data->dependency = mm_calloc(max(data->dependency_offset[data->variables], 1), sizeof(size_t));
+		if(!data->dependency){
+			fprintf(stderr, "Failed to allocate memory\n");
+			goto bail;
+		}
+
+		//fill the index, using the dirty flags to track the fill level per variable
+		for(p = 0; p < data->expressions; p++){
+			for(d = data->expression[p].start; d < data->expression[p].start + data->expression[p].length; d++){
+				if(data->op[d] == op_var){
+					data->dependency[data->dependency_offset[data->arg[d]]++] = p;
+				}
+			}
+		}
+
+		//restore the offsets shifted while filling
+		for(p = data->variables; p > 0; p--){
+			data->dependency_offset[p] = data->dependency_offset[p - 1];
+		}
+		data->dependency_offset[0] = 0;
+
+		//calculate and output initial values
+		for(p = 0; p < data->expressions; p++){
+			data->dirty[p] = 1;
+		}
+		expr_update(data, 0, data->expressions);
+
+		fprintf(stderr, "expr instance %s compiled %" PRIsize_t " expressions over %" PRIsize_t " variables into %" PRIsize_t " instructions\n",
+				inst[u]->name, data->expressions, data->variables, data->instructions);
+	}
+
+	rv = 0;
+bail:
+	free(inst);
+	return rv;
+}
+
+static int expr_shutdown(){
+	size_t n, u, p;
+	instance** inst = NULL;
+	expr_instance_data* data = NULL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (expr_instance_data*) inst[u]->impl;
+		for(p = 0; p < data->variables; p++){
+			mm_free(data->name[p]);
+		}
+		mm_free(data->name);
+		mm_free(data->value);
+		mm_free(data->channel);
+		mm_free(data->expression);
+		mm_free(data->dirty);
+		mm_free(data->op);
+		mm_free(data->arg);
+		mm_free(data->constant);
+		mm_free(data->stack);
+		mm_free(data->dependency_offset);
+		mm_free(data->dependency);
+		mm_free(inst[u]->impl);
+	}
+
+	free(inst);
+
+	fprintf(stderr, "expr backend shut down\n");
+	return 0;
+}
@@ -0,0 +1,66 @@
+#include "midimonster.h"
+
+int init();
+static int expr_configure(char* option, char* value);
+static int expr_configure_instance(instance* inst, char* option, char* value);
+static instance* expr_instance();
+static channel* expr_channel(instance* inst, char* spec);
+static int expr_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int expr_handle(size_t num, managed_fd* fds);
+static int expr_start();
+static int expr_shutdown();
+
+typedef enum {
+	op_const = 0,
+	op_var,
+	op_add,
+	op_sub,
+	op_mul,
+	op_div,
+	op_neg,
+	op_not,
+	op_lt,
+	op_gt,
+	op_le,
+	op_ge,
+	op_eq,
+	op_ne,
+	op_and,
+	op_or,
+	op_min,
+	op_max,
+	op_abs,
+	op_clamp
+} expr_opcode;
+
+/* One compiled expression, a slice of the instance program writing to `variable` */
+typedef struct /*_expr_expression*/ {
+	size_t variable;
+	size_t start;
+	size_t length;
+} expr_expression;
+
+typedef struct /*_expr_instance_data*/ {
+	//variables, each one available as a channel
+	size_t variables;
+	char** name;
+	double* value;
+	channel** channel;
+
+	size_t expressions;
+	expr_expression* expression;
+	uint8_t* dirty;
+
+	//program for all expressions, opcodes and arguments stored separately
+	size_t instructions;
+	uint8_t* op;
+	uint32_t* arg;
+	size_t constants;
+	double* constant;
+	size_t stack_depth;
+	double* stack;
+
+	//expressions reading each variable, in compressed row format
+	size_t* dependency_offset;
+	size_t* dependency;
+} expr_instance_data;
@@ -0,0 +1,305 @@
+#include <string.h>
+#include <math.h>
+#include "fade.h"
+
+#define BACKEND_NAME "fade"
+
+int init(){
+	backend fade = {
+		.name = BACKEND_NAME,
+		.conf = fade_configure,
+		.create = fade_instance,
+		.conf_instance = fade_configure_instance,
+		.channel = fade_channel,
+		.handle = fade_set,
+		.process = fade_handle,
+		.start = fade_start,
+		.shutdown = fade_shutdown,
+		.interval = fade_interval
+	};
+
+	//register backend
+	if(mm_backend_register(fade)){
+		fprintf(stderr, "Failed to register fade backend\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int fade_configure(char* option, char* value){
+	fprintf(stderr, "The fade backend does not take any global configuration\n");
+	return 1;
+}
+
+static int fade_configure_instance(instance* inst, char* option, char* value){
+	fade_instance_data* data = (fade_instance_data*) inst->impl;
+
+	if(!strcmp(option, "time")){
+		data->duration = strtoul(value, NULL, 10);
+		return 0;
+	}
+	else if(!strcmp(option, "rate")){
+		data->rate = strtoul(value, NULL, 10);
+		if(!data->rate || data->rate > 1000){
+			fprintf(stderr, "Invalid output rate %s for fade instance %s, must be between 1 and 1000\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "curve")){
+		if(!strcmp(value, "linear")){
+			data->curve = fade_linear;
+		}
+		else if(!strcmp(value, "scurve")){
+			data->curve = fade_scurve;
+		}
+		else if(!strcmp(value, "exponential")){
+			data->curve = fade_exponential;
+		}
+		else{
+			fprintf(stderr, "Unknown fade curve %s for instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown instance option %s for fade instance %s\n", option, inst->name);
+	return 1;
+}
+
+static instance* fade_instance(){
+	fade_instance_data* data = NULL;
+	instance* i = mm_instance();
+	if(!i){
+		return NULL;
+	}
+
+	data = mm_calloc(1, sizeof(fade_instance_data));
+	if(!data){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	data->duration = FADE_DEFAULT_TIME;
+	data->rate = FADE_DEFAULT_RATE;
+	i->impl = data;
+	return i;
+}
+
+static int fade_grow(fade_instance_data* data){
+	size_t n = data->n + 1;
+
+	data->name = mm_realloc(data->name, n * sizeof(char*));
+	data->channel = mm_realloc(data->channel, n * sizeof(channel*));
+	data->from = mm_realloc(data->from, n * sizeof(double));
+	data->to = mm_realloc(data->to, n * sizeof(double));
+	data->current = mm_realloc(data->current, n * sizeof(double));
+	data->start = mm_realloc(data->start, n * sizeof(uint64_t));
+	data->running = mm_realloc(data->running, n * sizeof(uint8_t));
+	data->fade = mm_realloc(data->fade, n * sizeof(size_t));
+	data->progress = mm_realloc(data->progress, n * sizeof(double));
+
+	if(!data->name || !data->channel || !data->from || !data->to || !data->current
+			|| !data->start || !data->running || !data->fade || !data->progress){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	data->from[data->n] = data->to[data->n] = data->current[data->n] = 0.0;
+	data->start[data->n] = 0;
+	data->running[data->n] = 0;
+	return 0;
+}
+
+static channel* fade_channel(instance* inst, char* spec){
+	size_t u;
+	fade_instance_data* data = (fade_instance_data*) inst->impl;
+
+	//find matching channel
+	for(u = 0; u < data->n; u++){
+		if(!strcmp(spec, data->name[u])){
+			break;
+		}
+	}
+
+	//allocate new channel
+	if(u == data->n){
+		if(fade_grow(data)){
+			return NULL;
+		}
+
+		data->name[u] = mm_strdup(spec);
+		data->channel[u] = mm_channel(inst, u, 1);
+		if(!data->name[u] || !data->channel[u]){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		data->n++;
+	}
+
+	return data->channel[u];
+}
+
+static int fade_set(instance* inst, size_t num, channel** c, channel_value* v){
+	size_t n, ident;
+	fade_instance_data* data = (fade_instance_data*) inst->impl;
+
+	for(n = 0; n < num; n++){
+		ident = c[n]->ident;
+
+		//start a new fade from the current value, replacing any running one
+		data->from[ident] = data->current[ident];
+		data->to[ident] = v[n].normalised;
+		data->start[ident] = mm_timestamp();
+
+		if(!data->running[ident]){
+			data->running[ident] = 1;
+			data->fade[data->active] = ident;
+			data->active++;
+		}
+	}
+
+	//output the first step immediately if the instance was idle
+	if(data->next < mm_timestamp()){
+		data->next = mm_timestamp();
+	}
+	return 0;
+}
+
+static void fade_process(fade_instance_data* data, uint64_t now){
+	size_t u, keep = 0, active = data->active;
+	size_t* fade = data->fade;
+	double* progress = data->progress;
+	double value;
+	channel_value event;
+
+	//calculate the linear progress of all running fades
+	for(u = 0; u < active; u++){
+		progress[u] = data->duration ? (double) (now - data->start[fade[u]]) / data->duration : 1.0;
+		progress[u] = (progress[u] > 1.0) ? 1.0 : progress[u];
+	}
+
+	//apply the fade curve
+	switch(data->curve){
+		case fade_scurve:
+			for(u = 0; u < active; u++){
+				progress[u] = progress[u] * progress[u] * (3.0 - 2.0 * progress[u]);
+			}
+			break;
+		case fade_exponential:
+			for(u = 0; u < active; u++){
+				progress[u] = (exp2(10.0 * progress[u]) - 1.0) / 1023.0;
+			}
+			break;
+		case fade_linear:
+			break;
+	}
+
+	//interpolate, output and drop finished fades
+	for(u = 0; u < active; u++){
+		value = data->from[fade[u]] + (data->to[fade[u]] - data->from[fade[u]]) * progress[u];
+		data->current[fade[u]] = value;
+
+		event.normalised = value;
+		event.raw.dbl = value;
+		mm_channel_event(data->channel[fade[u]], event);
+
+		if(progress[u] < 1.0){
+			fade[keep++] = fade[u];
+		}
+		else{
+			data->running[fade[u]] = 0;
+		}
+	}
+	data->active = keep;
+}
+
+static int fade_handle(size_t num, managed_fd* fds){
+	size_t n, u;
+	instance** inst = NULL;
+	fade_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (fade_instance_data*) inst[u]->impl;
+		if(!data->active || now < data->next){
+			continue;
+		}
+
+		fade_process(data, now);
+
+		//schedule the next tick without accumulating drift
+		data->next += 1000 / data->rate;
+		if(data->next <= now){
+			data->next = now + 1000 / data->rate;
+		}
+	}
+
+	free(inst);
+	return 0;
+}
+
+static uint32_t fade_interval(){
+	size_t n, u;
+	instance** inst = NULL;
+	fade_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+	uint32_t next = 1000;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return next;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (fade_instance_data*) inst[u]->impl;
+		if(data->active){
+			next = (data->next <= now) ? 0 : min(next, data->next - now);
+		}
+	}
+
+	free(inst);
+	return next;
+}
+
+static int fade_start(){
+	return 0;
+}
+
+static int fade_shutdown(){
+	size_t n, u, p;
+	instance** inst = NULL;
+	fade_instance_data* data = NULL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (fade_instance_data*) inst[u]->impl;
+		for(p = 0; p < data->n; p++){
+			mm_free(data->name[p]);
+		}
+		mm_free(data->name);
+		mm_free(data->channel);
+		mm_free(data->from);
+		mm_free(data->to);
+		mm_free(data->current);
+		mm_free(data->start);
+		mm_free(data->running);
+		mm_free(data->fade);
+		mm_free(data->progress);
+		mm_free(inst[u]->impl);
+	}
+
+	free(inst);
+
+	fprintf(stderr, "fade backend shut down\n");
+	return 0;
+}
@@ -0,0 +1,48 @@
+#include "midimonster.h"
+
+int init();
+static int fade_configure(char* option, char* value);
+static int fade_configure_instance(instance* inst, char* option, char* value);
+static instance* fade_instance();
+static channel* fade_channel(instance* inst, char* spec);
+static int fade_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int fade_handle(size_t num, managed_fd* fds);
+static uint32_t fade_interval();
+static int fade_start();
+static int fade_shutdown();
+
+#define FADE_DEFAULT_TIME 1000
+#define FADE_DEFAULT_RATE 50
+
+typedef enum {
+	fade_linear = 0,
+	fade_scurve,
+	fade_exponential
+} fade_curve;
+
+/*
+ * Per-channel fade state is kept as a structure of arrays indexed by the
+ * channel ident, so the per-tick processing runs as simple loops over
+ * contiguous data. Running fades are listed in `fade`, the matching
+ * entries of `progress` are scratch space for the current tick.
+ */
+typedef struct /*_fade_instance_data*/ {
+	size_t n;
+	char** name;
+	channel** channel;
+
+	uint32_t duration;
+	uint32_t rate;
+	fade_curve curve;
+	uint64_t next;
+
+	double* from;
+	double* to;
+	double* current;
+	uint64_t* start;
+	uint8_t* running;
+
+	size_t active;
+	size_t* fade;
+	double* progress;
+} fade_instance_data;
@@ -4,6 +4,7 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include "libmmbackend.h"
 #include "jack.h"
 #include <jack/midiport.h>
 #include <jack/metadata.h>
@@ -209,6 +210,11 @@ static int mmjack_process(jack_nframes_t nframes, void* instp){
 	return rv;
 }
 
+static void mmjack_thread_init(void* inst){
+	//apply the configured backend thread affinity to the jack processing thread
+	mm_thread_affinity();
+}
+
 static void mmjack_server_shutdown(void* inst){
 	fprintf(stderr, "jack server shutdown notification\n");
 	config.jack_shutdown = 1;
@@ -448,41 +454,63 @@ static int mmjack_set(instance* inst, size_t num, channel** c, channel_value* v)
 	mmjack_channel_ident ident = {
 		.label = 0
 	};
-	size_t u;
+	size_t u, p, block, narrow, wide;
 	double range;
-	uint16_t value;
-
-	for(u = 0; u < num; u++){
-		ident.label = c[u]->ident;
+	channel_value narrow_in[MMBACKEND_QUANTIZE_BLOCK], wide_in[MMBACKEND_QUANTIZE_BLOCK];
+	uint8_t value[MMBACKEND_QUANTIZE_BLOCK];
+	uint16_t bend[MMBACKEND_QUANTIZE_BLOCK], converted = 0;
+
+	for(u = 0; u < num; u += block){
+		//gather each block of the batch for the MIDI ports by output resolution and convert each in one pass
+		block = min(num - u, MMBACKEND_QUANTIZE_BLOCK);
+		for(p = 0, narrow = 0, wide = 0; p < block; p++){
+			ident.label = c[u + p]->ident;
+			if(data->port[ident.fields.port].type != port_midi){
+				continue;
+			}
 
-		if(data->port[ident.fields.port].input){
-			fprintf(stderr, "jack port %s.%s is an input port, no output is possible\n", inst->name, data->port[ident.fields.port].name);
-			continue;
+			if(ident.fields.sub_type == midi_pitchbend){
+				wide_in[wide++] = v[u + p];
+			}
+			else{
+				narrow_in[narrow++] = v[u + p];
+			}
 		}
-		range = data->port[ident.fields.port].max - data->port[ident.fields.port].min;
+		mmbackend_quantize_u8(narrow, narrow_in, 127, value, NULL);
+		mmbackend_quantize_u16(wide, wide_in, 16383, bend, NULL);
 
-		pthread_mutex_lock(&data->port[ident.fields.port].lock);
-		switch(data->port[ident.fields.port].type){
-			case port_cv:
-				//scale value to given range
-				data->port[ident.fields.port].last = (range * v[u].normalised) + data->port[ident.fields.port].min;
-				DBGPF("CV port %s updated to %f\n", data->port[ident.fields.port].name, data->port[ident.fields.port].last);
-				break;
-			case port_midi:
-				value = v[u].normalised * 127.0;
-				if(ident.fields.sub_type == midi_pitchbend){
-					value = ((uint16_t)(v[u].normalised * 16384.0));
-				}
-				if(mmjack_midiqueue_append(data->port + ident.fields.port, ident, value)){
-					pthread_mutex_unlock(&data->port[ident.fields.port].lock);
-					return 1;
-				}
-				break;
-			default:
-				fprintf(stderr, "No handler implemented for jack port type %s.%s\n", inst->name, data->port[ident.fields.port].name);
-				break;
+		for(p = 0, narrow = 0, wide = 0; p < block; p++){
+			ident.label = c[u + p]->ident;
+			if(data->port[ident.fields.port].type == port_midi){
+				converted = (ident.fields.sub_type == midi_pitchbend) ? bend[wide++] : value[narrow++];
+			}
+
+			if(data->port[ident.fields.port].input){
+				fprintf(stderr, "jack port %s.%s is an input port, no output is possible\n", inst->name, data->port[ident.fields.port].name);
+				continue;
+			}
+			range = data->port[ident.fields.port].max - data->port[ident.fields.port].min;
+
+			pthread_mutex_lock(&data->port[ident.fields.port].lock);
+			switch(data->port[ident.fields.port].type){
+				case port_cv:
+					//scale value to given range
+					data->port[ident.fields.port].last = (range * v[u + p].normalised) + data->port[ident.fields.port].min;
+					DBGPF("CV port %s updated to %f\n", data->port[ident.fields.port].name, data->port[ident.fields.port].last);
+					break;
+				case port_midi:
+					if(mmjack_midiqueue_append(data->port + ident.fields.port, ident,
+								converted)){
+						pthread_mutex_unlock(&data->port[ident.fields.port].lock);
+						return 1;
+					}
+					break;
+				default:
+					fprintf(stderr, "No handler implemented for jack port type %s.%s\n", inst->name, data->port[ident.fields.port].name);
+					break;
+			}
+			pthread_mutex_unlock(&data->port[ident.fields.port].lock);
 		}
-		pthread_mutex_unlock(&data->port[ident.fields.port].lock);
 	}
 
 	return 0;
@@ -653,6 +681,7 @@ static int mmjack_start(){
 
 		//connect jack callbacks
 		jack_set_process_callback(data->client, mmjack_process, inst[u]);
+		jack_set_thread_init_callback(data->client, mmjack_thread_init, inst[u]);
 		jack_on_shutdown(data->client, mmjack_server_shutdown, inst[u]);
 
 		fprintf(stderr, "jack instance %s assigned client name %s\n", inst[u]->name, jack_get_client_name(data->client));
@@ -1,4 +1,12 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sys/socket.h>
+#endif
+#include "midimonster.h"
 #include "libmmbackend.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 void mmbackend_parse_hostspec(char* spec, char** host, char** port){
 	size_t u = 0;
@@ -52,8 +60,73 @@ int mmbackend_parse_sockaddr(char* host, char* port, struct sockaddr_storage* ad
 	return 0;
 }
 
-int mmbackend_socket(char* host, char* port, int socktype, uint8_t listener, uint8_t mcast){
+//create and set up a socket for one resolved address, returns -1 if the address is not usable
+static int mmbackend_socket_open(struct addrinfo* addr, uint8_t listener, uint8_t mcast){
 	int fd = -1, status, yes = 1;
+
+	fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+	if(fd < 0){
+		return -1;
+	}
+
+	//set required socket options
+	yes = 1;
+	if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void*)&yes, sizeof(yes)) < 0){
+		fprintf(stderr, "Failed to enable SO_REUSEADDR on socket\n");
+	}
+
+	if(mcast){
+		yes = 1;
+		if(setsockopt(fd, SOL_SOCKET, SO_BROADCAST, (void*)&yes, sizeof(yes)) < 0){
+			fprintf(stderr, "Failed to enable SO_BROADCAST on socket\n");
+		}
+
+		yes = 0;
+		if(setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, (void*)&yes, sizeof(yes)) < 0){
+			fprintf(stderr, "Failed to disable IP_MULTICAST_LOOP on socket: %s\n", strerror(errno));
+		}
+	}
+
+	//set nonblocking before connecting so stream connections do not block the startup
+	#ifdef _WIN32
+	u_long mode = 1;
+	if(ioctlsocket(fd, FIONBIO, &mode) != NO_ERROR){
+		closesocket(fd);
+		return -1;
+	}
+	#else
+	int flags = fcntl(fd, F_GETFL, 0);
+	if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0){
+		fprintf(stderr, "Failed to set socket nonblocking\n");
+		close(fd);
+		return -1;
+	}
+	#endif
+
+	if(listener){
+		status = bind(fd, addr->ai_addr, addr->ai_addrlen);
+		if(status < 0){
+			close(fd);
+			return -1;
+		}
+	}
+	else{
+		status = connect(fd, addr->ai_addr, addr->ai_addrlen);
+		#ifdef _WIN32
+		if(status < 0 && WSAGetLastError() != WSAEWOULDBLOCK){
+		#else
+		if(status < 0 && errno != EINPROGRESS){
+		#endif
+			close(fd);
+			return -1;
+		}
+	}
+
+	return fd;
+}
+
+int mmbackend_socket(char* host, char* port, int socktype, uint8_t listener, uint8_t mcast){
+	int fd = -1, status;
 	struct addrinfo hints = {
 		.ai_family = AF_UNSPEC,
 		.ai_socktype = socktype,
@@ -69,74 +142,103 @@ int mmbackend_socket(char* host, char* port, int socktype, uint8_t listener, uin
 
 	//traverse the result list
 	for(addr_it = info; addr_it; addr_it = addr_it->ai_next){
-		fd = socket(addr_it->ai_family, addr_it->ai_socktype, addr_it->ai_protocol);
-		if(fd < 0){
-			continue;
+		fd = mmbackend_socket_open(addr_it, listener, mcast);
+		if(fd >= 0){
+			break;
 		}
+	}
+	freeaddrinfo(info);
 
-		//set required socket options
-		yes = 1;
-		if(setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, (void*)&yes, sizeof(yes)) < 0){
-			fprintf(stderr, "Failed to enable SO_REUSEADDR on socket\n");
-		}
+	if(!addr_it){
+		fprintf(stderr, "Failed to create socket for %s port %s\n", host, port);
+		return -1;
+	}
 
-		if(mcast){
-			yes = 1;
-			if(setsockopt(fd, SOL_SOCKET, SO_BROADCAST, (void*)&yes, sizeof(yes)) < 0){
-				fprintf(stderr, "Failed to enable SO_BROADCAST on socket\n");
-			}
+	return fd;
+}
 
-			yes = 0;
-			if(setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, (void*)&yes, sizeof(yes)) < 0){
-				fprintf(stderr, "Failed to disable IP_MULTICAST_LOOP on socket: %s\n", strerror(errno));
-			}
-		}
+int mmbackend_connect(char* host, char* port, mmbackend_connection* conn){
+	int status;
+	struct addrinfo hints = {
+		.ai_family = AF_UNSPEC,
+		.ai_socktype = SOCK_STREAM
+	};
 
-		if(listener){
-			status = bind(fd, addr_it->ai_addr, addr_it->ai_addrlen);
-			if(status < 0){
-				close(fd);
-				continue;
-			}
-		}
-		else{
-			status = connect(fd, addr_it->ai_addr, addr_it->ai_addrlen);
-			if(status < 0){
-				close(fd);
-				continue;
-			}
+	mmbackend_connect_free(conn);
+	status = getaddrinfo(host, port, &hints, &conn->info);
+	if(status){
+		fprintf(stderr, "Failed to parse address %s port %s: %s\n", host, port, gai_strerror(status));
+		conn->info = NULL;
+		return -1;
+	}
+
+	conn->next = conn->info;
+	return mmbackend_connect_next(conn);
+}
+
+int mmbackend_connect_next(mmbackend_connection* conn){
+	int fd = -1;
+	struct addrinfo* addr = NULL;
+
+	while(conn->next){
+		addr = conn->next;
+		conn->next = addr->ai_next;
+		fd = mmbackend_socket_open(addr, 0, 0);
+		if(fd >= 0){
+			return fd;
 		}
+	}
 
-		break;
+	//all candidates exhausted
+	mmbackend_connect_free(conn);
+	return -1;
+}
+
+void mmbackend_connect_free(mmbackend_connection* conn){
+	if(conn->info){
+		freeaddrinfo(conn->info);
 	}
-	freeaddrinfo(info);
+	conn->info = conn->next = NULL;
+}
 
-	if(!addr_it){
-		fprintf(stderr, "Failed to create socket for %s port %s\n", host, port);
+int mmbackend_connection_status(int fd){
+	int error = 0;
+	socklen_t error_len = sizeof(error);
+	fd_set write_fds, error_fds;
+	struct timeval tv = {
+		0
+	};
+
+	FD_ZERO(&write_fds);
+	FD_ZERO(&error_fds);
+	FD_SET(fd, &write_fds);
+	FD_SET(fd, &error_fds);
+
+	//a connecting stream socket becomes writable (or signals an exception on windows) once the attempt completes
+	if(select(fd + 1, NULL, &write_fds, &error_fds, &tv) < 0){
+		fprintf(stderr, "Failed to query connection status: %s\n", strerror(errno));
 		return -1;
 	}
 
-	//set nonblocking
-	#ifdef _WIN32
-	u_long mode = 1;
-	if(ioctlsocket(fd, FIONBIO, &mode) != NO_ERROR){
-		closesocket(fd);
+	if(!FD_ISSET(fd, &write_fds) && !FD_ISSET(fd, &error_fds)){
 		return 1;
 	}
-	#else
-	int flags = fcntl(fd, F_GETFL, 0);
-	if(fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0){
-		fprintf(stderr, "Failed to set socket nonblocking\n");
-		close(fd);
+
+	if(getsockopt(fd, SOL_SOCKET, SO_ERROR, (void*) &error, &error_len) < 0){
+		fprintf(stderr, "Failed to query socket error: %s\n", strerror(errno));
 		return -1;
 	}
-	#endif
 
-	return fd;
+	if(error){
+		fprintf(stderr, "Connection failed: %s\n", strerror(error));
+		return -1;
+	}
+	return 0;
 }
 
 int mmbackend_send(int fd, uint8_t* data, size_t length){
 	ssize_t total = 0, sent;
+	mm_trace(mm_trace_transmit, fd, length);
 	while(total < length){
 		sent = send(fd, data + total, length - total, 0);
 		if(sent < 0){
@@ -152,6 +254,229 @@ int mmbackend_send_str(int fd, char* data){
 	return mmbackend_send(fd, (uint8_t*) data, strlen(data));
 }
 
+int mmbackend_send_datagrams(int fd, size_t n, uint8_t** data, size_t* length){
+	size_t u = 0;
+	#ifdef __linux__
+	struct mmsghdr msg[MMBACKEND_DATAGRAM_BATCH];
+	struct iovec iov[MMBACKEND_DATAGRAM_BATCH];
+	size_t p, batch;
+	int sent;
+
+	for(; u < n; u += sent){
+		batch = min(n - u, MMBACKEND_DATAGRAM_BATCH);
+		memset(msg, 0, batch * sizeof(struct mmsghdr));
+		for(p = 0; p < batch; p++){
+			iov[p].iov_base = data[u + p];
+			iov[p].iov_len = length[u + p];
+			msg[p].msg_hdr.msg_iov = iov + p;
+			msg[p].msg_hdr.msg_iovlen = 1;
+			mm_trace(mm_trace_transmit, fd, length[u + p]);
+		}
+
+		sent = sendmmsg(fd, msg, batch, 0);
+		if(sent < 0){
+			fprintf(stderr, "Failed to send datagrams: %s\n", strerror(errno));
+			return 1;
+		}
+	}
+	#else
+	for(; u < n; u++){
+		mm_trace(mm_trace_transmit, fd, length[u]);
+		if(send(fd, data[u], length[u], 0) < 0){
+			fprintf(stderr, "Failed to send datagrams: %s\n", strerror(errno));
+			return 1;
+		}
+	}
+	#endif
+	return 0;
+}
+
+int mmbackend_send_datagram_multi(int fd, uint8_t* data, size_t length, size_t n, struct sockaddr_storage* dest, socklen_t* dest_len){
+	size_t u = 0;
+	int rv = 0;
+	#ifdef __linux__
+	struct mmsghdr msg[MMBACKEND_DATAGRAM_BATCH];
+	struct iovec iov = {
+		.iov_base = data,
+		.iov_len = length
+	};
+	size_t p, batch;
+	int sent;
+
+	for(; u < n; u += sent){
+		batch = min(n - u, MMBACKEND_DATAGRAM_BATCH);
+		memset(msg, 0, batch * sizeof(struct mmsghdr));
+		for(p = 0; p < batch; p++){
+			msg[p].msg_hdr.msg_name = dest + u + p;
+			msg[p].msg_hdr.msg_namelen = dest_len[u + p];
+			msg[p].msg_hdr.msg_iov = &iov;
+			msg[p].msg_hdr.msg_iovlen = 1;
+			mm_trace(mm_trace_transmit, fd, length);
+		}
+
+		sent = sendmmsg(fd, msg, batch, 0);
+		if(sent < 0){
+			//skip the failing destination
+			fprintf(stderr, "Failed to send datagram to destination %" PRIsize_t ": %s\n", u, strerror(errno));
+			sent = 1;
+			rv = 1;
+		}
+	}
+	#else
+	for(; u < n; u++){
+		mm_trace(mm_trace_transmit, fd, length);
+		if(sendto(fd, data, length, 0, (struct sockaddr*) (dest + u), dest_len[u]) < 0){
+			fprintf(stderr, "Failed to send datagram to destination %" PRIsize_t ": %s\n", u, strerror(errno));
+			rv = 1;
+		}
+	}
+	#endif
+	return rv;
+}
+
+//scale up to one block of normalised values to [0, max], clamped and rounded to the nearest step
+static void mmbackend_quantize_block(size_t n, channel_value* in, double max, uint32_t* out){
+	size_t u = 0;
+	double value;
+	#ifdef __SSE2__
+	__m128d low, high;
+	__m128d lower = _mm_setzero_pd(), upper = _mm_set1_pd(1.0), scale = _mm_set1_pd(max), half = _mm_set1_pd(0.5);
+
+	//the normalised values are interleaved with the raw values, so they are gathered pairwise
+	for(; u + 4 <= n; u += 4){
+		low = _mm_loadh_pd(_mm_load_sd(&in[u].normalised), &in[u + 1].normalised);
+		high = _mm_loadh_pd(_mm_load_sd(&in[u + 2].normalised), &in[u + 3].normalised);
+		//max returns the second operand for NaN input, matching the scalar path
+		low = _mm_add_pd(_mm_mul_pd(_mm_min_pd(_mm_max_pd(low, lower), upper), scale), half);
+		high = _mm_add_pd(_mm_mul_pd(_mm_min_pd(_mm_max_pd(high, lower), upper), scale), half);
+		_mm_storeu_si128((__m128i*) (out + u), _mm_unpacklo_epi64(_mm_cvttpd_epi32(low), _mm_cvttpd_epi32(high)));
+	}
+	#endif
+
+	for(; u < n; u++){
+		value = in[u].normalised;
+		value = (value > 0.0) ? value : 0.0;
+		value = (value < 1.0) ? value : 1.0;
+		out[u] = value * max + 0.5;
+	}
+}
+
+size_t mmbackend_quantize_u8(size_t n, channel_value* in, uint8_t max, uint8_t* out, uint64_t* changed){
+	uint32_t scaled[MMBACKEND_QUANTIZE_BLOCK];
+	size_t u, p, block, rv = 0;
+	uint64_t mask;
+
+	for(u = 0; u < n; u += block){
+		block = min(n - u, MMBACKEND_QUANTIZE_BLOCK);
+		mmbackend_quantize_block(block, in + u, max, scaled);
+
+		//the previous contents are only inspected when the changes are requested
+		if(!changed){
+			for(p = 0; p < block; p++){
+				out[u + p] = scaled[p];
+			}
+			continue;
+		}
+
+		mask = 0;
+		for(p = 0; p < block; p++){
+			mask |= ((uint64_t) (out[u + p] != scaled[p])) << p;
+			out[u + p] = scaled[p];
+		}
+
+		changed[u / MMBACKEND_QUANTIZE_BLOCK] = mask;
+		rv += __builtin_popcountll(mask);
+	}
+	return rv;
+}
+
+size_t mmbackend_quantize_u16(size_t n, channel_value* in, uint16_t max, uint16_t* out, uint64_t* changed){
+	uint32_t scaled[MMBACKEND_QUANTIZE_BLOCK];
+	size_t u, p, block, rv = 0;
+	uint64_t mask;
+
+	for(u = 0; u < n; u += block){
+		block = min(n - u, MMBACKEND_QUANTIZE_BLOCK);
+		mmbackend_quantize_block(block, in + u, max, scaled);
+
+		//the previous contents are only inspected when the changes are requested
+		if(!changed){
+			for(p = 0; p < block; p++){
+				out[u + p] = scaled[p];
+			}
+			continue;
+		}
+
+		mask = 0;
+		for(p = 0; p < block; p++){
+			mask |= ((uint64_t) (out[u + p] != scaled[p])) << p;
+			out[u + p] = scaled[p];
+		}
+
+		changed[u / MMBACKEND_QUANTIZE_BLOCK] = mask;
+		rv += __builtin_popcountll(mask);
+	}
+	return rv;
+}
+
+void mmbackend_merge_htp(size_t n, uint8_t* in, uint8_t* out){
+	size_t u = 0;
+	#ifdef __SSE2__
+	for(; u + 16 <= n; u += 16){
+		_mm_storeu_si128((__m128i*) (out + u), _mm_max_epu8(_mm_loadu_si128((__m128i*) (in + u)), _mm_loadu_si128((__m128i*) (out + u))));
+	}
+	#endif
+
+	for(; u < n; u++){
+		out[u] = max(in[u], out[u]);
+	}
+}
+
+void mmbackend_merge_ltp(size_t n, uint8_t* in, uint8_t* previous, uint8_t* out){
+	size_t u = 0;
+	#ifdef __SSE2__
+	__m128i next, unchanged;
+	for(; u + 16 <= n; u += 16){
+		next = _mm_loadu_si128((__m128i*) (in + u));
+		unchanged = _mm_cmpeq_epi8(next, _mm_loadu_si128((__m128i*) (previous + u)));
+		//keep the merged value where the source did not change, take the new one otherwise
+		_mm_storeu_si128((__m128i*) (out + u), _mm_or_si128(_mm_and_si128(unchanged, _mm_loadu_si128((__m128i*) (out + u))), _mm_andnot_si128(unchanged, next)));
+		_mm_storeu_si128((__m128i*) (previous + u), next);
+	}
+	#endif
+
+	for(; u < n; u++){
+		if(in[u] != previous[u]){
+			out[u] = previous[u] = in[u];
+		}
+	}
+}
+
+size_t mmbackend_update_u8(size_t n, uint8_t* next, uint8_t* current, uint64_t* changed){
+	size_t u, p, block, rv = 0;
+	uint64_t mask;
+
+	for(u = 0; u < n; u += block){
+		block = min(n - u, 64);
+		mask = 0;
+		p = 0;
+		#ifdef __SSE2__
+		for(; p + 16 <= block; p += 16){
+			//movemask yields the equal slots, invert to mark the changed ones
+			mask |= ((uint64_t) (~_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((__m128i*) (next + u + p)), _mm_loadu_si128((__m128i*) (current + u + p)))) & 0xFFFF)) << p;
+		}
+		#endif
+		for(; p < block; p++){
+			mask |= ((uint64_t) (next[u + p] != current[u + p])) << p;
+		}
+
+		memcpy(current + u, next + u, block);
+		changed[u / 64] = mask;
+		rv += __builtin_popcountll(mask);
+	}
+	return rv;
+}
+
 json_type json_identify(char* json, size_t length){
 	size_t n;
 
@@ -7,6 +7,7 @@
 #else
 #include <sys/socket.h>
 #include <netdb.h>
+#include <sys/select.h>
 #endif
 #include <ctype.h>
 #include <stdio.h>
@@ -15,6 +16,7 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include "../portability.h"
+#include "../midimonster.h"
 
 /*** BACKEND IMPLEMENTATION LIBRARY ***/
 
@@ -40,9 +42,44 @@ int mmbackend_parse_sockaddr(char* host, char* port, struct sockaddr_storage* ad
 /* 
  * Create a socket of given type and mode for a bind / connect host.
  * Returns -1 on failure, a valid file descriptor for the socket on success.
+ * The socket is set to nonblocking mode before connecting, so for stream
+ * sockets the connection may still be in progress when this call returns.
+ * Only the first address accepting the connection attempt is used, use
+ * mmbackend_connect for stream connections that should fall back to further
+ * addresses of the host when the attempt fails.
  */
 int mmbackend_socket(char* host, char* port, int socktype, uint8_t listener, uint8_t mcast);
 
+/*
+ * Resolved addresses of a host for an asynchronous stream connection.
+ * Zero-initialize before the first use of mmbackend_connect.
+ */
+typedef struct /*_mmbackend_connection*/ {
+	struct addrinfo* info;
+	struct addrinfo* next;
+} mmbackend_connection;
+
+/*
+ * Start a nonblocking stream connection to a host, keeping the addresses
+ * not yet tried in `conn`. Returns a file descriptor for the first address
+ * accepting the connection attempt, or -1 on failure.
+ * When the attempt fails later (see mmbackend_connection_status), close the
+ * descriptor and call mmbackend_connect_next to try the next address, which
+ * returns -1 once all addresses have been tried.
+ * Release the remaining addresses with mmbackend_connect_free once connected.
+ */
+int mmbackend_connect(char* host, char* port, mmbackend_connection* conn);
+int mmbackend_connect_next(mmbackend_connection* conn);
+void mmbackend_connect_free(mmbackend_connection* conn);
+
+/*
+ * Check the state of a nonblocking connection started by mmbackend_socket
+ * without waiting for it.
+ * Returns 0 when connected, 1 while the connection is still in progress
+ * and -1 if the connection attempt failed.
+ */
+int mmbackend_connection_status(int fd);
+
 /*
  * Send arbitrary data over multiple writes if necessary
  * Returns 1 on failure, 0 on success.
@@ -54,6 +91,69 @@ int mmbackend_send(int fd, uint8_t* data, size_t length);
  */
 int mmbackend_send_str(int fd, char* data);
 
+/* Maximum number of datagrams submitted with one system call */
+#define MMBACKEND_DATAGRAM_BATCH 64
+
+/*
+ * Send a batch of datagrams on a connected socket, submitting up to
+ * MMBACKEND_DATAGRAM_BATCH datagrams per system call where supported
+ * (sendmmsg on Linux) and one send per datagram elsewhere.
+ * Returns 1 on failure, 0 on success.
+ */
+int mmbackend_send_datagrams(int fd, size_t n, uint8_t** data, size_t* length);
+
+/*
+ * Send one datagram to n destinations on an unconnected socket, submitting
+ * up to MMBACKEND_DATAGRAM_BATCH datagrams per system call where supported
+ * (sendmmsg on Linux) and one sendto per destination elsewhere.
+ * Failing destinations do not prevent transmission to the others.
+ * Returns 1 if sending to any destination failed, 0 on success.
+ */
+int mmbackend_send_datagram_multi(int fd, uint8_t* data, size_t length, size_t n, struct sockaddr_storage* dest, socklen_t* dest_len);
+
+
+/** Value quantization **/
+
+/* Block size of the quantization kernels, suitable for stack buffers of converted values */
+#define MMBACKEND_QUANTIZE_BLOCK 64
+
+/*
+ * Convert n normalised channel values to integers in the range [0, max],
+ * clamping out-of-range input and rounding to the nearest step, e.g.
+ * max = 255 for DMX slots or max = 127 for 7-bit MIDI data.
+ * The results are written to out. If changed is not NULL, bit (u % 64) of
+ * changed[u / 64] is set when out[u] differed from its previous content,
+ * it needs to hold (n + 63) / 64 entries. Otherwise, the previous contents
+ * of out are not read and need not be initialized.
+ * Returns the number of values that changed, 0 if changed is NULL.
+ */
+size_t mmbackend_quantize_u8(size_t n, channel_value* in, uint8_t max, uint8_t* out, uint64_t* changed);
+size_t mmbackend_quantize_u16(size_t n, channel_value* in, uint16_t max, uint16_t* out, uint64_t* changed);
+
+
+/** Slot merging **/
+
+/*
+ * Merge n 8-bit slots from in into out, keeping the higher value for each slot
+ * (highest takes precedence).
+ */
+void mmbackend_merge_htp(size_t n, uint8_t* in, uint8_t* out);
+
+/*
+ * Merge n 8-bit slots from in into out, taking over only the slots that differ
+ * from the previous input of the same source (latest takes precedence).
+ * previous is updated to the content of in.
+ */
+void mmbackend_merge_ltp(size_t n, uint8_t* in, uint8_t* previous, uint8_t* out);
+
+/*
+ * Copy n 8-bit slots from next to current, marking the slots that changed
+ * in the same bitmask layout as the quantization kernels.
+ * changed needs to hold (n + 63) / 64 entries.
+ * Returns the number of slots that changed.
+ */
+size_t mmbackend_update_u8(size_t n, uint8_t* next, uint8_t* current, uint64_t* changed);
+
 
 /** JSON parsing **/
 
@@ -13,7 +13,8 @@ int init(){
 		.handle = loopback_set,
 		.process = loopback_handle,
 		.start = loopback_start,
-		.shutdown = loopback_shutdown
+		.shutdown = loopback_shutdown,
+		.passthrough = 1
 	};
 
 	//register backend
@@ -81,6 +82,7 @@ static channel* loopback_channel(instance* inst, char* spec){
 
 static int loopback_set(instance* inst, size_t num, channel** c, channel_value* v){
 	size_t n;
+	//routes through loopback channels are resolved by the core, only channels with a merge policy are delivered here
 	for(n = 0; n < num; n++){
 		mm_channel_event(c[n], v[n]);
 	}
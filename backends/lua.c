@@ -6,6 +6,9 @@
 #ifdef MMBACKEND_LUA_TIMERFD
 #include <sys/timerfd.h>
 #endif
+#ifdef MMBACKEND_LUA_INOTIFY
+#include <sys/inotify.h>
+#endif
 
 #define BACKEND_NAME "lua"
 #define LUA_REGISTRY_KEY "_midimonster_lua_instance"
@@ -18,6 +21,9 @@ static int timer_fd = -1;
 #else
 static uint64_t last_timestamp;
 #endif
+#ifdef MMBACKEND_LUA_INOTIFY
+static int watch_fd = -1;
+#endif
 
 int init(){
 	backend lua = {
@@ -119,6 +125,20 @@ static int lua_update_timerfd(){
 	return 0;
 }
 
+//report the interpreter heap, which is not allocated through the core, for the memory statistics
+static void lua_report_memory(lua_State* interpreter){
+	instance* inst = NULL;
+
+	lua_pushstring(interpreter, LUA_REGISTRY_KEY);
+	lua_gettable(interpreter, LUA_REGISTRYINDEX);
+	inst = (instance*) lua_touserdata(interpreter, -1);
+	lua_pop(interpreter, 1);
+
+	if(inst){
+		mm_memory_external(inst, lua_gc(interpreter, LUA_GCCOUNT, 0) * 1024 + lua_gc(interpreter, LUA_GCCOUNTB, 0));
+	}
+}
+
 static int lua_callback_output(lua_State* interpreter){
 	size_t n = 0;
 	channel_value val;
@@ -213,7 +233,7 @@ static int lua_callback_interval(lua_State* interpreter){
 	}
 	else if(interval){
 		//append new timer
-		timer = realloc(timer, (timers + 1) * sizeof(lua_timer));
+		timer = mm_realloc(timer, (timers + 1) * sizeof(lua_timer));
 		if(!timer){
 			fprintf(stderr, "Failed to allocate memory\n");
 			timers = 0;
@@ -254,7 +274,7 @@ static int lua_callback_value(lua_State* interpreter, uint8_t input){
 	//find correct channel & return value
 	for(n = 0; n < data->channels; n++){
 		if(!strcmp(channel_name, data->channel_name[n])){
-			lua_pushnumber(data->interpreter, (input) ? data->input[n] : data->output[n]);
+			lua_pushnumber(interpreter, (input) ? data->input[n] : data->output[n]);
 			return 1;
 		}
 	}
@@ -285,6 +305,40 @@ static int lua_configure_instance(instance* inst, char* option, char* value){
 			fprintf(stderr, "Failed to load lua source file %s for instance %s: %s\n", value, inst->name, lua_tostring(data->interpreter, -1));
 			return 1;
 		}
+		lua_report_memory(data->interpreter);
+
+		//remember the file for reloading
+		data->script = mm_realloc(data->script, (data->scripts + 1) * sizeof(char*));
+		data->watch = mm_realloc(data->watch, (data->scripts + 1) * sizeof(int));
+		if(!data->script || !data->watch){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		data->watch[data->scripts] = -1;
+		data->script[data->scripts] = mm_strdup(value);
+		if(!data->script[data->scripts]){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		data->scripts++;
+		return 0;
+	}
+	else if(!strcmp(option, "reload")){
+		#ifdef MMBACKEND_LUA_INOTIFY
+		data->reload = strcmp(value, "off") ? 1 : 0;
+		return 0;
+		#else
+		fprintf(stderr, "Reloading lua scripts is not supported on this platform\n");
+		return 1;
+		#endif
+	}
+	else if(!strcmp(option, "preserve")){
+		mm_free(data->preserve);
+		data->preserve = mm_strdup(value);
+		if(!data->preserve){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
 		return 0;
 	}
 
@@ -292,37 +346,45 @@ static int lua_configure_instance(instance* inst, char* option, char* value){
 	return 1;
 }
 
+static lua_State* lua_interpreter(instance* inst){
+	lua_State* interpreter = luaL_newstate();
+	if(!interpreter){
+		fprintf(stderr, "Failed to initialize LUA\n");
+		return NULL;
+	}
+	luaL_openlibs(interpreter);
+
+	//register lua interface functions
+	lua_register(interpreter, "output", lua_callback_output);
+	lua_register(interpreter, "interval", lua_callback_interval);
+	lua_register(interpreter, "input_value", lua_callback_input_value);
+	lua_register(interpreter, "output_value", lua_callback_output_value);
+
+	//store instance pointer to the lua state
+	lua_pushstring(interpreter, LUA_REGISTRY_KEY);
+	lua_pushlightuserdata(interpreter, (void *) inst);
+	lua_settable(interpreter, LUA_REGISTRYINDEX);
+	return interpreter;
+}
+
 static instance* lua_instance(){
 	instance* inst = mm_instance();
 	if(!inst){
 		return NULL;
 	}
 
-	lua_instance_data* data = calloc(1, sizeof(lua_instance_data));
+	lua_instance_data* data = mm_calloc(1, sizeof(lua_instance_data));
 	if(!data){
 		fprintf(stderr, "Failed to allocate memory\n");
 		return NULL;
 	}
 
 	//load the interpreter
-	data->interpreter = luaL_newstate();
+	data->interpreter = lua_interpreter(inst);
 	if(!data->interpreter){
-		fprintf(stderr, "Failed to initialize LUA\n");
-		free(data);
+		mm_free(data);
 		return NULL;
 	}
-	luaL_openlibs(data->interpreter);
-
-	//register lua interface functions
-	lua_register(data->interpreter, "output", lua_callback_output);
-	lua_register(data->interpreter, "interval", lua_callback_interval);
-	lua_register(data->interpreter, "input_value", lua_callback_input_value);
-	lua_register(data->interpreter, "output_value", lua_callback_output_value);
-
-	//store instance pointer to the lua state
-	lua_pushstring(data->interpreter, LUA_REGISTRY_KEY);
-	lua_pushlightuserdata(data->interpreter, (void *) inst);
-	lua_settable(data->interpreter, LUA_REGISTRYINDEX);
 
 	inst->impl = data;
 	return inst;
@@ -341,10 +403,10 @@ static channel* lua_channel(instance* inst, char* spec){
 
 	//allocate new channel
 	if(u == data->channels){
-		data->channel_name = realloc(data->channel_name, (u + 1) * sizeof(char*));
-		data->reference = realloc(data->reference, (u + 1) * sizeof(int));
-		data->input = realloc(data->input, (u + 1) * sizeof(double));
-		data->output = realloc(data->output, (u + 1) * sizeof(double));
+		data->channel_name = mm_realloc(data->channel_name, (u + 1) * sizeof(char*));
+		data->reference = mm_realloc(data->reference, (u + 1) * sizeof(int));
+		data->input = mm_realloc(data->input, (u + 1) * sizeof(double));
+		data->output = mm_realloc(data->output, (u + 1) * sizeof(double));
 		if(!data->channel_name || !data->reference || !data->input || !data->output){
 			fprintf(stderr, "Failed to allocate memory\n");
 			return NULL;
@@ -352,7 +414,7 @@ static channel* lua_channel(instance* inst, char* spec){
 
 		data->reference[u] = LUA_NOREF;
 		data->input[u] = data->output[u] = 0.0;
-		data->channel_name[u] = strdup(spec);
+		data->channel_name[u] = mm_strdup(spec);
 		if(!data->channel_name[u]){
 			fprintf(stderr, "Failed to allocate memory\n");
 			return NULL;
@@ -380,16 +442,187 @@ static int lua_set(instance* inst, size_t num, channel** c, channel_value* v){
 			}
 		}
 	}
+	lua_report_memory(data->interpreter);
+	return 0;
+}
+
+static void lua_resolve_handlers(lua_instance_data* data){
+	size_t p;
+
+	for(p = 0; p < data->channels; p++){
+		data->reference[p] = LUA_NOREF;
+		//exclude reserved names
+		if(strcmp(data->channel_name[p], "output")
+				&& strcmp(data->channel_name[p], "input_value")
+				&& strcmp(data->channel_name[p], "output_value")
+				&& strcmp(data->channel_name[p], "interval")){
+			lua_getglobal(data->interpreter, data->channel_name[p]);
+			data->reference[p] = luaL_ref(data->interpreter, LUA_REGISTRYINDEX);
+			if(data->reference[p] == LUA_REFNIL){
+				data->reference[p] = LUA_NOREF;
+			}
+		}
+	}
+}
+
+#ifdef MMBACKEND_LUA_INOTIFY
+//remove all timers registered by an interpreter
+static void lua_timers_remove(lua_State* interpreter){
+	size_t n;
+
+	for(n = 0; n < timers;){
+		if(timer[n].interpreter == interpreter){
+			timers--;
+			memmove(timer + n, timer + n + 1, (timers - n) * sizeof(lua_timer));
+			continue;
+		}
+		n++;
+	}
+	lua_update_timerfd();
+}
+
+//copy a value to another interpreter, values that can not be transferred (e.g. functions) become nil
+static void lua_transfer_value(lua_State* from, int index, lua_State* to, size_t depth){
+	size_t length;
+	const char* string = NULL;
+
+	index = lua_absindex(from, index);
+	switch(lua_type(from, index)){
+		case LUA_TBOOLEAN:
+			lua_pushboolean(to, lua_toboolean(from, index));
+			break;
+		case LUA_TNUMBER:
+			if(lua_isinteger(from, index)){
+				lua_pushinteger(to, lua_tointeger(from, index));
+			}
+			else{
+				lua_pushnumber(to, lua_tonumber(from, index));
+			}
+			break;
+		case LUA_TSTRING:
+			string = lua_tolstring(from, index, &length);
+			lua_pushlstring(to, string, length);
+			break;
+		case LUA_TTABLE:
+			lua_newtable(to);
+			if(depth < LUA_PRESERVE_DEPTH){
+				lua_pushnil(from);
+				while(lua_next(from, index)){
+					//only keys of plain types are transferred
+					if(lua_type(from, -2) == LUA_TNUMBER
+							|| lua_type(from, -2) == LUA_TSTRING
+							|| lua_type(from, -2) == LUA_TBOOLEAN){
+						lua_transfer_value(from, -2, to, depth + 1);
+						lua_transfer_value(from, -1, to, depth + 1);
+						lua_settable(to, -3);
+					}
+					lua_pop(from, 1);
+				}
+			}
+			break;
+		default:
+			lua_pushnil(to);
+	}
+}
+
+//run the scripts of an instance in a new interpreter, replacing the current one only on success
+static int lua_reload(instance* inst){
+	lua_instance_data* data = (lua_instance_data*) inst->impl;
+	lua_State* interpreter = lua_interpreter(inst);
+	size_t u;
+
+	if(!interpreter){
+		return 1;
+	}
+
+	//the preserved table is available while the scripts are run
+	if(data->preserve){
+		lua_getglobal(data->interpreter, data->preserve);
+		lua_transfer_value(data->interpreter, -1, interpreter, 0);
+		lua_pop(data->interpreter, 1);
+		lua_setglobal(interpreter, data->preserve);
+	}
+
+	for(u = 0; u < data->scripts; u++){
+		if(luaL_dofile(interpreter, data->script[u])){
+			fprintf(stderr, "Failed to reload lua source file %s for instance %s, keeping the previous version: %s\n", data->script[u], inst->name, lua_tostring(interpreter, -1));
+			lua_timers_remove(interpreter);
+			lua_close(interpreter);
+			return 1;
+		}
+	}
+
+	//channel values are kept in the instance and remain valid for the new interpreter
+	lua_timers_remove(data->interpreter);
+	lua_close(data->interpreter);
+	data->interpreter = interpreter;
+	lua_resolve_handlers(data);
+	lua_report_memory(interpreter);
+	fprintf(stderr, "Reloaded lua instance %s\n", inst->name);
 	return 0;
 }
 
+static void lua_watch_process(){
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+	struct inotify_event* event = NULL;
+	ssize_t bytes, offset;
+	size_t n, u, p;
+	instance** inst = NULL;
+	lua_instance_data* data = NULL;
+	char* name = NULL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return;
+	}
+
+	//mark the instances with modified scripts
+	while((bytes = read(watch_fd, buffer, sizeof(buffer))) > 0){
+		for(offset = 0; offset < bytes; offset += sizeof(struct inotify_event) + event->len){
+			event = (struct inotify_event*) (buffer + offset);
+			for(u = 0; event->len && u < n; u++){
+				data = (lua_instance_data*) inst[u]->impl;
+				for(p = 0; p < data->scripts; p++){
+					name = strrchr(data->script[p], '/') ? strrchr(data->script[p], '/') + 1 : data->script[p];
+					if(data->watch[p] == event->wd && !strcmp(name, event->name)){
+						data->modified = 1;
+					}
+				}
+			}
+		}
+	}
+
+	//reload each instance only once, even if multiple of its scripts changed
+	for(u = 0; u < n; u++){
+		data = (lua_instance_data*) inst[u]->impl;
+		if(data->modified){
+			data->modified = 0;
+			lua_reload(inst[u]);
+		}
+	}
+	free(inst);
+}
+#endif
+
 static int lua_handle(size_t num, managed_fd* fds){
 	uint64_t delta = timer_interval;
 	size_t n;
 
 	#ifdef MMBACKEND_LUA_TIMERFD
-	uint8_t read_buffer[100];
-	if(!num){
+	uint8_t read_buffer[100], expired = 0;
+
+	//scripts are reloaded between processing cycles, timers only run when their descriptor was signaled
+	for(n = 0; n < num; n++){
+		#ifdef MMBACKEND_LUA_INOTIFY
+		if(fds[n].fd == watch_fd){
+			lua_watch_process();
+			continue;
+		}
+		#endif
+		expired = 1;
+	}
+
+	if(!expired){
 		return 0;
 	}
 
@@ -420,6 +653,7 @@ static int lua_handle(size_t num, managed_fd* fds){
 				timer[n].delta %= timer[n].interval;
 				lua_rawgeti(timer[n].interpreter, LUA_REGISTRYINDEX, timer[n].reference);
 				lua_pcall(timer[n].interpreter, 0, 0, 0);
+				lua_report_memory(timer[n].interpreter);
 			}
 		}
 	}
@@ -427,9 +661,13 @@ static int lua_handle(size_t num, managed_fd* fds){
 }
 
 static int lua_start(){
-	size_t n, u, p;
+	size_t n, u;
 	instance** inst = NULL;
 	lua_instance_data* data = NULL;
+	#ifdef MMBACKEND_LUA_INOTIFY
+	size_t p;
+	char* separator = NULL;
+	#endif
 
 	//fetch all defined instances
 	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
@@ -440,19 +678,35 @@ static int lua_start(){
 	//resolve channels to their handler functions
 	for(u = 0; u < n; u++){
 		data = (lua_instance_data*) inst[u]->impl;
-		for(p = 0; p < data->channels; p++){
-			//exclude reserved names
-			if(strcmp(data->channel_name[p], "output")
-					&& strcmp(data->channel_name[p], "input_value")
-					&& strcmp(data->channel_name[p], "output_value")
-					&& strcmp(data->channel_name[p], "interval")){
-				lua_getglobal(data->interpreter, data->channel_name[p]);
-				data->reference[p] = luaL_ref(data->interpreter, LUA_REGISTRYINDEX);
-				if(data->reference[p] == LUA_REFNIL){
-					data->reference[p] = LUA_NOREF;
+		lua_resolve_handlers(data);
+
+		#ifdef MMBACKEND_LUA_INOTIFY
+		//watch the directories containing the scripts, as editors commonly replace files instead of writing to them
+		for(p = 0; data->reload && p < data->scripts; p++){
+			if(watch_fd < 0){
+				watch_fd = inotify_init1(IN_NONBLOCK);
+				if(watch_fd < 0 || mm_manage_fd(watch_fd, BACKEND_NAME, 1, NULL)){
+					fprintf(stderr, "Failed to watch Lua scripts for changes: %s\n", strerror(errno));
+					free(inst);
+					return 1;
 				}
 			}
+
+			separator = strrchr(data->script[p], '/');
+			if(separator){
+				*separator = 0;
+				data->watch[p] = inotify_add_watch(watch_fd, data->script[p], IN_CLOSE_WRITE | IN_MOVED_TO);
+				*separator = '/';
+			}
+			else{
+				data->watch[p] = inotify_add_watch(watch_fd, ".", IN_CLOSE_WRITE | IN_MOVED_TO);
+			}
+
+			if(data->watch[p] < 0){
+				fprintf(stderr, "Failed to watch Lua script %s for changes: %s\n", data->script[p], strerror(errno));
+			}
 		}
+		#endif
 	}
 
 	free(inst);
@@ -484,24 +738,36 @@ static int lua_shutdown(){
 		lua_close(data->interpreter);
 		//cleanup channel data
 		for(p = 0; p < data->channels; p++){
-			free(data->channel_name[p]);
+			mm_free(data->channel_name[p]);
 		}
-		free(data->channel_name);
-		free(data->reference);
-		free(data->input);
-		free(data->output);
-		free(inst[u]->impl);
+		mm_free(data->channel_name);
+		mm_free(data->reference);
+		mm_free(data->input);
+		mm_free(data->output);
+		for(p = 0; p < data->scripts; p++){
+			mm_free(data->script[p]);
+		}
+		mm_free(data->script);
+		mm_free(data->watch);
+		mm_free(data->preserve);
+		mm_free(inst[u]->impl);
 	}
 
 	free(inst);
 	//free module-global data
-	free(timer);
+	mm_free(timer);
 	timer = NULL;
 	timers = 0;
 	#ifdef MMBACKEND_LUA_TIMERFD
 	close(timer_fd);
 	timer_fd = -1;
 	#endif
+	#ifdef MMBACKEND_LUA_INOTIFY
+	if(watch_fd >= 0){
+		close(watch_fd);
+	}
+	watch_fd = -1;
+	#endif
 
 	fprintf(stderr, "Lua backend shut down\n");
 	return 0;
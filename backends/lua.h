@@ -7,8 +7,12 @@
 //OSX and Windows don't have the cool new toys...
 #ifdef __linux__
 	#define MMBACKEND_LUA_TIMERFD
+	#define MMBACKEND_LUA_INOTIFY
 #endif
 
+/* Maximum nesting depth of preserved tables transferred on reload */
+#define LUA_PRESERVE_DEPTH 16
+
 int init();
 static int lua_configure(char* option, char* value);
 static int lua_configure_instance(instance* inst, char* option, char* value);
@@ -27,6 +31,14 @@ typedef struct /*_lua_instance_data*/ {
 	double* input;
 	double* output;
 	lua_State* interpreter;
+
+	//script files and the watches on their directories for reloading
+	size_t scripts;
+	char** script;
+	int* watch;
+	uint8_t reload;
+	uint8_t modified;
+	char* preserve;
 } lua_instance_data;
 
 typedef struct /*_lua_interval_callback*/ {
@@ -18,6 +18,7 @@ static uint64_t last_keepalive = 0;
 static uint64_t update_interval = 50;
 static uint64_t last_update = 0;
 static uint64_t updates_inflight = 0;
+static uint8_t connections_pending = 0;
 
 static maweb_command_key cmdline_keys[] = {
 	{"PREV", 109, 0, 1}, {"SET", 108, 1, 0, 1}, {"NEXT", 110, 0, 1},
@@ -628,13 +629,47 @@ static int maweb_connect(instance* inst){
 	//unregister old fd from core
 	if(data->fd >= 0){
 		mm_manage_fd(data->fd, BACKEND_NAME, 0, NULL);
+		close(data->fd);
 	}
 
-	data->fd = mmbackend_socket(data->host, data->port ? data->port : MAWEB_DEFAULT_PORT, SOCK_STREAM, 0, 0);
+	//the connection is completed asynchronously in maweb_connected
+	connections_pending = 1;
+	data->last_connect = mm_timestamp();
+	data->fd = mmbackend_connect(data->host, data->port ? data->port : MAWEB_DEFAULT_PORT, &data->connection);
 	if(data->fd < 0){
+		data->state = ws_closed;
 		return 1;
 	}
 
+	data->state = ws_connecting;
+	data->offset = 0;
+	data->login = 0;
+	return 0;
+}
+
+static int maweb_connected(instance* inst){
+	maweb_instance_data* data = (maweb_instance_data*) inst->impl;
+
+	switch(mmbackend_connection_status(data->fd)){
+		case 1:
+			//still waiting
+			return 0;
+		case 0:
+			break;
+		default:
+			//continue with the next address of the host
+			close(data->fd);
+			data->fd = mmbackend_connect_next(&data->connection);
+			if(data->fd >= 0){
+				return 0;
+			}
+			fprintf(stderr, "maweb instance %s failed to connect, retrying in %d seconds\n", inst->name, MAWEB_CONNECTION_KEEPALIVE / 1000);
+			data->state = ws_closed;
+			return 0;
+	}
+
+	mmbackend_connect_free(&data->connection);
+	fprintf(stderr, "maweb instance %s connected after %" PRIu64 " msec\n", inst->name, mm_timestamp() - data->last_connect);
 	data->state = ws_new;
 	if(mmbackend_send_str(data->fd, "GET /?ma=1 HTTP/1.1\r\n")
 			|| mmbackend_send_str(data->fd, "Connection: Upgrade\r\n")
@@ -644,16 +679,23 @@ static int maweb_connect(instance* inst){
 			//and the whole websocket 'accept key' dance is plenty stupid as it is
 			|| mmbackend_send_str(data->fd, "Sec-WebSocket-Key: rbEQrXMEvCm4ZUjkj6juBQ==\r\n")
 			|| mmbackend_send_str(data->fd, "\r\n")){
-		fprintf(stderr, "maweb backend failed to communicate with peer\n");
-		return 1;
+		fprintf(stderr, "maweb instance %s failed to communicate with peer, retrying in %d seconds\n", inst->name, MAWEB_CONNECTION_KEEPALIVE / 1000);
+		goto retry;
 	}
 
 	//register new fd
 	if(mm_manage_fd(data->fd, BACKEND_NAME, 1, (void*) inst)){
 		fprintf(stderr, "maweb backend failed to register fd\n");
-		return 1;
+		goto retry;
 	}
 	return 0;
+
+retry:
+	//the connection is restarted from maweb_handle
+	close(data->fd);
+	data->fd = -1;
+	data->state = ws_closed;
+	return 0;
 }
 
 static ssize_t maweb_handle_lines(instance* inst, ssize_t bytes_read){
@@ -784,6 +826,7 @@ static int maweb_handle_fd(instance* inst){
 			case ws_open:
 				bytes_handled = maweb_handle_ws(inst, bytes_read);
 				break;
+			case ws_connecting:
 			case ws_closed:
 				bytes_handled = data->offset + bytes_read;
 				break;
@@ -965,6 +1008,38 @@ static int maweb_poll(){
 	return 0;
 }
 
+static int maweb_connections(){
+	size_t n, u;
+	int rv = 0;
+	instance** inst = NULL;
+	maweb_instance_data* data = NULL;
+
+	//fetch all defined instances
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	//complete pending connections, retry failed ones
+	connections_pending = 0;
+	for(u = 0; u < n; u++){
+		data = (maweb_instance_data*) inst[u]->impl;
+		if(data->state == ws_connecting){
+			rv |= maweb_connected(inst[u]);
+		}
+		else if(data->state == ws_closed && mm_timestamp() - data->last_connect >= MAWEB_CONNECTION_KEEPALIVE){
+			maweb_connect(inst[u]);
+		}
+
+		if(data->state == ws_connecting || data->state == ws_closed){
+			connections_pending = 1;
+		}
+	}
+
+	free(inst);
+	return rv;
+}
+
 static int maweb_handle(size_t num, managed_fd* fds){
 	size_t n = 0;
 	int rv = 0;
@@ -973,6 +1048,10 @@ static int maweb_handle(size_t num, managed_fd* fds){
 		rv |= maweb_handle_fd((instance*) fds[n].impl);
 	}
 
+	if(connections_pending){
+		rv |= maweb_connections();
+	}
+
 	//FIXME all keepalive processing allocates temporary buffers, this might an optimization target
 	if(last_keepalive && mm_timestamp() - last_keepalive >= MAWEB_CONNECTION_KEEPALIVE){
 		rv |= maweb_keepalive();
@@ -1008,11 +1087,16 @@ static int maweb_start(){
 			data->channel[p].chan->ident = p;
 		}
 
-		if(maweb_connect(inst[u])){
-			fprintf(stderr, "Failed to open connection to MA Web Remote for instance %s\n", inst[u]->name);
+		if(!data->host){
+			fprintf(stderr, "maweb instance %s has no host configured\n", inst[u]->name);
 			free(inst);
 			return 1;
 		}
+
+		//connections are established asynchronously, a missing console does not hold up the startup
+		if(maweb_connect(inst[u])){
+			fprintf(stderr, "Failed to open connection to MA Web Remote for instance %s, retrying in %d seconds\n", inst[u]->name, MAWEB_CONNECTION_KEEPALIVE / 1000);
+		}
 	}
 
 	free(inst);
@@ -1020,7 +1104,7 @@ static int maweb_start(){
 		return 0;
 	}
 
-	fprintf(stderr, "maweb backend registering %" PRIsize_t " descriptors to core\n", n);
+	fprintf(stderr, "maweb backend connecting %" PRIsize_t " instances\n", n);
 
 	//initialize timeouts
 	last_keepalive = last_update = mm_timestamp();
@@ -1051,6 +1135,7 @@ static int maweb_shutdown(){
 
 		close(data->fd);
 		data->fd = -1;
+		mmbackend_connect_free(&data->connection);
 
 		free(data->buffer);
 		data->buffer = NULL;
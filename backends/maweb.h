@@ -36,6 +36,7 @@ typedef enum /*_maweb_peer_type*/ {
 } maweb_peer_type;
 
 typedef enum /*_ws_conn_state*/ {
+	ws_connecting,
 	ws_new,
 	ws_http,
 	ws_open,
@@ -94,6 +95,8 @@ typedef struct /*_maweb_instance_data*/ {
 
 	int fd;
 	maweb_state state;
+	mmbackend_connection connection;
+	uint64_t last_connect;
 	size_t offset;
 	size_t allocated;
 	uint8_t* buffer;
@@ -1,5 +1,6 @@
 #include <string.h>
 #include <alsa/asoundlib.h>
+#include "libmmbackend.h"
 #include "midi.h"
 
 #define BACKEND_NAME "midi"
@@ -197,43 +198,63 @@ static channel* midi_channel(instance* inst, char* spec){
 }
 
 static int midi_set(instance* inst, size_t num, channel** c, channel_value* v){
-	size_t u;
+	size_t u, p, block, narrow, wide;
+	channel_value narrow_in[MMBACKEND_QUANTIZE_BLOCK], wide_in[MMBACKEND_QUANTIZE_BLOCK];
+	uint8_t value[MMBACKEND_QUANTIZE_BLOCK];
+	uint16_t bend[MMBACKEND_QUANTIZE_BLOCK], converted;
 	snd_seq_event_t ev;
 	midi_instance_data* data = (midi_instance_data*) inst->impl;
 	midi_channel_ident ident = {
 		.label = 0
 	};
 
-	for(u = 0; u < num; u++){
-		ident.label = c[u]->ident;
-
-		snd_seq_ev_clear(&ev);
-		snd_seq_ev_set_source(&ev, data->port);
-		snd_seq_ev_set_subs(&ev);
-		snd_seq_ev_set_direct(&ev);
-
-		switch(ident.fields.type){
-			case note:
-				snd_seq_ev_set_noteon(&ev, ident.fields.channel, ident.fields.control, v[u].normalised * 127.0);
-				break;
-			case cc:
-				snd_seq_ev_set_controller(&ev, ident.fields.channel, ident.fields.control, v[u].normalised * 127.0);
-				break;
-			case pressure:
-				snd_seq_ev_set_keypress(&ev, ident.fields.channel, ident.fields.control, v[u].normalised * 127.0);
-				break;
-			case pitchbend:
-				snd_seq_ev_set_pitchbend(&ev, ident.fields.channel, (v[u].normalised * 16383.0) - 8192);
-				break;
-			case aftertouch:
-				snd_seq_ev_set_chanpress(&ev, ident.fields.channel, v[u].normalised * 127.0);
-				break;
-			case nrpn:
-				//FIXME set to nrpn output
-				break;
+	for(u = 0; u < num; u += block){
+		//gather each block of the batch by output resolution and convert each in one pass
+		block = min(num - u, MMBACKEND_QUANTIZE_BLOCK);
+		for(p = 0, narrow = 0, wide = 0; p < block; p++){
+			ident.label = c[u + p]->ident;
+			if(ident.fields.type == pitchbend){
+				wide_in[wide++] = v[u + p];
+			}
+			else{
+				narrow_in[narrow++] = v[u + p];
+			}
 		}
+		mmbackend_quantize_u8(narrow, narrow_in, 127, value, NULL);
+		mmbackend_quantize_u16(wide, wide_in, 16383, bend, NULL);
+
+		for(p = 0, narrow = 0, wide = 0; p < block; p++){
+			ident.label = c[u + p]->ident;
+			converted = (ident.fields.type == pitchbend) ? bend[wide++] : value[narrow++];
+
+			snd_seq_ev_clear(&ev);
+			snd_seq_ev_set_source(&ev, data->port);
+			snd_seq_ev_set_subs(&ev);
+			snd_seq_ev_set_direct(&ev);
+
+			switch(ident.fields.type){
+				case note:
+					snd_seq_ev_set_noteon(&ev, ident.fields.channel, ident.fields.control, converted);
+					break;
+				case cc:
+					snd_seq_ev_set_controller(&ev, ident.fields.channel, ident.fields.control, converted);
+					break;
+				case pressure:
+					snd_seq_ev_set_keypress(&ev, ident.fields.channel, ident.fields.control, converted);
+					break;
+				case pitchbend:
+					snd_seq_ev_set_pitchbend(&ev, ident.fields.channel, converted - 8192);
+					break;
+				case aftertouch:
+					snd_seq_ev_set_chanpress(&ev, ident.fields.channel, converted);
+					break;
+				case nrpn:
+					//FIXME set to nrpn output
+					break;
+			}
 
-		snd_seq_event_output(sequencer, &ev);
+			snd_seq_event_output(sequencer, &ev);
+		}
 	}
 
 	snd_seq_drain_output(sequencer);
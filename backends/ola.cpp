@@ -10,6 +10,7 @@
 #define BACKEND_NAME "ola"
 static ola::io::SelectServer* ola_select = NULL;
 static ola::OlaCallbackClient* ola_client = NULL;
+static uint64_t last_connect = 0;
 
 int init(){
 	backend ola = {
@@ -136,7 +137,8 @@ static int ola_set(instance* inst, size_t num, channel** c, channel_value* v){
 		}
 	}
 
-	if(mark){
+	//output is held until the daemon connection is established
+	if(mark && ola_client){
 		ola_client->SendDmx(data->universe_id, ola::DmxBuffer(data->data.data, 512));
 	}
 
@@ -144,7 +146,13 @@ static int ola_set(instance* inst, size_t num, channel** c, channel_value* v){
 }
 
 static int ola_handle(size_t num, managed_fd* fds){
-	if(!num){
+	if(!ola_client && mm_timestamp() - last_connect >= OLA_RECONNECT_INTERVAL){
+		if(ola_connect()){
+			fprintf(stderr, "Failed to connect to OLA server, retrying in %d seconds\n", OLA_RECONNECT_INTERVAL / 1000);
+		}
+	}
+
+	if(!num || !ola_select){
 		return 0;
 	}
 
@@ -220,19 +228,22 @@ static void ola_register_callback(const std::string &error) {
 	}
 }
 
-static int ola_start(){
-	size_t n, u, p;
+//connect to the OLA daemon and register all instance universes
+static int ola_connect(){
+	size_t n, u;
 	instance** inst = NULL;
 	ola_instance_data* data = NULL;
-
-	ola_select = new ola::io::SelectServer();
+	ola::network::TCPSocket* ola_socket = NULL;
 	ola::network::IPV4SocketAddress ola_server(ola::network::IPV4Address::Loopback(), ola::OLA_DEFAULT_PORT);
-	ola::network::TCPSocket* ola_socket = ola::network::TCPSocket::Connect(ola_server);
+
+	last_connect = mm_timestamp();
+	//the daemon runs on the local host, so this fails immediately instead of blocking when it is not running
+	ola_socket = ola::network::TCPSocket::Connect(ola_server);
 	if(!ola_socket){
-		fprintf(stderr, "Failed to connect to OLA server\n");
 		return 1;
 	}
 
+	ola_select = new ola::io::SelectServer();
 	ola_client = new ola::OlaCallbackClient(ola_socket);
 
 	if(!ola_client->Setup()){
@@ -249,16 +260,37 @@ static int ola_start(){
 
 	ola_client->SetDmxCallback(ola::NewCallback(&ola_data_receive));
 
-	//fetch all defined instances
 	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
 		fprintf(stderr, "Failed to fetch instance list\n");
 		goto bail;
 	}
 
-	//this should not happen anymore (backends without instances are not started anymore)
-	if(!n){
-		free(inst);
-		return 0;
+	for(u = 0; u < n; u++){
+		data = (ola_instance_data*) inst[u]->impl;
+		ola_client->RegisterUniverse(data->universe_id, ola::REGISTER, ola::NewSingleCallback(&ola_register_callback));
+	}
+	free(inst);
+
+	//run the ola select implementation to run all commands
+	ola_select->RunOnce();
+	return 0;
+bail:
+	delete ola_client;
+	ola_client = NULL;
+	delete ola_select;
+	ola_select = NULL;
+	return 1;
+}
+
+static int ola_start(){
+	size_t n, u, p;
+	instance** inst = NULL;
+	ola_instance_data* data = NULL;
+
+	//fetch all defined instances
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
 	}
 
 	for(u = 0; u < n; u++){
@@ -269,23 +301,18 @@ static int ola_start(){
 		for(p = 0; p < u; p++){
 			if(inst[u]->ident == inst[p]->ident){
 				fprintf(stderr, "OLA universe used in multiple instances, use one instance: %s - %s\n", inst[u]->name, inst[p]->name);
-				goto bail;
+				free(inst);
+				return 1;
 			}
 		}
-		ola_client->RegisterUniverse(data->universe_id, ola::REGISTER, ola::NewSingleCallback(&ola_register_callback));
 	}
-
-	//run the ola select implementation to run all commands
-	ola_select->RunOnce();
 	free(inst);
+
+	//a missing daemon does not stop the other backends, the connection is retried while running
+	if(ola_connect()){
+		fprintf(stderr, "Failed to connect to OLA server, retrying in %d seconds\n", OLA_RECONNECT_INTERVAL / 1000);
+	}
 	return 0;
-bail:
-	free(inst);
-	delete ola_client;
-	ola_client = NULL;
-	delete ola_select;
-	ola_select = NULL;
-	return 1;
 }
 
 static int ola_shutdown(){
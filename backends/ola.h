@@ -15,6 +15,9 @@ extern "C" {
 	static int ola_shutdown();
 }
 
+//interval between connection attempts while the OLA daemon is unreachable, in msec
+#define OLA_RECONNECT_INTERVAL 5000
+
 #define MAP_COARSE 0x0200
 #define MAP_FINE 0x0400
 #define MAP_SINGLE 0x0800
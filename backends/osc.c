@@ -54,6 +54,10 @@ static size_t osc_data_length(osc_parameter_type t){
 		case int64:
 		case double64:
 			return 8;
+		case blob:
+		case blob_byte:
+			//blobs are handled bytewise by the callers
+			return 1;
 		default:
 			fprintf(stderr, "Invalid OSC format specified %c\n", t);
 			return 0;
@@ -66,6 +70,8 @@ static inline void osc_defaults(osc_parameter_type t, osc_parameter_value* max,
 	memset(min, 0, sizeof(osc_parameter_value));
 	switch(t){
 		case int32:
+		case blob:
+		case blob_byte:
 			max->i32 = 255;
 			return;
 		case float32:
@@ -128,6 +134,8 @@ static inline osc_parameter_value osc_parse_value_spec(osc_parameter_type t, cha
 	osc_parameter_value v = {0};
 	switch(t){
 		case int32:
+		case blob:
+		case blob_byte:
 			v.i32 = strtol(value, NULL, 0);
 			break;
 		case float32:
@@ -161,9 +169,11 @@ static inline channel_value osc_parameter_normalise(osc_parameter_type t, osc_pa
 
 	switch(t){
 		case int32:
+		case blob:
+		case blob_byte:
 			range.u32 = max.i32 - min.i32;
 			v.raw.u64 = cur.i32 - min.i32;
-			v.normalised = v.raw.u64 / range.u32;
+			v.normalised = (double) v.raw.u64 / range.u32;
 			break;
 		case float32:
 			range.f32 = max.f - min.f;
@@ -173,7 +183,7 @@ static inline channel_value osc_parameter_normalise(osc_parameter_type t, osc_pa
 		case int64:
 			range.u64 = max.i64 - min.i64;
 			v.raw.u64 = cur.i64 - min.i64;
-			v.normalised = v.raw.u64 / range.u64;
+			v.normalised = (double) v.raw.u64 / range.u64;
 			break;
 		case double64:
 			range.d64 = max.d - min.d;
@@ -202,6 +212,8 @@ static inline osc_parameter_value osc_parameter_denormalise(osc_parameter_type t
 
 	switch(t){
 		case int32:
+		case blob:
+		case blob_byte:
 			range.u32 = max.i32 - min.i32;
 			v.i32 = (range.u32 * cur.normalised) + min.i32;
 			break;
@@ -426,7 +438,10 @@ static int osc_configure(char* option, char* value){
 }
 
 static int osc_register_pattern(osc_instance_data* data, char* pattern_path, char* configuration){
-	size_t u, pattern;
+	size_t u, params = 0, pattern;
+	unsigned long count;
+	osc_parameter_type type;
+	osc_parameter_value min, max;
 	char* format = NULL, *token = NULL;
 
 	if(osc_path_validate(pattern_path, 1)){
@@ -441,19 +456,30 @@ static int osc_register_pattern(osc_instance_data* data, char* pattern_path, cha
 		return 1;
 	}
 
+	//count parameters, each type may be followed by a repetition count (or the length of a blob)
+	for(token = format; *token;){
+		type = *(token++);
+		count = isdigit(*token) ? strtoul(token, &token, 10) : 1;
+		if(!osc_data_length(type) || type == blob_byte || !count || count > OSC_XMIT_BUF - params){
+			fprintf(stderr, "Invalid format specification %s for pattern %s\n", format, pattern_path);
+			return 1;
+		}
+		params += count;
+	}
+
 	//create pattern
-	data->pattern = realloc(data->pattern, (data->patterns + 1) * sizeof(osc_channel));
+	data->pattern = mm_realloc(data->pattern, (data->patterns + 1) * sizeof(osc_channel));
 	if(!data->pattern){
 		fprintf(stderr, "Failed to allocate memory\n");
 		return 1;
 	}
 	pattern = data->patterns;
 
-	data->pattern[pattern].params = strlen(format);
-	data->pattern[pattern].path = strdup(pattern_path);
-	data->pattern[pattern].type = calloc(strlen(format), sizeof(osc_parameter_type));
-	data->pattern[pattern].max = calloc(strlen(format), sizeof(osc_parameter_value));
-	data->pattern[pattern].min = calloc(strlen(format), sizeof(osc_parameter_value));
+	data->pattern[pattern].params = params;
+	data->pattern[pattern].path = mm_strdup(pattern_path);
+	data->pattern[pattern].type = mm_calloc(params, sizeof(osc_parameter_type));
+	data->pattern[pattern].max = mm_calloc(params, sizeof(osc_parameter_value));
+	data->pattern[pattern].min = mm_calloc(params, sizeof(osc_parameter_value));
 
 	if(!data->pattern[pattern].path
 			|| !data->pattern[pattern].type
@@ -464,39 +490,153 @@ static int osc_register_pattern(osc_instance_data* data, char* pattern_path, cha
 		fprintf(stderr, "Failed to allocate memory\n");
 		return 1;
 	}
+	data->patterns++;
 
-	//check format validity and store min/max values
-	for(u = 0; u < strlen(format); u++){
-		if(!osc_data_length(format[u])){
-			fprintf(stderr, "Invalid format specifier %c for pattern %s\n", format[u], pattern_path);
-			return 1;
+	//store types and min/max values, shared by all repetitions of a type
+	for(params = 0; *format;){
+		type = *(format++);
+		count = isdigit(*format) ? strtoul(format, &format, 10) : 1;
+
+		if(type == blob){
+			//blob bytes are always transferred in their native range
+			osc_defaults(type, &max, &min);
 		}
+		else{
+			token = strtok(NULL, " ");
+			if(!token){
+				fprintf(stderr, "Missing minimum specification for parameter %" PRIsize_t " of OSC pattern %s\n", params, pattern_path);
+				return 1;
+			}
+			min = osc_parse_value_spec(type, token);
 
-		data->pattern[pattern].type[u] = format[u];
+			token = strtok(NULL, " ");
+			if(!token){
+				fprintf(stderr, "Missing maximum specification for parameter %" PRIsize_t " of OSC pattern %s\n", params, pattern_path);
+				return 1;
+			}
+			max = osc_parse_value_spec(type, token);
+		}
 
-		//parse min/max values
-		token = strtok(NULL, " ");
-		if(!token){
-			fprintf(stderr, "Missing minimum specification for parameter %" PRIsize_t " of OSC pattern %s\n", u, pattern_path);
-			return 1;
+		for(u = 0; u < count; u++, params++){
+			data->pattern[pattern].type[params] = (type == blob && u) ? blob_byte : type;
+			data->pattern[pattern].min[params] = min;
+			data->pattern[pattern].max[params] = max;
 		}
-		data->pattern[pattern].min[u] = osc_parse_value_spec(format[u], token);
+	}
+	return 0;
+}
 
-		token = strtok(NULL, " ");
-		if(!token){
-			fprintf(stderr, "Missing maximum specification for parameter %" PRIsize_t " of OSC pattern %s\n", u, pattern_path);
-			return 1;
+//append a peer, the last seen timestamp is 0 for configured destinations
+static int osc_peer_add(osc_instance_data* data, struct sockaddr_storage* addr, socklen_t len, uint64_t seen){
+	if(data->peers >= OSC_MAX_PEERS){
+		return 1;
+	}
+
+	data->peer = mm_realloc(data->peer, (data->peers + 1) * sizeof(struct sockaddr_storage));
+	data->peer_len = mm_realloc(data->peer_len, (data->peers + 1) * sizeof(socklen_t));
+	data->peer_seen = mm_realloc(data->peer_seen, (data->peers + 1) * sizeof(uint64_t));
+	if(!data->peer || !data->peer_len || !data->peer_seen){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	memcpy(data->peer + data->peers, addr, len);
+	data->peer_len[data->peers] = len;
+	data->peer_seen[data->peers] = seen;
+	data->peers++;
+	return 0;
+}
+
+static void osc_peer_learn(osc_instance_data* data, struct sockaddr_storage* addr, socklen_t len){
+	size_t u;
+	uint64_t timestamp = mm_timestamp();
+
+	//cheating a bit because both IPv4 and IPv6 have the port at the same offset
+	if(data->forced_rport){
+		((struct sockaddr_in*) addr)->sin_port = htobe16(data->forced_rport);
+	}
+
+	for(u = data->peers - data->learned; u < data->peers; u++){
+		if(data->peer_len[u] == len && !memcmp(data->peer + u, addr, len)){
+			data->peer_seen[u] = timestamp;
+			return;
 		}
-		data->pattern[pattern].max[u] = osc_parse_value_spec(format[u], token);
 	}
 
-	data->patterns++;
+	//without expiry, only the most recent sender is answered
+	if(!data->expire && data->learned){
+		memcpy(data->peer + data->peers - 1, addr, len);
+		data->peer_len[data->peers - 1] = len;
+		data->peer_seen[data->peers - 1] = timestamp;
+		return;
+	}
+
+	if(!osc_peer_add(data, addr, len, timestamp)){
+		data->learned++;
+	}
+}
+
+//drop learned peers that did not send anything within the expiry interval
+static void osc_peer_expire(osc_instance_data* data){
+	size_t u;
+	uint64_t timestamp = mm_timestamp();
+
+	for(u = data->peers - data->learned; u < data->peers;){
+		if(timestamp - data->peer_seen[u] > data->expire){
+			data->peers--;
+			data->learned--;
+			memmove(data->peer + u, data->peer + u + 1, (data->peers - u) * sizeof(struct sockaddr_storage));
+			memmove(data->peer_len + u, data->peer_len + u + 1, (data->peers - u) * sizeof(socklen_t));
+			memmove(data->peer_seen + u, data->peer_seen + u + 1, (data->peers - u) * sizeof(uint64_t));
+			continue;
+		}
+		u++;
+	}
+}
+
+static int osc_join_group(instance* inst, char* group){
+	osc_instance_data* data = (osc_instance_data*) inst->impl;
+	struct sockaddr_storage addr;
+	socklen_t len;
+	int rv;
+	struct ip_mreq mreq4 = {
+		.imr_interface = { INADDR_ANY }
+	};
+	struct ipv6_mreq mreq6 = {
+		.ipv6mr_interface = 0
+	};
+
+	if(data->fd < 0){
+		fprintf(stderr, "OSC instance %s needs to be bound before joining multicast group %s\n", inst->name, group);
+		return 1;
+	}
+
+	if(mmbackend_parse_sockaddr(group, "0", &addr, &len)){
+		fprintf(stderr, "Invalid multicast group %s for OSC instance %s\n", group, inst->name);
+		return 1;
+	}
+
+	if(addr.ss_family == AF_INET){
+		mreq4.imr_multiaddr = ((struct sockaddr_in*) &addr)->sin_addr;
+		rv = setsockopt(data->fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, (uint8_t*) &mreq4, sizeof(mreq4));
+	}
+	else{
+		mreq6.ipv6mr_multiaddr = ((struct sockaddr_in6*) &addr)->sin6_addr;
+		rv = setsockopt(data->fd, IPPROTO_IPV6, IPV6_JOIN_GROUP, (uint8_t*) &mreq6, sizeof(mreq6));
+	}
+
+	if(rv){
+		fprintf(stderr, "Failed to join multicast group %s for OSC instance %s: %s\n", group, inst->name, strerror(errno));
+		return 1;
+	}
 	return 0;
 }
 
 static int osc_configure_instance(instance* inst, char* option, char* value){
 	osc_instance_data* data = (osc_instance_data*) inst->impl;
 	char* host = NULL, *port = NULL;
+	struct sockaddr_storage addr;
+	socklen_t len;
 
 	if(!strcmp(option, "root")){
 		if(osc_path_validate(value, 0)){
@@ -505,9 +645,9 @@ static int osc_configure_instance(instance* inst, char* option, char* value){
 		}
 
 		if(data->root){
-			free(data->root);
+			mm_free(data->root);
 		}
-		data->root = strdup(value);
+		data->root = mm_strdup(value);
 
 		if(!data->root){
 			fprintf(stderr, "Failed to allocate memory\n");
@@ -529,6 +669,13 @@ static int osc_configure_instance(instance* inst, char* option, char* value){
 		}
 		return 0;
 	}
+	else if(!strcmp(option, "multicast")){
+		return osc_join_group(inst, value);
+	}
+	else if(!strcmp(option, "expire")){
+		data->expire = strtoul(value, NULL, 10) * 1000;
+		return 0;
+	}
 	else if(!strcmp(option, "dest") || !strcmp(option, "destination")){
 		if(!strncmp(value, "learn", 5)){
 			data->learn = 1;
@@ -546,10 +693,15 @@ static int osc_configure_instance(instance* inst, char* option, char* value){
 			return 1;
 		}
 
-		if(mmbackend_parse_sockaddr(host, port, &data->dest, &data->dest_len)){
+		if(mmbackend_parse_sockaddr(host, port, &addr, &len)){
 			fprintf(stderr, "Failed to parse destination address for instance %s\n", inst->name);
 			return 1;
 		}
+
+		if(osc_peer_add(data, &addr, len, 0)){
+			fprintf(stderr, "Failed to add destination for instance %s, at most %d peers are supported\n", inst->name, OSC_MAX_PEERS);
+			return 1;
+		}
 		return 0;
 	}
 	else if(*option == '/'){
@@ -566,7 +718,7 @@ static instance* osc_instance(){
 		return NULL;
 	}
 
-	osc_instance_data* data = calloc(1, sizeof(osc_instance_data));
+	osc_instance_data* data = mm_calloc(1, sizeof(osc_instance_data));
 	if(!data){
 		fprintf(stderr, "Failed to allocate memory\n");
 		return NULL;
@@ -579,22 +731,23 @@ static instance* osc_instance(){
 
 static channel* osc_map_channel(instance* inst, char* spec){
 	size_t u, p;
+	channel* chan = NULL;
 	osc_instance_data* data = (osc_instance_data*) inst->impl;
 	osc_channel_ident ident = {
 		.label = 0
 	};
 
+	//parse parameter offset, `*` selects all parameters as one vector channel
+	if(strrchr(spec, ':')){
+		ident.fields.parameter = (strrchr(spec, ':')[1] == '*') ? OSC_VECTOR : strtoul(strrchr(spec, ':') + 1, NULL, 10);
+		*(strrchr(spec, ':')) = 0;
+	}
+
 	//check spec for correctness
 	if(osc_path_validate(spec, 0)){
 		return NULL;
 	}
 
-	//parse parameter offset
-	if(strrchr(spec, ':')){
-		ident.fields.parameter = strtoul(strrchr(spec, ':') + 1, NULL, 10);
-		*(strrchr(spec, ':')) = 0;
-	}
-
 	//find matching channel
 	for(u = 0; u < data->channels; u++){
 		if(!strcmp(spec, data->channel[u].path)){
@@ -610,14 +763,14 @@ static channel* osc_map_channel(instance* inst, char* spec){
 			}
 		}
 
-		data->channel = realloc(data->channel, (u + 1) * sizeof(osc_channel));
+		data->channel = mm_realloc(data->channel, (u + 1) * sizeof(osc_channel));
 		if(!data->channel){
 			fprintf(stderr, "Failed to allocate memory\n");
 			return NULL;
 		}
 
 		memset(data->channel + u, 0, sizeof(osc_channel));
-		data->channel[u].path = strdup(spec);
+		data->channel[u].path = mm_strdup(spec);
 		if(p != data->patterns){
 			fprintf(stderr, "Matched pattern %s for %s\n", data->pattern[p].path, spec);
 			data->channel[u].params = data->pattern[p].params;
@@ -627,8 +780,8 @@ static channel* osc_map_channel(instance* inst, char* spec){
 			data->channel[u].min = data->pattern[p].min;
 
 			//these are per channel
-			data->channel[u].in = calloc(data->channel[u].params, sizeof(osc_parameter_value));
-			data->channel[u].out = calloc(data->channel[u].params, sizeof(osc_parameter_value));
+			data->channel[u].in = mm_calloc(data->channel[u].params, sizeof(osc_parameter_value));
+			data->channel[u].out = mm_calloc(data->channel[u].params, sizeof(osc_parameter_value));
 		}
 		else if(data->patterns){
 			fprintf(stderr, "No pattern match found for %s\n", spec);
@@ -643,23 +796,43 @@ static channel* osc_map_channel(instance* inst, char* spec){
 	}
 
 	ident.fields.channel = u;
-	return mm_channel(inst, ident.label, 1);
+	if(ident.fields.parameter != OSC_VECTOR){
+		chan = mm_channel(inst, ident.label, 1);
+		//blob bytes are passed as 8-bit values
+		if(chan && ident.fields.parameter < data->channel[u].params
+				&& (data->channel[u].type[ident.fields.parameter] == blob || data->channel[u].type[ident.fields.parameter] == blob_byte)
+				&& mm_channel_resolution(chan, 8)){
+			return NULL;
+		}
+		return chan;
+	}
+
+	if(data->channel[u].params < 2 || data->channel[u].params > MM_VECTOR_COMPONENTS){
+		fprintf(stderr, "OSC vector channel %s.%s requires a format pattern with 2 to %d parameters\n", inst->name, spec, MM_VECTOR_COMPONENTS);
+		return NULL;
+	}
+
+	chan = mm_channel(inst, ident.label, 1);
+	if(!chan || mm_channel_components(chan, data->channel[u].params)){
+		return NULL;
+	}
+	data->channel[u].vector = 1;
+	return chan;
 }
 
 static int osc_output_channel(instance* inst, size_t channel){
 	osc_instance_data* data = (osc_instance_data*) inst->impl;
 	uint8_t xmit_buf[OSC_XMIT_BUF] = "", *format = NULL;
-	size_t offset = 0, p;
+	size_t offset = 0, p, b, types = 0;
+	uint32_t length;
 
-	//fix destination rport if required
-	if(data->forced_rport){
-		//cheating a bit because both IPv4 and IPv6 have the port at the same offset
-		struct sockaddr_in* sockadd = (struct sockaddr_in*) &(data->dest);
-		sockadd->sin_port = htobe16(data->forced_rport);
+	//blobs only have one type tag
+	for(p = 0; p < data->channel[channel].params; p++){
+		types += (data->channel[channel].type[p] == blob_byte) ? 0 : 1;
 	}
 
 	//determine minimum packet size
-	if(osc_align((data->root ? strlen(data->root) : 0) + strlen(data->channel[channel].path) + 1) + osc_align(data->channel[channel].params + 2)  >= sizeof(xmit_buf)){
+	if(osc_align((data->root ? strlen(data->root) : 0) + strlen(data->channel[channel].path) + 1) + osc_align(types + 2)  >= sizeof(xmit_buf)){
 		fprintf(stderr, "Insufficient buffer size for OSC transmitting channel %s.%s\n", inst->name, data->channel[channel].path);
 		return 1;
 	}
@@ -676,13 +849,34 @@ static int osc_output_channel(instance* inst, size_t channel){
 
 	//get format string offset, initialize
 	format = xmit_buf + offset;
-	offset += osc_align(data->channel[channel].params + 2);
+	offset += osc_align(types + 2);
 	*format = ',';
 	format++;
 
 	for(p = 0; p < data->channel[channel].params; p++){
 		//write format specifier
-		format[p] = data->channel[channel].type[p];
+		*(format++) = data->channel[channel].type[p];
+
+		if(data->channel[channel].type[p] == blob){
+			//pack the blob bytes following the size
+			for(b = p + 1; b < data->channel[channel].params && data->channel[channel].type[b] == blob_byte; b++){
+			}
+			length = b - p;
+			if(offset + sizeof(length) + osc_align(length) >= sizeof(xmit_buf)){
+				fprintf(stderr, "Insufficient buffer size for OSC transmitting channel %s.%s at parameter %" PRIsize_t "\n", inst->name, data->channel[channel].path, p);
+				return 1;
+			}
+
+			length = htobe32(length);
+			memcpy(xmit_buf + offset, &length, sizeof(length));
+			offset += sizeof(length);
+			for(; p < b; p++){
+				xmit_buf[offset++] = data->channel[channel].out[p].i32;
+			}
+			offset = osc_align(offset);
+			p--;
+			continue;
+		}
 
 		//write data
 		if(offset + osc_data_length(data->channel[channel].type[p]) >= sizeof(xmit_buf)){
@@ -696,27 +890,45 @@ static int osc_output_channel(instance* inst, size_t channel){
 		offset += osc_data_length(data->channel[channel].type[p]);
 	}
 
-	//output packet
-	if(sendto(data->fd, xmit_buf, offset, 0, (struct sockaddr*) &(data->dest), data->dest_len) < 0){
-		fprintf(stderr, "Failed to transmit OSC packet: %s\n", strerror(errno));
+	//output the encoded packet to all peers
+	if(mmbackend_send_datagram_multi(data->fd, xmit_buf, offset, data->peers, data->peer, data->peer_len)){
+		fprintf(stderr, "Failed to transmit OSC packet for instance %s\n", inst->name);
+	}
+	return 0;
+}
+
+//update the output value of a channel parameter, returns 1 if the value changed
+static int osc_update_parameter(osc_channel* chan, size_t parameter, osc_parameter_value current){
+	if(memcmp(&current, chan->out + parameter, sizeof(current))){
+		chan->out[parameter] = current;
+		chan->mark = 1;
+		return 1;
 	}
 	return 0;
 }
 
 static int osc_set(instance* inst, size_t num, channel** c, channel_value* v){
-	size_t evt = 0, mark = 0;
+	size_t evt = 0, mark = 0, p;
 	int rv = 0;
+	osc_channel* chan = NULL;
+	osc_parameter_value current;
 	osc_channel_ident ident = {
 		.label = 0
 	};
-	osc_parameter_value current;
+	channel_value component = {
+		.raw = {0}
+	};
 
 	if(!num){
 		return 0;
 	}
 
 	osc_instance_data* data = (osc_instance_data*) inst->impl;
-	if(!data->dest_len){
+	if(data->expire){
+		osc_peer_expire(data);
+	}
+
+	if(!data->peers){
 		fprintf(stderr, "OSC instance %s does not have a destination, output is disabled (%" PRIsize_t " channels)\n", inst->name, num);
 		return 0;
 	}
@@ -726,7 +938,7 @@ static int osc_set(instance* inst, size_t num, channel** c, channel_value* v){
 
 		//sanity check
 		if(ident.fields.channel >= data->channels
-				|| ident.fields.parameter >= data->channel[ident.fields.channel].params){
+				|| (ident.fields.parameter != OSC_VECTOR && ident.fields.parameter >= data->channel[ident.fields.channel].params)){
 			fprintf(stderr, "OSC channel identifier out of range\n");
 			return 1;
 		}
@@ -737,18 +949,27 @@ static int osc_set(instance* inst, size_t num, channel** c, channel_value* v){
 			continue;
 		}
 
-		//only output on change
-		current = osc_parameter_denormalise(data->channel[ident.fields.channel].type[ident.fields.parameter],
-				data->channel[ident.fields.channel].min[ident.fields.parameter],
-				data->channel[ident.fields.channel].max[ident.fields.parameter],
-				v[evt]);
-		if(memcmp(&current, &data->channel[ident.fields.channel].out[ident.fields.parameter], sizeof(current))){
-			//update current value
-			data->channel[ident.fields.channel].out[ident.fields.parameter] = current;
-			//mark channel
-			data->channel[ident.fields.channel].mark = 1;
-			mark = 1;
+		//vector channels update all parameters of the message at once
+		chan = data->channel + ident.fields.channel;
+		if(ident.fields.parameter == OSC_VECTOR){
+			for(p = 0; p < chan->params; p++){
+				component.normalised = v[evt].raw.component[p] / 65535.0;
+				mark |= osc_update_parameter(chan, p, osc_parameter_denormalise(chan->type[p], chan->min[p], chan->max[p], component));
+			}
+			continue;
+		}
+
+		//blob bytes are delivered as 8-bit values
+		if(chan->type[ident.fields.parameter] == blob || chan->type[ident.fields.parameter] == blob_byte){
+			memset(&current, 0, sizeof(current));
+			current.i32 = v[evt].raw.u64;
+		}
+		else{
+			current = osc_parameter_denormalise(chan->type[ident.fields.parameter], chan->min[ident.fields.parameter], chan->max[ident.fields.parameter], v[evt]);
 		}
+
+		//only output on change
+		mark |= osc_update_parameter(chan, ident.fields.parameter, current);
 	}
 	
 	if(mark){
@@ -764,11 +985,86 @@ static int osc_set(instance* inst, size_t num, channel** c, channel_value* v){
 	return rv;
 }
 
-static int osc_process_packet(instance* inst, char* local_path, char* format, uint8_t* payload, size_t payload_len){
+//count the parameters of a message, with arrays flattened and blobs expanded to their bytes
+static ssize_t osc_parameter_count(char* format, uint8_t* payload, size_t payload_len){
+	size_t offset = 0, count = 0, length;
+
+	for(; *format; format++){
+		switch(*format){
+			case '[':
+			case ']':
+				continue;
+			case blob:
+				if(offset + 4 > payload_len){
+					return -1;
+				}
+				length = be32toh(*((uint32_t*) (payload + offset)));
+				offset += 4 + osc_align(length);
+				count += length;
+				break;
+			default:
+				length = osc_data_length(*format);
+				if(!length){
+					return -1;
+				}
+				offset += length;
+				count++;
+		}
+
+		if(offset > payload_len){
+			return -1;
+		}
+	}
+	return count;
+}
+
+//normalise a received parameter and generate an event when it changed
+//returns 1 if the parameter changed (or the channel keeps no previous values), 0 otherwise
+static uint8_t osc_process_parameter(instance* inst, size_t index, size_t parameter, osc_parameter_type type, osc_parameter_value cur, channel_value* vector){
 	osc_instance_data* data = (osc_instance_data*) inst->impl;
-	size_t c, p, offset = 0;
-	osc_parameter_value min, max, cur;
+	osc_parameter_value min, max;
 	channel_value evt;
+	channel* chan = NULL;
+	osc_channel_ident ident = {
+		.label = 0
+	};
+
+	if(data->channel[index].params){
+		max = data->channel[index].max[parameter];
+		min = data->channel[index].min[parameter];
+	}
+	else{
+		osc_defaults(type, &max, &min);
+	}
+
+	evt = osc_parameter_normalise(type, min, max, cur);
+	if(parameter < MM_VECTOR_COMPONENTS){
+		vector->raw.component[parameter] = evt.normalised * 65535.0 + 0.5;
+	}
+
+	if(!data->channel[index].params || memcmp(&cur, data->channel[index].in + parameter, sizeof(cur))){
+		if(data->channel[index].params){
+			data->channel[index].in[parameter] = cur;
+		}
+
+		ident.fields.channel = index;
+		ident.fields.parameter = parameter;
+		chan = mm_channel(inst, ident.label, 0);
+		if(chan){
+			mm_channel_event(chan, evt);
+		}
+		return 1;
+	}
+	return 0;
+}
+
+static int osc_process_packet(instance* inst, char* local_path, char* format, uint8_t* payload, size_t payload_len){
+	osc_instance_data* data = (osc_instance_data*) inst->impl;
+	size_t c, f, p, b, offset, length;
+	ssize_t params;
+	osc_parameter_value cur;
+	channel_value vector;
+	uint8_t changed;
 	osc_channel_ident ident = {
 		.label = 0
 	};
@@ -781,34 +1077,51 @@ static int osc_process_packet(instance* inst, char* local_path, char* format, ui
 
 	for(c = 0; c < data->channels; c++){
 		if(!strcmp(local_path, data->channel[c].path)){
-			ident.fields.channel = c;
+			params = osc_parameter_count(format, payload, payload_len);
+			if(params < 0){
+				fprintf(stderr, "OSC message %s.%s with format %s is invalid or not supported\n", inst->name, local_path, format);
+				return 0;
+			}
+
 			//unconfigured input should work without errors (using default limits)
-			if(data->channel[c].params && strlen(format) != data->channel[c].params){
-				fprintf(stderr, "OSC message %s.%s had format %s, internal representation has %" PRIsize_t " parameters\n", inst->name, local_path, format, data->channel[c].params);
+			if(data->channel[c].params && params != data->channel[c].params){
+				fprintf(stderr, "OSC message %s.%s had format %s (%" PRIsize_t " parameters), internal representation has %" PRIsize_t " parameters\n", inst->name, local_path, format, (size_t) params, data->channel[c].params);
 				continue;
 			}
 
-			for(p = 0; p < strlen(format); p++){
-				ident.fields.parameter = p;
-				if(data->channel[c].params){
-					max = data->channel[c].max[p];
-					min = data->channel[c].min[p];
-				}
-				else{
-					osc_defaults(format[p], &max, &min);
+			//decode all parameters in one pass over the payload
+			memset(&vector, 0, sizeof(vector));
+			changed = 0;
+			for(f = 0, p = 0, offset = 0; format[f]; f++){
+				if(format[f] == '[' || format[f] == ']'){
+					//array elements are handled as consecutive parameters
+					continue;
 				}
-				cur = osc_parse(format[p], payload + offset);
-				if(!data->channel[c].params || memcmp(&cur, &data->channel[c].in, sizeof(cur))){
-					evt = osc_parameter_normalise(format[p], min, max, cur);
-					chan = mm_channel(inst, ident.label, 0);
-					if(chan){
-						mm_channel_event(chan, evt);
+				else if(format[f] == blob){
+					length = be32toh(*((uint32_t*) (payload + offset)));
+					offset += 4;
+					for(b = 0; b < length; b++, p++){
+						memset(&cur, 0, sizeof(cur));
+						cur.i32 = payload[offset + b];
+						changed |= osc_process_parameter(inst, c, p, b ? blob_byte : blob, cur, &vector) && p < MM_VECTOR_COMPONENTS;
 					}
+					offset += osc_align(length);
+				}
+				else{
+					cur = osc_parse(format[f], payload + offset);
+					changed |= osc_process_parameter(inst, c, p, format[f], cur, &vector) && p < MM_VECTOR_COMPONENTS;
+					offset += osc_data_length(format[f]);
+					p++;
 				}
+			}
 
-				//skip to next parameter data
-				offset += osc_data_length(format[p]);
-				//TODO check offset against payload length
+			//all parameters of the message as one vector event, only if any of its components changed
+			ident.fields.channel = c;
+			ident.fields.parameter = OSC_VECTOR;
+			chan = (data->channel[c].vector && changed) ? mm_channel(inst, ident.label, 0) : NULL;
+			if(chan){
+				vector.normalised = vector.raw.component[0] / 65535.0;
+				mm_channel_event(chan, vector);
 			}
 		}
 	}
@@ -822,6 +1135,8 @@ static int osc_handle(size_t num, managed_fd* fds){
 	instance* inst = NULL;
 	osc_instance_data* data = NULL;
 	ssize_t bytes_read = 0;
+	struct sockaddr_storage peer;
+	socklen_t peer_len;
 	char* osc_fmt = NULL;
 	char* osc_local = NULL;
 	uint8_t* osc_data = NULL;
@@ -837,8 +1152,8 @@ static int osc_handle(size_t num, managed_fd* fds){
 
 		do{
 			if(data->learn){
-				data->dest_len = sizeof(data->dest);
-				bytes_read = recvfrom(fds[fd].fd, recv_buf, sizeof(recv_buf), 0, (struct sockaddr*) &(data->dest), &(data->dest_len));
+				peer_len = sizeof(peer);
+				bytes_read = recvfrom(fds[fd].fd, recv_buf, sizeof(recv_buf), 0, (struct sockaddr*) &peer, &peer_len);
 			}
 			else{
 				bytes_read = recv(fds[fd].fd, recv_buf, sizeof(recv_buf), 0);
@@ -848,6 +1163,10 @@ static int osc_handle(size_t num, managed_fd* fds){
 				break;
 			}
 
+			if(data->learn){
+				osc_peer_learn(data, &peer, peer_len);
+			}
+
 			if(data->root && strncmp(recv_buf, data->root, min(bytes_read, strlen(data->root)))){
 				//ignore packet for different root
 				continue;
@@ -944,27 +1263,30 @@ static int osc_shutdown(){
 	for(u = 0; u < n; u++){
 		data = (osc_instance_data*) inst[u]->impl;
 		for(c = 0; c < data->channels; c++){
-			free(data->channel[c].path);
-			free(data->channel[c].in);
-			free(data->channel[c].out);
+			mm_free(data->channel[c].path);
+			mm_free(data->channel[c].in);
+			mm_free(data->channel[c].out);
 		}
-		free(data->channel);
+		mm_free(data->channel);
 		for(c = 0; c < data->patterns; c++){
-			free(data->pattern[c].path);
-			free(data->pattern[c].type);
-			free(data->pattern[c].min);
-			free(data->pattern[c].max);
+			mm_free(data->pattern[c].path);
+			mm_free(data->pattern[c].type);
+			mm_free(data->pattern[c].min);
+			mm_free(data->pattern[c].max);
 		}
-		free(data->pattern);
+		mm_free(data->pattern);
 
-		free(data->root);
+		mm_free(data->root);
+		mm_free(data->peer);
+		mm_free(data->peer_len);
+		mm_free(data->peer_seen);
 		if(data->fd >= 0){
 			close(data->fd);
 		}
 		data->fd = -1;
 		data->channels = 0;
 		data->patterns = 0;
-		free(inst[u]->impl);
+		mm_free(inst[u]->impl);
 	}
 
 	free(inst);
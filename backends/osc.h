@@ -6,6 +6,7 @@
 
 #define OSC_RECV_BUF 8192
 #define OSC_XMIT_BUF 8192
+#define OSC_MAX_PEERS 64
 
 int init();
 static int osc_configure(char* option, char* value);
@@ -21,9 +22,12 @@ typedef enum {
 	not_set = 0,
 	int32 = 'i',
 	float32 = 'f',
-	/*s, b*/ //ignored
+	/*s*/ //ignored
 	int64 = 'h',
 	double64 = 'd',
+	blob = 'b',
+	//internal type of the bytes following the first one in a blob
+	blob_byte = 1
 } osc_parameter_type;
 
 typedef union {
@@ -37,6 +41,7 @@ typedef struct /*_osc_channel*/ {
 	char* path;
 	size_t params;
 	uint8_t mark;
+	uint8_t vector;
 
 	osc_parameter_type* type;
 	osc_parameter_value* max;
@@ -58,15 +63,22 @@ typedef struct /*_osc_instance_data*/ {
 	char* root;
 	uint8_t learn;
 
-	//peer addressing
-	socklen_t dest_len;
-	struct sockaddr_storage dest;
+	//peer addressing, learned peers follow the configured destinations
+	size_t peers;
+	size_t learned;
+	struct sockaddr_storage* peer;
+	socklen_t* peer_len;
+	uint64_t* peer_seen;
 	uint16_t forced_rport;
+	uint64_t expire;
 
 	//peer fd
 	int fd;
 } osc_instance_data;
 
+/* Parameter index of vector channels carrying all parameters of a message */
+#define OSC_VECTOR 0xFFFFFFFF
+
 typedef union {
 	struct {
 		uint32_t channel;
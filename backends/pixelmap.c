@@ -0,0 +1,615 @@
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <math.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "pixelmap.h"
+
+#define BACKEND_NAME "pixelmap"
+
+int init(){
+	backend pixelmap = {
+		.name = BACKEND_NAME,
+		.conf = pixelmap_configure,
+		.create = pixelmap_instance,
+		.conf_instance = pixelmap_configure_instance,
+		.channel = pixelmap_channel,
+		.handle = pixelmap_set,
+		.process = pixelmap_handle,
+		.start = pixelmap_start,
+		.shutdown = pixelmap_shutdown,
+		.interval = pixelmap_interval
+	};
+
+	if(sizeof(pixelmap_channel_ident) != sizeof(uint64_t)){
+		fprintf(stderr, "pixelmap channel identification union out of bounds\n");
+		return 1;
+	}
+
+	//register backend
+	if(mm_backend_register(pixelmap)){
+		fprintf(stderr, "Failed to register pixelmap backend\n");
+		return 1;
+	}
+	return 0;
+}
+
+static uint64_t pixelmap_clock(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static int pixelmap_configure(char* option, char* value){
+	fprintf(stderr, "The pixelmap backend does not take any global configuration\n");
+	return 1;
+}
+
+static int pixelmap_configure_instance(instance* inst, char* option, char* value){
+	pixelmap_instance_data* data = (pixelmap_instance_data*) inst->impl;
+	char* path = NULL;
+
+	if(!strcmp(option, "source")){
+		path = strchr(value, ' ');
+		if(!path){
+			fprintf(stderr, "Invalid source specification %s for pixelmap instance %s, expected <type> <path>\n", value, inst->name);
+			return 1;
+		}
+		*path++ = 0;
+
+		if(!strcmp(value, "pipe")){
+			data->type = source_pipe;
+		}
+		else if(!strcmp(value, "file")){
+			data->type = source_file;
+		}
+		else if(!strcmp(value, "shm")){
+			data->type = source_shm;
+		}
+		else{
+			fprintf(stderr, "Unknown source type %s for pixelmap instance %s\n", value, inst->name);
+			return 1;
+		}
+
+		mm_free(data->source);
+		data->source = mm_strdup(path);
+		return data->source ? 0 : 1;
+	}
+	else if(!strcmp(option, "layout")){
+		mm_free(data->layout);
+		data->layout = mm_strdup(value);
+		return data->layout ? 0 : 1;
+	}
+	else if(!strcmp(option, "width")){
+		data->width = strtoul(value, NULL, 10);
+		return 0;
+	}
+	else if(!strcmp(option, "height")){
+		data->height = strtoul(value, NULL, 10);
+		return 0;
+	}
+	else if(!strcmp(option, "fps")){
+		data->fps = strtoul(value, NULL, 10);
+		if(!data->fps || data->fps > 1000){
+			fprintf(stderr, "Invalid frame rate %s for pixelmap instance %s, must be between 1 and 1000\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "gamma")){
+		data->gamma = strtod(value, NULL);
+		if(data->gamma <= 0.0){
+			fprintf(stderr, "Invalid gamma %s for pixelmap instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "brightness")){
+		data->brightness = strtod(value, NULL);
+		if(data->brightness < 0.0 || data->brightness > 1.0){
+			fprintf(stderr, "Invalid brightness %s for pixelmap instance %s, must be between 0 and 1\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "benchmark")){
+		data->benchmark = strtoul(value, NULL, 10);
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown instance option %s for pixelmap instance %s\n", option, inst->name);
+	return 1;
+}
+
+static instance* pixelmap_instance(){
+	pixelmap_instance_data* data = NULL;
+	instance* i = mm_instance();
+	if(!i){
+		return NULL;
+	}
+
+	data = mm_calloc(1, sizeof(pixelmap_instance_data));
+	if(!data){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	data->fd = -1;
+	data->fps = PIXELMAP_DEFAULT_FPS;
+	data->gamma = 1.0;
+	data->brightness = 1.0;
+	i->impl = data;
+	return i;
+}
+
+static pixelmap_universe* pixelmap_universe_get(pixelmap_instance_data* data, uint16_t universe){
+	size_t u;
+
+	for(u = 0; u < data->universes; u++){
+		if(data->universe[u].universe == universe){
+			return data->universe + u;
+		}
+	}
+
+	data->universe = mm_realloc(data->universe, (data->universes + 1) * sizeof(pixelmap_universe));
+	if(!data->universe){
+		data->universes = 0;
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	memset(data->universe + data->universes, 0, sizeof(pixelmap_universe));
+	data->universe[data->universes].universe = universe;
+	for(u = 0; u < PIXELMAP_UNIVERSE_SIZE; u++){
+		data->universe[data->universes].offset[u] = data->frame_size;
+	}
+	data->universes++;
+	return data->universe + data->universes - 1;
+}
+
+static channel* pixelmap_channel(instance* inst, char* spec){
+	pixelmap_instance_data* data = (pixelmap_instance_data*) inst->impl;
+	pixelmap_universe* universe = NULL;
+	pixelmap_channel_ident ident = {
+		.label = 0
+	};
+	char* next = spec;
+	unsigned long number = strtoul(spec, &next, 10), slot;
+
+	if(next == spec || *next != '.' || number > 0xFFFF){
+		fprintf(stderr, "Invalid pixelmap channel specification %s, expected <universe>.<slot>\n", spec);
+		return NULL;
+	}
+
+	slot = strtoul(next + 1, &next, 10);
+	if(*next || !slot || slot > PIXELMAP_UNIVERSE_SIZE){
+		fprintf(stderr, "Invalid pixelmap slot in channel specification %s\n", spec);
+		return NULL;
+	}
+
+	universe = pixelmap_universe_get(data, number);
+	if(!universe){
+		return NULL;
+	}
+
+	ident.fields.universe = number;
+	ident.fields.slot = slot - 1;
+	if(!universe->channel[slot - 1]){
+		universe->channel[slot - 1] = mm_channel(inst, ident.label, 1);
+		//slot values are output as 8-bit integers
+		if(!universe->channel[slot - 1] || mm_channel_resolution(universe->channel[slot - 1], 8)){
+			return NULL;
+		}
+	}
+	return universe->channel[slot - 1];
+}
+
+static int pixelmap_set(instance* inst, size_t num, channel** c, channel_value* v){
+	pixelmap_instance_data* data = (pixelmap_instance_data*) inst->impl;
+
+	//output mappings would otherwise report every processing cycle
+	if(!num || data->output_warned){
+		return 0;
+	}
+
+	fprintf(stderr, "pixelmap instance %s is input-only, ignoring all channel events mapped to it\n", inst->name);
+	data->output_warned = 1;
+	return 0;
+}
+
+static void pixelmap_process(pixelmap_instance_data* data){
+	size_t u, s;
+	uint8_t* frame = data->frame;
+	uint8_t* curve = data->curve;
+	uint64_t start = pixelmap_clock();
+	pixelmap_universe* universe = NULL;
+	channel_value event;
+	uint8_t value;
+
+	for(u = 0; u < data->universes; u++){
+		universe = data->universe + u;
+		//sample the frame through the lookup table and output changed slots
+		for(s = 0; s < universe->slots; s++){
+			value = curve[frame[universe->offset[s]]];
+			if(value != universe->value[s]){
+				universe->value[s] = value;
+				if(universe->channel[s]){
+					event.normalised = value / 255.0;
+					event.raw.u64 = value;
+					mm_channel_event(universe->channel[s], event);
+				}
+			}
+		}
+	}
+
+	data->frames++;
+	data->process_time += pixelmap_clock() - start;
+	data->pending = 0;
+}
+
+static int pixelmap_open(instance* inst, pixelmap_instance_data* data){
+	struct stat info;
+
+	switch(data->type){
+		case source_pipe:
+			//opening the read end of a fifo without blocking succeeds even without a writer
+			data->fd = open(data->source, O_RDONLY | O_NONBLOCK);
+			break;
+		case source_file:
+			data->fd = open(data->source, O_RDONLY);
+			break;
+		case source_shm:
+			data->fd = shm_open(data->source, O_RDONLY, 0);
+			break;
+		case source_none:
+			fprintf(stderr, "pixelmap instance %s has no source configured\n", inst->name);
+			return 1;
+	}
+
+	if(data->fd < 0){
+		fprintf(stderr, "Failed to open pixelmap source %s for instance %s: %s\n", data->source, inst->name, strerror(errno));
+		return 1;
+	}
+
+	if(data->type == source_pipe){
+		return mm_manage_fd(data->fd, BACKEND_NAME, 1, inst);
+	}
+
+	if(fstat(data->fd, &info) || info.st_size < data->frame_size){
+		fprintf(stderr, "pixelmap source %s for instance %s is smaller than one frame (%" PRIsize_t " bytes)\n", data->source, inst->name, data->frame_size);
+		return 1;
+	}
+
+	if(data->type == source_shm){
+		data->map = mmap(NULL, data->frame_size, PROT_READ, MAP_SHARED, data->fd, 0);
+		if(data->map == MAP_FAILED){
+			data->map = NULL;
+			fprintf(stderr, "Failed to map pixelmap source %s for instance %s: %s\n", data->source, inst->name, strerror(errno));
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static int pixelmap_read(instance* inst, pixelmap_instance_data* data){
+	ssize_t bytes;
+	uint8_t* swap = NULL;
+
+	for(bytes = read(data->fd, data->incoming + data->fill, data->frame_size - data->fill);
+			bytes > 0;
+			bytes = read(data->fd, data->incoming + data->fill, data->frame_size - data->fill)){
+		data->fill += bytes;
+		if(data->fill == data->frame_size){
+			//only the most recent complete frame is processed
+			swap = data->frame;
+			data->frame = data->incoming;
+			data->incoming = swap;
+			data->fill = 0;
+			data->pending = 1;
+		}
+	}
+
+	if(data->pending){
+		pixelmap_process(data);
+	}
+
+	if(bytes < 0 && errno != EAGAIN && errno != EWOULDBLOCK){
+		fprintf(stderr, "Failed to read from pixelmap source %s for instance %s: %s\n", data->source, inst->name, strerror(errno));
+		return 1;
+	}
+
+	if(!bytes){
+		//the writer went away, reopen to wait for the next one and drop any partial frame
+		mm_manage_fd(data->fd, BACKEND_NAME, 0, NULL);
+		close(data->fd);
+		data->fd = -1;
+		data->fill = 0;
+		return pixelmap_open(inst, data);
+	}
+	return 0;
+}
+
+static int pixelmap_load(instance* inst, pixelmap_instance_data* data){
+	ssize_t bytes;
+
+	if(data->type == source_shm){
+		memcpy(data->frame, data->map, data->frame_size);
+		return 0;
+	}
+
+	bytes = pread(data->fd, data->frame, data->frame_size, data->position);
+	if(bytes >= 0 && bytes < data->frame_size){
+		//loop the file
+		data->position = 0;
+		bytes = pread(data->fd, data->frame, data->frame_size, 0);
+	}
+
+	if(bytes != data->frame_size){
+		fprintf(stderr, "Failed to read frame from pixelmap source %s for instance %s\n", data->source, inst->name);
+		return 1;
+	}
+	data->position += data->frame_size;
+	return 0;
+}
+
+static int pixelmap_handle(size_t num, managed_fd* fds){
+	size_t n, u;
+	instance** inst = NULL;
+	pixelmap_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+	int rv = 0;
+
+	for(u = 0; u < num; u++){
+		if(pixelmap_read((instance*) fds[u].impl, (pixelmap_instance_data*) ((instance*) fds[u].impl)->impl)){
+			return 1;
+		}
+	}
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (pixelmap_instance_data*) inst[u]->impl;
+		if(data->type == source_pipe || (!data->benchmark && now < data->next)){
+			continue;
+		}
+
+		if(pixelmap_load(inst[u], data)){
+			rv = 1;
+			break;
+		}
+		pixelmap_process(data);
+
+		//schedule the next frame without accumulating drift
+		data->ticks++;
+		data->next = data->epoch + (data->ticks * 1000) / data->fps;
+		if(data->next <= now){
+			data->epoch = now;
+			data->ticks = 1;
+			data->next = now + 1000 / data->fps;
+		}
+	}
+
+	free(inst);
+	return rv;
+}
+
+static uint32_t pixelmap_interval(){
+	size_t n, u;
+	instance** inst = NULL;
+	pixelmap_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+	uint32_t next = 1000;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return next;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (pixelmap_instance_data*) inst[u]->impl;
+		if(data->type != source_pipe){
+			next = (data->benchmark || data->next <= now) ? 0 : min(next, data->next - now);
+		}
+	}
+
+	free(inst);
+	return next;
+}
+
+static int pixelmap_parse_layout(instance* inst, pixelmap_instance_data* data){
+	FILE* layout = fopen(data->layout, "r");
+	char* line = NULL, *token = NULL, *order = "rgb", *next = NULL;
+	size_t alloc = 0, line_no = 0, tokens, component, slot;
+	long parameter[7], pixel, x, y;
+	pixelmap_universe* universe = NULL;
+	int rv = 1;
+
+	if(!layout){
+		fprintf(stderr, "Failed to open pixelmap layout %s for instance %s: %s\n", data->layout, inst->name, strerror(errno));
+		return 1;
+	}
+
+	for(; getline(&line, &alloc, layout) >= 0; line_no++){
+		//strip comments
+		if(strchr(line, '#')){
+			*strchr(line, '#') = 0;
+		}
+
+		//parse numeric fields and an optional component order
+		order = "rgb";
+		tokens = 0;
+		for(token = strtok(line, " \t\r\n"); token; token = strtok(NULL, " \t\r\n")){
+			if(tokens < 7 && (isdigit(*token) || *token == '-')){
+				parameter[tokens++] = strtol(token, &next, 10);
+				if(!*next){
+					continue;
+				}
+			}
+			else if(strspn(token, "rgb") == strlen(token) && strlen(token) <= PIXELMAP_PIXEL_SIZE){
+				order = token;
+				continue;
+			}
+			break;
+		}
+
+		if(!tokens && !token){
+			continue;
+		}
+
+		if(token || (tokens != 4 && tokens != 5 && tokens != 7)){
+			fprintf(stderr, "Invalid pixelmap layout line %" PRIsize_t " in %s, expected <universe> <slot> <x> <y> [<count> [<dx> <dy>]] [<order>]\n", line_no + 1, data->layout);
+			goto bail;
+		}
+
+		//fill in defaults for a single horizontal run
+		parameter[4] = (tokens > 4) ? parameter[4] : 1;
+		parameter[5] = (tokens > 5) ? parameter[5] : 1;
+		parameter[6] = (tokens > 5) ? parameter[6] : 0;
+
+		if(parameter[0] < 0 || parameter[0] > 0xFFFF
+				|| parameter[1] < 1 || parameter[4] < 1
+				|| parameter[1] - 1 + parameter[4] * strlen(order) > PIXELMAP_UNIVERSE_SIZE){
+			fprintf(stderr, "pixelmap layout line %" PRIsize_t " in %s exceeds the universe\n", line_no + 1, data->layout);
+			goto bail;
+		}
+
+		universe = pixelmap_universe_get(data, parameter[0]);
+		if(!universe){
+			goto bail;
+		}
+
+		slot = parameter[1] - 1;
+		for(pixel = 0; pixel < parameter[4]; pixel++){
+			x = parameter[2] + pixel * parameter[5];
+			y = parameter[3] + pixel * parameter[6];
+			if(x < 0 || x >= data->width || y < 0 || y >= data->height){
+				fprintf(stderr, "pixelmap layout line %" PRIsize_t " in %s leaves the %" PRIsize_t "x%" PRIsize_t " frame\n", line_no + 1, data->layout, data->width, data->height);
+				goto bail;
+			}
+
+			for(component = 0; order[component]; component++){
+				universe->offset[slot++] = (y * data->width + x) * PIXELMAP_PIXEL_SIZE
+					+ ((order[component] == 'r') ? 0 : (order[component] == 'g') ? 1 : 2);
+			}
+		}
+		universe->slots = max(universe->slots, slot);
+	}
+
+	rv = 0;
+bail:
+	free(line);
+	fclose(layout);
+	return rv;
+}
+
+static int pixelmap_start(){
+	size_t n, u, p, s;
+	instance** inst = NULL;
+	pixelmap_instance_data* data = NULL;
+	double value;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (pixelmap_instance_data*) inst[u]->impl;
+		if(!data->width || !data->height || !data->layout){
+			fprintf(stderr, "pixelmap instance %s requires the width, height and layout options\n", inst[u]->name);
+			goto bail;
+		}
+
+		//frame buffers carry one additional zero byte sampled by unmapped slots
+		data->frame_size = data->width * data->height * PIXELMAP_PIXEL_SIZE;
+		data->frame = mm_calloc(data->frame_size + 1, 1);
+		data->incoming = mm_calloc(data->frame_size + 1, 1);
+		if(!data->frame || !data->incoming){
+			fprintf(stderr, "Failed to allocate memory\n");
+			goto bail;
+		}
+
+		for(p = 0; p < data->universes; p++){
+			for(s = 0; s < PIXELMAP_UNIVERSE_SIZE; s++){
+				data->universe[p].offset[s] = data->frame_size;
+			}
+		}
+
+		if(pixelmap_parse_layout(inst[u], data)){
+			goto bail;
+		}
+
+		for(p = 0; p < data->universes; p++){
+			if(!data->universe[p].slots){
+				fprintf(stderr, "pixelmap instance %s universe %d is not covered by the layout\n", inst[u]->name, data->universe[p].universe);
+			}
+		}
+
+		//precompute the output curve for all input values
+		for(p = 0; p < 256; p++){
+			value = pow(p / 255.0, data->gamma) * data->brightness;
+			data->curve[p] = value * 255.0 + 0.5;
+		}
+
+		if(pixelmap_open(inst[u], data)){
+			goto bail;
+		}
+
+		data->epoch = data->next = mm_timestamp();
+		data->started = pixelmap_clock();
+	}
+
+	fprintf(stderr, "pixelmap backend registered %" PRIsize_t " instances\n", n);
+	rv = 0;
+bail:
+	free(inst);
+	return rv;
+}
+
+static int pixelmap_shutdown(){
+	size_t n, u;
+	instance** inst = NULL;
+	pixelmap_instance_data* data = NULL;
+	uint64_t elapsed;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (pixelmap_instance_data*) inst[u]->impl;
+
+		if(data->benchmark && data->frames){
+			elapsed = pixelmap_clock() - data->started;
+			fprintf(stderr, "pixelmap instance %s processed %" PRIu64 " frames of %" PRIsize_t " universes in %" PRIu64 " ms (%.1f fps), %.1f us per frame\n",
+					inst[u]->name, data->frames, data->universes, elapsed / 1000000,
+					data->frames * 1e9 / elapsed, data->process_time / 1e3 / data->frames);
+		}
+
+		if(data->map){
+			munmap(data->map, data->frame_size);
+		}
+		if(data->fd >= 0){
+			close(data->fd);
+		}
+		mm_free(data->frame);
+		mm_free(data->incoming);
+		mm_free(data->universe);
+		mm_free(data->source);
+		mm_free(data->layout);
+		mm_free(inst[u]->impl);
+	}
+
+	free(inst);
+	fprintf(stderr, "pixelmap backend shut down\n");
+	return 0;
+}
@@ -0,0 +1,87 @@
+#include "midimonster.h"
+
+int init();
+static int pixelmap_configure(char* option, char* value);
+static int pixelmap_configure_instance(instance* inst, char* option, char* value);
+static instance* pixelmap_instance();
+static channel* pixelmap_channel(instance* inst, char* spec);
+static int pixelmap_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int pixelmap_handle(size_t num, managed_fd* fds);
+static uint32_t pixelmap_interval();
+static int pixelmap_start();
+static int pixelmap_shutdown();
+
+#define PIXELMAP_DEFAULT_FPS 60
+#define PIXELMAP_UNIVERSE_SIZE 512
+/* Bytes per pixel of the input frames (packed 24-bit RGB) */
+#define PIXELMAP_PIXEL_SIZE 3
+
+typedef enum {
+	source_none = 0,
+	source_pipe,
+	source_file,
+	source_shm
+} pixelmap_source;
+
+typedef union {
+	struct {
+		uint16_t universe;
+		uint16_t slot;
+		uint8_t pad[4];
+	} fields;
+	uint64_t label;
+} pixelmap_channel_ident;
+
+/*
+ * The layout is compiled into a lookup table holding the frame byte
+ * offset sampled for each slot of a universe. Unmapped slots point to
+ * the zero byte past the end of the frame buffer, so the sampling loop
+ * runs without branches.
+ */
+typedef struct /*_pixelmap_universe*/ {
+	uint16_t universe;
+	size_t slots;
+	uint32_t offset[PIXELMAP_UNIVERSE_SIZE];
+	uint8_t value[PIXELMAP_UNIVERSE_SIZE];
+	channel* channel[PIXELMAP_UNIVERSE_SIZE];
+} pixelmap_universe;
+
+typedef struct /*_pixelmap_instance_data*/ {
+	pixelmap_source type;
+	char* source;
+	char* layout;
+	size_t width;
+	size_t height;
+	uint32_t fps;
+	double gamma;
+	double brightness;
+	uint8_t benchmark;
+	//set once output to the instance has been reported
+	uint8_t output_warned;
+
+	//combined gamma and brightness curve
+	uint8_t curve[256];
+
+	size_t universes;
+	pixelmap_universe* universe;
+
+	//input state
+	int fd;
+	uint8_t* map;
+	size_t frame_size;
+	uint8_t* frame;
+	uint8_t* incoming;
+	size_t fill;
+	uint8_t pending;
+	uint64_t position;
+
+	//frame pacing for file and shared memory sources
+	uint64_t epoch;
+	uint64_t ticks;
+	uint64_t next;
+
+	//processing statistics
+	uint64_t frames;
+	uint64_t process_time;
+	uint64_t started;
+} pixelmap_instance_data;
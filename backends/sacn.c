@@ -71,7 +71,7 @@ static int sacn_listener(char* host, char* port, uint8_t fd_flags){
 	}
 
 	//store fd
-	global_cfg.fd = realloc(global_cfg.fd, (global_cfg.fds + 1) * sizeof(sacn_fd));
+	global_cfg.fd = mm_realloc(global_cfg.fd, (global_cfg.fds + 1) * sizeof(sacn_fd));
 	if(!global_cfg.fd){
 		close(fd);
 		fprintf(stderr, "Failed to allocate memory\n");
@@ -189,7 +189,7 @@ static instance* sacn_instance(){
 		return NULL;
 	}
 
-	inst->impl = calloc(1, sizeof(sacn_instance_data));
+	inst->impl = mm_calloc(1, sizeof(sacn_instance_data));
 	if(!inst->impl){
 		fprintf(stderr, "Failed to allocate memory");
 		return NULL;
@@ -198,11 +198,56 @@ static instance* sacn_instance(){
 	return inst;
 }
 
+//pixel channels spanning consecutive slots: rgb<pixel>[@<first slot>] or rgbw<pixel>[@<first slot>]
+static channel* sacn_vector_channel(instance* inst, char* spec){
+	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
+	uint8_t components = (spec[3] == 'w') ? 4 : 3;
+	char* spec_next = spec + components;
+	unsigned pixel = strtoul(spec_next, &spec_next, 10), first = 1, u;
+	channel* chan = NULL;
+
+	if(*spec_next == '@'){
+		first = strtoul(spec_next + 1, &spec_next, 10);
+	}
+
+	if(!pixel || !first || *spec_next){
+		fprintf(stderr, "Invalid sACN pixel channel specification on instance %s: %s\n", inst->name, spec);
+		return NULL;
+	}
+
+	first += (pixel - 1) * components - 1;
+	if(first + components > 512){
+		fprintf(stderr, "sACN pixel channel exceeds the universe on instance %s: %s\n", inst->name, spec);
+		return NULL;
+	}
+
+	//all slots must be unmapped or already mapped to this pixel
+	for(u = first; u < first + components; u++){
+		if(IS_ACTIVE(data->data.map[u])
+				&& data->data.map[u] != ((u == first) ? (MAP_VECTOR | (first + components - 1)) : (MAP_COMPONENT | first))){
+			fprintf(stderr, "sACN channel %u already mapped in another mode on instance %s\n", u + 1, inst->name);
+			return NULL;
+		}
+		data->data.map[u] = (u == first) ? (MAP_VECTOR | (first + components - 1)) : (MAP_COMPONENT | first);
+	}
+
+	chan = mm_channel(inst, first, 1);
+	if(!chan || mm_channel_components(chan, components)){
+		return NULL;
+	}
+	return chan;
+}
+
 static channel* sacn_channel(instance* inst, char* spec){
 	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
 	char* spec_next = spec;
+	unsigned chan_a, chan_b = 0;
+	channel* chan = NULL;
 
-	unsigned chan_a = strtoul(spec, &spec_next, 10), chan_b = 0;
+	if(!strncmp(spec, "rgb", 3)){
+		return sacn_vector_channel(inst, spec);
+	}
+	chan_a = strtoul(spec, &spec_next, 10);
 	
 	//range check
 	if(!chan_a || chan_a > 512){
@@ -239,7 +284,13 @@ static channel* sacn_channel(instance* inst, char* spec){
 	}
 
 	data->data.map[chan_a] = (*spec_next == '+') ? (MAP_COARSE | chan_b) : (MAP_SINGLE | chan_a);
-	return mm_channel(inst, chan_a, 1);
+
+	//values are copied as integers between channels of the same resolution
+	chan = mm_channel(inst, chan_a, 1);
+	if(!chan || mm_channel_resolution(chan, (*spec_next == '+') ? 16 : 8)){
+		return NULL;
+	}
+	return chan;
 }
 
 static int sacn_transmit(instance* inst){
@@ -278,6 +329,7 @@ static int sacn_transmit(instance* inst){
 	memcpy(pdu.data.source_name, global_cfg.source_name, sizeof(pdu.data.source_name));
 	memcpy((((uint8_t*)pdu.data.data) + 1), data->data.out, 512);
 
+	mm_trace(mm_trace_transmit, global_cfg.fd[data->fd_index].fd, sizeof(pdu));
 	if(sendto(global_cfg.fd[data->fd_index].fd, (uint8_t*) &pdu, sizeof(pdu), 0, (struct sockaddr*) &data->dest_addr, data->dest_len) < 0){
 		fprintf(stderr, "Failed to output sACN frame for instance %s: %s\n", inst->name, strerror(errno));
 	}
@@ -292,7 +344,8 @@ static int sacn_transmit(instance* inst){
 }
 
 static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v){
-	size_t u, mark = 0;
+	size_t u, p, mark = 0;
+	uint8_t component;
 	sacn_instance_data* data = (sacn_instance_data*) inst->impl;
 
 	if(!num){
@@ -305,8 +358,18 @@ static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v){
 	}
 
 	for(u = 0; u < num; u++){
-		if(IS_WIDE(data->data.map[c[u]->ident])){
-			uint32_t val = v[u].normalised * ((double) 0xFFFF);
+		if(IS_VECTOR(data->data.map[c[u]->ident])){
+			//scale the 16-bit components to consecutive slots
+			for(p = 0; c[u]->ident + p <= MAPPED_CHANNEL(data->data.map[c[u]->ident]); p++){
+				component = (v[u].raw.component[p] * 255 + 0x7FFF) / 0xFFFF;
+				if(data->data.out[c[u]->ident + p] != component){
+					mark = 1;
+					data->data.out[c[u]->ident + p] = component;
+				}
+			}
+		}
+		else if(IS_WIDE(data->data.map[c[u]->ident])){
+			uint32_t val = v[u].raw.u64;
 
 			if(data->data.out[c[u]->ident] != ((val >> 8) & 0xFF)){
 				mark = 1;
@@ -318,9 +381,9 @@ static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v){
 				data->data.out[MAPPED_CHANNEL(data->data.map[c[u]->ident])] = val & 0xFF;
 			}
 		}
-		else if(data->data.out[c[u]->ident] != (v[u].normalised * 255.0)){
+		else if(data->data.out[c[u]->ident] != v[u].raw.u64){
 			mark = 1;
-			data->data.out[c[u]->ident] = v[u].normalised * 255.0;
+			data->data.out[c[u]->ident] = v[u].raw.u64;
 		}
 	}
 
@@ -333,7 +396,7 @@ static int sacn_set(instance* inst, size_t num, channel** c, channel_value* v){
 }
 
 static int sacn_process_frame(instance* inst, sacn_frame_root* frame, sacn_frame_data* data){
-	size_t u, max_mark = 0;
+	size_t u, p, max_mark = 0;
 	channel* chan = NULL;
 	channel_value val;
 	sacn_instance_data* inst_data = (sacn_instance_data*) inst->impl;
@@ -377,7 +440,7 @@ static int sacn_process_frame(instance* inst, sacn_frame_root* frame, sacn_frame
 		if(inst_data->data.map[u] & MAP_MARK){
 			//unmark and get channel
 			inst_data->data.map[u] &= ~MAP_MARK;
-			if(inst_data->data.map[u] & MAP_FINE){
+			if(inst_data->data.map[u] & (MAP_FINE | MAP_COMPONENT)){
 				chan = mm_channel(inst, MAPPED_CHANNEL(inst_data->data.map[u]), 0);
 			}
 			else{
@@ -390,7 +453,16 @@ static int sacn_process_frame(instance* inst, sacn_frame_root* frame, sacn_frame
 			}
 
 			//generate value
-			if(IS_WIDE(inst_data->data.map[u])){
+			if(IS_VECTOR(inst_data->data.map[u])){
+				//one event for all components of a pixel, 8-bit slots are scaled to 16 bits
+				memset(&val, 0, sizeof(val));
+				for(p = chan->ident; p <= MAPPED_CHANNEL(inst_data->data.map[chan->ident]); p++){
+					inst_data->data.map[p] &= ~MAP_MARK;
+					val.raw.component[p - chan->ident] = inst_data->data.in[p] * 0x0101;
+				}
+				val.normalised = (double) inst_data->data.in[chan->ident] / 255.0;
+			}
+			else if(IS_WIDE(inst_data->data.map[u])){
 				inst_data->data.map[MAPPED_CHANNEL(inst_data->data.map[u])] &= ~MAP_MARK;
 				val.raw.u64 = (uint16_t) (inst_data->data.in[u] << ((inst_data->data.map[u] & MAP_COARSE) ? 8 : 0));
 				val.raw.u64 |= (uint16_t) (inst_data->data.in[MAPPED_CHANNEL(inst_data->data.map[u])] << ((inst_data->data.map[u] & MAP_COARSE) ? 0 : 8));
@@ -595,7 +667,7 @@ static int sacn_start(){
 
 		if(data->xmit_prio){
 			//add to list of advertised universes for this fd
-			global_cfg.fd[data->fd_index].universe = realloc(global_cfg.fd[data->fd_index].universe, (global_cfg.fd[data->fd_index].universes + 1) * sizeof(uint16_t));
+			global_cfg.fd[data->fd_index].universe = mm_realloc(global_cfg.fd[data->fd_index].universe, (global_cfg.fd[data->fd_index].universes + 1) * sizeof(uint16_t));
 			if(!global_cfg.fd[data->fd_index].universe){
 				fprintf(stderr, "Failed to allocate memory\n");
 				goto bail;
@@ -618,7 +690,7 @@ static int sacn_start(){
 	fprintf(stderr, "sACN backend registering %" PRIsize_t " descriptors to core\n", global_cfg.fds);
 	for(u = 0; u < global_cfg.fds; u++){
 		//allocate memory for storing last frame transmission timestamp
-		global_cfg.fd[u].last_frame = calloc(global_cfg.fd[u].universes, sizeof(uint64_t));
+		global_cfg.fd[u].last_frame = mm_calloc(global_cfg.fd[u].universes, sizeof(uint64_t));
 		if(!global_cfg.fd[u].last_frame){
 			fprintf(stderr, "Failed to allocate memory\n");
 			goto bail;
@@ -644,16 +716,16 @@ static int sacn_shutdown(){
 	}
 
 	for(p = 0; p < n; p++){
-		free(inst[p]->impl);
+		mm_free(inst[p]->impl);
 	}
 	free(inst);
 
 	for(p = 0; p < global_cfg.fds; p++){
 		close(global_cfg.fd[p].fd);
-		free(global_cfg.fd[p].universe);
-		free(global_cfg.fd[p].last_frame);
+		mm_free(global_cfg.fd[p].universe);
+		mm_free(global_cfg.fd[p].last_frame);
 	}
-	free(global_cfg.fd);
+	mm_free(global_cfg.fd);
 	fprintf(stderr, "sACN backend shut down\n");
 	return 0;
 }
@@ -20,10 +20,13 @@ static int sacn_shutdown();
 #define MAP_FINE 0x0400
 #define MAP_SINGLE 0x0800
 #define MAP_MARK 0x1000
+#define MAP_VECTOR 0x2000
+#define MAP_COMPONENT 0x4000
 #define MAPPED_CHANNEL(a) ((a) & 0x01FF)
 #define IS_ACTIVE(a) ((a) & 0xFE00)
 #define IS_WIDE(a) ((a) & (MAP_FINE | MAP_COARSE))
 #define IS_SINGLE(a) ((a) & MAP_SINGLE)
+#define IS_VECTOR(a) ((a) & (MAP_VECTOR | MAP_COMPONENT))
 
 typedef struct /*_sacn_universe_model*/ {
 	uint8_t last_priority;
@@ -0,0 +1,417 @@
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "scene.h"
+
+#define BACKEND_NAME "scene"
+
+int init(){
+	backend scene = {
+		.name = BACKEND_NAME,
+		.conf = scene_configure,
+		.create = scene_instance,
+		.conf_instance = scene_configure_instance,
+		.channel = scene_channel,
+		.handle = scene_set,
+		.process = scene_handle,
+		.start = scene_start,
+		.shutdown = scene_shutdown,
+		.interval = scene_interval
+	};
+
+	if(sizeof(scene_channel_ident) != sizeof(uint64_t)){
+		fprintf(stderr, "scene channel identification union out of bounds\n");
+		return 1;
+	}
+
+	//register backend
+	if(mm_backend_register(scene)){
+		fprintf(stderr, "Failed to register scene backend\n");
+		return 1;
+	}
+	return 0;
+}
+
+static int scene_configure(char* option, char* value){
+	fprintf(stderr, "The scene backend does not take any global configuration\n");
+	return 1;
+}
+
+static int scene_configure_instance(instance* inst, char* option, char* value){
+	scene_instance_data* data = (scene_instance_data*) inst->impl;
+
+	if(data->channel){
+		fprintf(stderr, "scene instance %s must be configured before its channels are mapped\n", inst->name);
+		return 1;
+	}
+
+	if(!strcmp(option, "size")){
+		data->size = strtoul(value, NULL, 10);
+		if(!data->size){
+			fprintf(stderr, "Invalid snapshot size %s for scene instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "snapshots")){
+		data->snapshots = strtoul(value, NULL, 10);
+		if(!data->snapshots){
+			fprintf(stderr, "Invalid snapshot count %s for scene instance %s\n", value, inst->name);
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "fade")){
+		data->fade = strtoul(value, NULL, 10);
+		return 0;
+	}
+	else if(!strcmp(option, "file")){
+		mm_free(data->file);
+		data->file = mm_strdup(value);
+		if(!data->file){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown instance option %s for scene instance %s\n", option, inst->name);
+	return 1;
+}
+
+static instance* scene_instance(){
+	scene_instance_data* data = NULL;
+	instance* i = mm_instance();
+	if(!i){
+		return NULL;
+	}
+
+	data = mm_calloc(1, sizeof(scene_instance_data));
+	if(!data){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	data->size = SCENE_DEFAULT_SIZE;
+	data->snapshots = SCENE_DEFAULT_SNAPSHOTS;
+	i->impl = data;
+	return i;
+}
+
+static channel* scene_channel(instance* inst, char* spec){
+	scene_instance_data* data = (scene_instance_data*) inst->impl;
+	scene_channel_ident ident = {
+		.label = 0
+	};
+	char* token = spec;
+	uint32_t limit = data->size;
+	channel* result = NULL;
+
+	if(!strncmp(spec, "capture", 7)){
+		ident.fields.type = scene_capture;
+		limit = data->snapshots;
+		token += 7;
+	}
+	else if(!strncmp(spec, "recall", 6)){
+		ident.fields.type = scene_recall;
+		limit = data->snapshots;
+		token += 6;
+	}
+
+	ident.fields.index = strtoul(token, &token, 10);
+	if(*token || !ident.fields.index || ident.fields.index > limit){
+		fprintf(stderr, "Invalid channel specification %s for scene instance %s\n", spec, inst->name);
+		return NULL;
+	}
+	ident.fields.index--;
+
+	result = mm_channel(inst, ident.label, 1);
+	if(result && ident.fields.type == scene_value){
+		//cache the value channels for output
+		if(!data->channel){
+			data->channel = mm_calloc(data->size, sizeof(channel*));
+			if(!data->channel){
+				fprintf(stderr, "Failed to allocate memory\n");
+				return NULL;
+			}
+		}
+		data->channel[ident.fields.index] = result;
+	}
+	return result;
+}
+
+static void scene_output(scene_instance_data* data){
+	size_t u;
+	channel_value event;
+
+	if(!data->channel){
+		return;
+	}
+
+	for(u = 0; u < data->size; u++){
+		if(data->channel[u]){
+			event.normalised = data->current[u];
+			event.raw.dbl = data->current[u];
+			mm_channel_event(data->channel[u], event);
+		}
+	}
+}
+
+static void scene_recall_snapshot(instance* inst, uint32_t index){
+	scene_instance_data* data = (scene_instance_data*) inst->impl;
+	double* snapshot = data->snapshot + (size_t) index * data->size;
+
+	if(!data->valid[index]){
+		fprintf(stderr, "Snapshot %" PRIu32 " of scene instance %s has not been captured yet\n", index + 1, inst->name);
+		return;
+	}
+
+	if(data->fade){
+		memcpy(data->from, data->current, data->size * sizeof(double));
+		memcpy(data->to, snapshot, data->size * sizeof(double));
+		data->fading = 1;
+		data->fade_start = data->next = mm_timestamp();
+		return;
+	}
+
+	data->fading = 0;
+	memcpy(data->current, snapshot, data->size * sizeof(double));
+	scene_output(data);
+}
+
+static int scene_set(instance* inst, size_t num, channel** c, channel_value* v){
+	scene_instance_data* data = (scene_instance_data*) inst->impl;
+	scene_channel_ident ident;
+	size_t n;
+
+	for(n = 0; n < num; n++){
+		ident.label = c[n]->ident;
+		switch(ident.fields.type){
+			case scene_value:
+				data->current[ident.fields.index] = v[n].normalised;
+				break;
+			case scene_capture:
+				if(v[n].normalised > 0.5){
+					memcpy(data->snapshot + (size_t) ident.fields.index * data->size, data->current, data->size * sizeof(double));
+					data->valid[ident.fields.index] = 1;
+				}
+				break;
+			case scene_recall:
+				if(v[n].normalised > 0.5){
+					scene_recall_snapshot(inst, ident.fields.index);
+				}
+				break;
+		}
+	}
+	return 0;
+}
+
+static void scene_process(scene_instance_data* data, uint64_t now){
+	size_t u;
+	double progress = (double) (now - data->fade_start) / data->fade;
+
+	if(progress >= 1.0){
+		progress = 1.0;
+		data->fading = 0;
+	}
+
+	for(u = 0; u < data->size; u++){
+		data->current[u] = data->from[u] + (data->to[u] - data->from[u]) * progress;
+	}
+
+	scene_output(data);
+}
+
+static int scene_handle(size_t num, managed_fd* fds){
+	size_t n, u;
+	instance** inst = NULL;
+	scene_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (scene_instance_data*) inst[u]->impl;
+		if(!data->fading || now < data->next){
+			continue;
+		}
+
+		scene_process(data, now);
+		data->next = now + 1000 / SCENE_FADE_RATE;
+	}
+
+	free(inst);
+	return 0;
+}
+
+static uint32_t scene_interval(){
+	size_t n, u;
+	instance** inst = NULL;
+	scene_instance_data* data = NULL;
+	uint64_t now = mm_timestamp();
+	uint32_t next = 1000;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return next;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (scene_instance_data*) inst[u]->impl;
+		if(data->fading){
+			next = (data->next <= now) ? 0 : min(next, data->next - now);
+		}
+	}
+
+	free(inst);
+	return next;
+}
+
+static int scene_map_file(instance* inst){
+	scene_instance_data* data = (scene_instance_data*) inst->impl;
+	scene_file_header* header = NULL;
+	struct stat info;
+	int fd = open(data->file, O_RDWR | O_CREAT, 0644);
+
+	if(fd < 0){
+		fprintf(stderr, "Failed to open snapshot file %s for scene instance %s: %s\n", data->file, inst->name, strerror(errno));
+		return 1;
+	}
+
+	if(fstat(fd, &info)){
+		fprintf(stderr, "Failed to query snapshot file %s: %s\n", data->file, strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	if(info.st_size && info.st_size != data->store_length){
+		fprintf(stderr, "Snapshot file %s does not match the configuration of scene instance %s\n", data->file, inst->name);
+		close(fd);
+		return 1;
+	}
+
+	//new files are extended to the full size and initialized below
+	if(!info.st_size && ftruncate(fd, data->store_length)){
+		fprintf(stderr, "Failed to resize snapshot file %s: %s\n", data->file, strerror(errno));
+		close(fd);
+		return 1;
+	}
+
+	data->store = mmap(NULL, data->store_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	//the mapping stays valid after closing the descriptor
+	close(fd);
+	if(data->store == MAP_FAILED){
+		data->store = NULL;
+		fprintf(stderr, "Failed to map snapshot file %s: %s\n", data->file, strerror(errno));
+		return 1;
+	}
+	data->mapped = 1;
+
+	header = (scene_file_header*) data->store;
+	if(!info.st_size){
+		memcpy(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic));
+		header->size = data->size;
+		header->snapshots = data->snapshots;
+	}
+	else if(memcmp(header->magic, SCENE_FILE_MAGIC, sizeof(header->magic))
+			|| header->size != data->size
+			|| header->snapshots != data->snapshots){
+		fprintf(stderr, "Snapshot file %s does not match the configuration of scene instance %s\n", data->file, inst->name);
+		return 1;
+	}
+	return 0;
+}
+
+static int scene_start(){
+	size_t n, u, offset, valid;
+	instance** inst = NULL;
+	scene_instance_data* data = NULL;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (scene_instance_data*) inst[u]->impl;
+
+		//header, validity flags padded to the value alignment, snapshot values
+		offset = sizeof(scene_file_header) + data->snapshots;
+		offset += (sizeof(double) - offset % sizeof(double)) % sizeof(double);
+		data->store_length = offset + (size_t) data->snapshots * data->size * sizeof(double);
+
+		if(data->file){
+			if(scene_map_file(inst[u])){
+				goto bail;
+			}
+		}
+		else{
+			data->store = mm_calloc(data->store_length, 1);
+			if(!data->store){
+				fprintf(stderr, "Failed to allocate memory\n");
+				goto bail;
+			}
+		}
+
+		data->valid = data->store + sizeof(scene_file_header);
+		data->snapshot = (double*) (data->store + offset);
+
+		data->current = mm_calloc(data->size, sizeof(double));
+		data->from = mm_calloc(data->size, sizeof(double));
+		data->to = mm_calloc(data->size, sizeof(double));
+		if(!data->current || !data->from || !data->to){
+			fprintf(stderr, "Failed to allocate memory\n");
+			goto bail;
+		}
+
+		for(valid = offset = 0; offset < data->snapshots; offset++){
+			valid += data->valid[offset] ? 1 : 0;
+		}
+		fprintf(stderr, "scene instance %s holds %" PRIsize_t " of %" PRIu32 " snapshots with %" PRIu32 " channels\n", inst[u]->name, valid, data->snapshots, data->size);
+	}
+
+	rv = 0;
+bail:
+	free(inst);
+	return rv;
+}
+
+static int scene_shutdown(){
+	size_t n, u;
+	instance** inst = NULL;
+	scene_instance_data* data = NULL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		data = (scene_instance_data*) inst[u]->impl;
+		if(data->mapped){
+			msync(data->store, data->store_length, MS_SYNC);
+			munmap(data->store, data->store_length);
+		}
+		else{
+			mm_free(data->store);
+		}
+		mm_free(data->file);
+		mm_free(data->current);
+		mm_free(data->channel);
+		mm_free(data->from);
+		mm_free(data->to);
+		mm_free(inst[u]->impl);
+	}
+
+	free(inst);
+
+	fprintf(stderr, "scene backend shut down\n");
+	return 0;
+}
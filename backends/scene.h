@@ -0,0 +1,64 @@
+#include "midimonster.h"
+
+int init();
+static int scene_configure(char* option, char* value);
+static int scene_configure_instance(instance* inst, char* option, char* value);
+static instance* scene_instance();
+static channel* scene_channel(instance* inst, char* spec);
+static int scene_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int scene_handle(size_t num, managed_fd* fds);
+static uint32_t scene_interval();
+static int scene_start();
+static int scene_shutdown();
+
+#define SCENE_DEFAULT_SIZE 512
+#define SCENE_DEFAULT_SNAPSHOTS 16
+#define SCENE_FADE_RATE 50
+#define SCENE_FILE_MAGIC "MMSCENE1"
+
+typedef enum {
+	scene_value = 0,
+	scene_capture,
+	scene_recall
+} scene_channel_type;
+
+typedef union {
+	struct {
+		uint32_t index;
+		uint8_t type;
+		uint8_t pad[3];
+	} fields;
+	uint64_t label;
+} scene_channel_ident;
+
+/* Snapshot storage layout, also used for the persistent snapshot file */
+typedef struct /*_scene_file_header*/ {
+	char magic[8];
+	uint32_t size;
+	uint32_t snapshots;
+} scene_file_header;
+
+typedef struct /*_scene_instance_data*/ {
+	uint32_t size;
+	uint32_t snapshots;
+	uint32_t fade;
+	char* file;
+
+	//snapshot storage, either heap memory or a mapping of the snapshot file
+	uint8_t* store;
+	size_t store_length;
+	uint8_t mapped;
+	uint8_t* valid;
+	double* snapshot;
+
+	//current channel values and output channels
+	double* current;
+	channel** channel;
+
+	//running crossfade
+	uint8_t fading;
+	uint64_t fade_start;
+	uint64_t next;
+	double* from;
+	double* to;
+} scene_instance_data;
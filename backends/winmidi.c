@@ -188,7 +188,10 @@ static int winmidi_set(instance* inst, size_t num, channel** c, channel_value* v
 	} output = {
 		.dword = 0
 	};
-	size_t u;
+	size_t u, p, block, narrow, wide;
+	channel_value narrow_in[MMBACKEND_QUANTIZE_BLOCK], wide_in[MMBACKEND_QUANTIZE_BLOCK];
+	uint8_t value[MMBACKEND_QUANTIZE_BLOCK];
+	uint16_t bend[MMBACKEND_QUANTIZE_BLOCK], converted;
 
 	//early exit
 	if(!num){
@@ -200,43 +203,60 @@ static int winmidi_set(instance* inst, size_t num, channel** c, channel_value* v
 		return 0;
 	}
 
-	for(u = 0; u < num; u++){
-		ident.label = c[u]->ident;
-
-		switch(ident.fields.type){
-			case note:
-				output.components.status = 0x90 | ident.fields.channel;
-				output.components.data1 = ident.fields.control;
-				output.components.data2 = v[u].normalised * 127.0;
-				break;
-			case cc:
-				output.components.status = 0xB0 | ident.fields.channel;
-				output.components.data1 = ident.fields.control;
-				output.components.data2 = v[u].normalised * 127.0;
-				break;
-			case pressure:
-				output.components.status = 0xA0 | ident.fields.channel;
-				output.components.data1 = ident.fields.control;
-				output.components.data2 = v[u].normalised * 127.0;
-				break;
-			case aftertouch:
-				output.components.status = 0xD0 | ident.fields.channel;
-				output.components.data1 = v[u].normalised * 127.0;
-				output.components.data2 = 0;
-				break;
-			case pitchbend:
-				output.components.status = 0xE0 | ident.fields.channel;
-				output.components.data1 = ((int)(v[u].normalised * 16384.0)) & 0x7F;
-				output.components.data2 = (((int)(v[u].normalised * 16384.0)) >> 7) & 0x7F;
-				break;
-			default:
-				fprintf(stderr, "Unknown winmidi channel type %d\n", ident.fields.type);
-				continue;
+	for(u = 0; u < num; u += block){
+		//gather each block of the batch by output resolution and convert each in one pass
+		block = min(num - u, MMBACKEND_QUANTIZE_BLOCK);
+		for(p = 0, narrow = 0, wide = 0; p < block; p++){
+			ident.label = c[u + p]->ident;
+			if(ident.fields.type == pitchbend){
+				wide_in[wide++] = v[u + p];
+			}
+			else{
+				narrow_in[narrow++] = v[u + p];
+			}
 		}
+		mmbackend_quantize_u8(narrow, narrow_in, 127, value, NULL);
+		mmbackend_quantize_u16(wide, wide_in, 16383, bend, NULL);
+
+		for(p = 0, narrow = 0, wide = 0; p < block; p++){
+			ident.label = c[u + p]->ident;
+			converted = (ident.fields.type == pitchbend) ? bend[wide++] : value[narrow++];
+
+			switch(ident.fields.type){
+				case note:
+					output.components.status = 0x90 | ident.fields.channel;
+					output.components.data1 = ident.fields.control;
+					output.components.data2 = converted;
+					break;
+				case cc:
+					output.components.status = 0xB0 | ident.fields.channel;
+					output.components.data1 = ident.fields.control;
+					output.components.data2 = converted;
+					break;
+				case pressure:
+					output.components.status = 0xA0 | ident.fields.channel;
+					output.components.data1 = ident.fields.control;
+					output.components.data2 = converted;
+					break;
+				case aftertouch:
+					output.components.status = 0xD0 | ident.fields.channel;
+					output.components.data1 = converted;
+					output.components.data2 = 0;
+					break;
+				case pitchbend:
+					output.components.status = 0xE0 | ident.fields.channel;
+					output.components.data1 = converted & 0x7F;
+					output.components.data2 = (converted >> 7) & 0x7F;
+					break;
+				default:
+					fprintf(stderr, "Unknown winmidi channel type %d\n", ident.fields.type);
+					continue;
+			}
 
-		midiOutShortMsg(data->device_out, output.dword);
+			midiOutShortMsg(data->device_out, output.dword);
+		}
 	}
-	
+
 	return 0;
 }
 
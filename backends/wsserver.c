@@ -0,0 +1,878 @@
+#include <string.h>
+#include <errno.h>
+
+#include "libmmbackend.h"
+#include "wsserver.h"
+
+#define BACKEND_NAME "wsserver"
+
+//avoid SIGPIPE when writing to clients that went away
+#ifdef MSG_NOSIGNAL
+	#define WSSERVER_SEND_FLAGS MSG_NOSIGNAL
+#else
+	#define WSSERVER_SEND_FLAGS 0
+#endif
+
+#define SHA1_ROTL(a, n) (((a) << (n)) | ((a) >> (32 - (n))))
+
+static int listen_fd = -1;
+static uint32_t batch_interval = WSSERVER_DEFAULT_INTERVAL;
+static uint64_t last_batch = 0;
+//the position of an instance in this list identifies its set in messages
+static size_t sets = 0;
+static instance** set = NULL;
+static wsserver_client client[WSSERVER_MAX_CLIENTS];
+
+int init(){
+	backend wsserver = {
+		.name = BACKEND_NAME,
+		.conf = wsserver_configure,
+		.create = wsserver_instance,
+		.conf_instance = wsserver_configure_instance,
+		.channel = wsserver_channel,
+		.handle = wsserver_set,
+		.process = wsserver_handle,
+		.start = wsserver_start,
+		.shutdown = wsserver_shutdown,
+		.interval = wsserver_interval
+	};
+
+	//register backend
+	if(mm_backend_register(wsserver)){
+		fprintf(stderr, "Failed to register wsserver backend\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void wsserver_sha1_block(uint32_t* state, uint8_t* block){
+	uint32_t w[80], a = state[0], b = state[1], c = state[2], d = state[3], e = state[4], f, k, temp;
+	size_t u;
+
+	for(u = 0; u < 16; u++){
+		w[u] = ((uint32_t) block[u * 4] << 24) | ((uint32_t) block[u * 4 + 1] << 16) | ((uint32_t) block[u * 4 + 2] << 8) | block[u * 4 + 3];
+	}
+
+	for(u = 16; u < 80; u++){
+		w[u] = SHA1_ROTL(w[u - 3] ^ w[u - 8] ^ w[u - 14] ^ w[u - 16], 1);
+	}
+
+	for(u = 0; u < 80; u++){
+		if(u < 20){
+			f = (b & c) | (~b & d);
+			k = 0x5A827999;
+		}
+		else if(u < 40){
+			f = b ^ c ^ d;
+			k = 0x6ED9EBA1;
+		}
+		else if(u < 60){
+			f = (b & c) | (b & d) | (c & d);
+			k = 0x8F1BBCDC;
+		}
+		else{
+			f = b ^ c ^ d;
+			k = 0xCA62C1D6;
+		}
+
+		temp = SHA1_ROTL(a, 5) + f + e + k + w[u];
+		e = d;
+		d = c;
+		c = SHA1_ROTL(b, 30);
+		b = a;
+		a = temp;
+	}
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+}
+
+//SHA-1 is only used for the handshake accept key, so this does not need to be fast
+static void wsserver_sha1(uint8_t* data, size_t length, uint8_t* digest){
+	uint32_t state[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	uint64_t bits = ((uint64_t) length) * 8;
+	uint8_t block[64];
+	size_t u, offset;
+
+	for(offset = 0; offset + sizeof(block) <= length; offset += sizeof(block)){
+		wsserver_sha1_block(state, data + offset);
+	}
+
+	//pad the remainder with a single set bit and the message length
+	memset(block, 0, sizeof(block));
+	memcpy(block, data + offset, length - offset);
+	block[length - offset] = 0x80;
+	if(length - offset >= 56){
+		wsserver_sha1_block(state, block);
+		memset(block, 0, sizeof(block));
+	}
+
+	for(u = 0; u < 8; u++){
+		block[63 - u] = bits >> (u * 8);
+	}
+	wsserver_sha1_block(state, block);
+
+	for(u = 0; u < 20; u++){
+		digest[u] = state[u / 4] >> (24 - (u % 4) * 8);
+	}
+}
+
+//out needs to hold 4 * ((length + 2) / 3) + 1 characters
+static void wsserver_base64(uint8_t* data, size_t length, char* out){
+	char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	uint32_t triple;
+	size_t u, offset = 0;
+
+	for(u = 0; u < length; u += 3){
+		triple = (data[u] << 16)
+			| ((u + 1 < length) ? (data[u + 1] << 8) : 0)
+			| ((u + 2 < length) ? data[u + 2] : 0);
+
+		out[offset++] = alphabet[(triple >> 18) & 0x3F];
+		out[offset++] = alphabet[(triple >> 12) & 0x3F];
+		out[offset++] = (u + 1 < length) ? alphabet[(triple >> 6) & 0x3F] : '=';
+		out[offset++] = (u + 2 < length) ? alphabet[triple & 0x3F] : '=';
+	}
+	out[offset] = 0;
+}
+
+static int wsserver_configure(char* option, char* value){
+	char* host = NULL, *port = NULL;
+
+	if(!strcmp(option, "bind")){
+		mmbackend_parse_hostspec(value, &host, &port);
+		if(!host){
+			fprintf(stderr, "Invalid bind address %s for wsserver backend\n", value);
+			return 1;
+		}
+
+		if(listen_fd >= 0){
+			fprintf(stderr, "The wsserver backend can only be bound once\n");
+			return 1;
+		}
+
+		listen_fd = mmbackend_socket(host, port ? port : WSSERVER_DEFAULT_PORT, SOCK_STREAM, 1, 0);
+		if(listen_fd < 0){
+			fprintf(stderr, "Failed to bind wsserver backend to %s\n", value);
+			return 1;
+		}
+
+		if(listen(listen_fd, SOMAXCONN)){
+			fprintf(stderr, "Failed to listen on wsserver socket: %s\n", strerror(errno));
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "interval")){
+		batch_interval = strtoul(value, NULL, 10);
+		if(!batch_interval){
+			fprintf(stderr, "Invalid update interval %s for wsserver backend\n", value);
+			return 1;
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown wsserver backend option %s\n", option);
+	return 1;
+}
+
+static int wsserver_configure_instance(instance* inst, char* option, char* value){
+	fprintf(stderr, "The wsserver backend does not take any instance configuration\n");
+	return 1;
+}
+
+static instance* wsserver_instance(){
+	wsserver_instance_data* data = NULL;
+	instance* inst = mm_instance();
+	if(!inst){
+		return NULL;
+	}
+
+	data = mm_calloc(1, sizeof(wsserver_instance_data));
+	if(!data){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return NULL;
+	}
+
+	inst->impl = data;
+	return inst;
+}
+
+static channel* wsserver_channel(instance* inst, char* spec){
+	wsserver_instance_data* data = (wsserver_instance_data*) inst->impl;
+	channel* chan = NULL;
+	size_t u;
+
+	for(u = 0; u < data->channels; u++){
+		if(!strcmp(spec, data->channel_name[u])){
+			break;
+		}
+	}
+
+	if(u == data->channels){
+		if(data->channels >= WSSERVER_MAX_CHANNELS){
+			fprintf(stderr, "wsserver instance %s has more than %d channels\n", inst->name, WSSERVER_MAX_CHANNELS);
+			return NULL;
+		}
+
+		data->channel_name = mm_realloc(data->channel_name, (u + 1) * sizeof(char*));
+		data->value = mm_realloc(data->value, (u + 1) * sizeof(uint16_t));
+		data->changed = mm_realloc(data->changed, (u + 1) * sizeof(uint32_t));
+		data->dirty = mm_realloc(data->dirty, (u + 1) * sizeof(uint8_t));
+		if(!data->channel_name || !data->value || !data->changed || !data->dirty){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+
+		data->value[u] = 0;
+		data->dirty[u] = 0;
+		data->channel_name[u] = mm_strdup(spec);
+		if(!data->channel_name[u]){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return NULL;
+		}
+		data->channels++;
+	}
+
+	//values are transferred with 16 bits
+	chan = mm_channel(inst, u, 1);
+	if(!chan || mm_channel_resolution(chan, 16)){
+		return NULL;
+	}
+	return chan;
+}
+
+static void wsserver_update(wsserver_instance_data* data, size_t index, uint16_t value){
+	if(data->value[index] != value){
+		data->value[index] = value;
+		if(!data->dirty[index]){
+			data->dirty[index] = 1;
+			data->changed[data->changes] = index;
+			data->changes++;
+		}
+	}
+}
+
+static int wsserver_set(instance* inst, size_t num, channel** c, channel_value* v){
+	wsserver_instance_data* data = (wsserver_instance_data*) inst->impl;
+	size_t u;
+
+	//changes are collected and sent in the next batch
+	for(u = 0; u < num; u++){
+		wsserver_update(data, c[u]->ident, v[u].raw.u64);
+	}
+	return 0;
+}
+
+static void wsserver_close(wsserver_client* client){
+	mm_manage_fd(client->fd, BACKEND_NAME, 0, NULL);
+	close(client->fd);
+	mm_free(client->in);
+	mm_free(client->out);
+	memset(client, 0, sizeof(wsserver_client));
+	client->fd = -1;
+	client->state = client_unused;
+}
+
+//send as much pending output as the socket accepts without blocking, returns 1 if the client failed
+static int wsserver_flush(wsserver_client* client){
+	ssize_t sent;
+
+	while(client->out_length){
+		sent = send(client->fd, client->out, client->out_length, WSSERVER_SEND_FLAGS);
+		if(sent < 0){
+			#ifdef _WIN32
+			if(WSAGetLastError() == WSAEWOULDBLOCK){
+			#else
+			if(errno == EAGAIN || errno == EWOULDBLOCK){
+			#endif
+				return 0;
+			}
+			return 1;
+		}
+
+		mm_trace(mm_trace_transmit, client->fd, sent);
+		memmove(client->out, client->out + sent, client->out_length - sent);
+		client->out_length -= sent;
+	}
+	return 0;
+}
+
+static int wsserver_queue(wsserver_client* client, uint8_t* data, size_t length){
+	//clients that stopped reading are disconnected instead of buffering without bound
+	if(client->out_length + length > WSSERVER_MAX_QUEUE){
+		fprintf(stderr, "wsserver client exceeded the output limit, disconnecting\n");
+		return 1;
+	}
+
+	if(client->out_length + length > client->out_alloc){
+		client->out = mm_realloc(client->out, client->out_length + length);
+		if(!client->out){
+			fprintf(stderr, "Failed to allocate memory\n");
+			client->out_alloc = client->out_length = 0;
+			return 1;
+		}
+		client->out_alloc = client->out_length + length;
+	}
+
+	memcpy(client->out + client->out_length, data, length);
+	client->out_length += length;
+	return 0;
+}
+
+//server frames are not masked, returns the length of the header
+static size_t wsserver_frame_header(uint8_t* header, wsserver_operation op, size_t length){
+	size_t u;
+
+	header[0] = WS_FLAG_FIN | op;
+	if(length <= 125){
+		header[1] = length;
+		return 2;
+	}
+	else if(length <= 0xFFFF){
+		header[1] = 126;
+		header[2] = length >> 8;
+		header[3] = length & 0xFF;
+		return 4;
+	}
+
+	header[1] = 127;
+	for(u = 0; u < 8; u++){
+		header[2 + u] = ((uint64_t) length) >> (56 - u * 8);
+	}
+	return 10;
+}
+
+static int wsserver_send_frame(wsserver_client* client, wsserver_operation op, uint8_t* payload, size_t length){
+	uint8_t header[WSSERVER_FRAME_HEADER_LENGTH];
+	size_t header_length = wsserver_frame_header(header, op, length);
+
+	if(wsserver_queue(client, header, header_length)
+			|| wsserver_queue(client, payload, length)){
+		return 1;
+	}
+	return wsserver_flush(client);
+}
+
+static int wsserver_send_text(wsserver_client* client, char* text){
+	return wsserver_send_frame(client, ws_text, (uint8_t*) text, strlen(text));
+}
+
+static int wsserver_snapshot(wsserver_client* client, size_t index){
+	wsserver_instance_data* data = (wsserver_instance_data*) set[index]->impl;
+	uint8_t* payload = mm_calloc(2 + 2 * data->channels, sizeof(uint8_t));
+	size_t u;
+	int rv;
+
+	if(!payload){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	payload[0] = msg_snapshot;
+	payload[1] = index;
+	for(u = 0; u < data->channels; u++){
+		payload[2 + u * 2] = data->value[u] >> 8;
+		payload[3 + u * 2] = data->value[u] & 0xFF;
+	}
+
+	rv = wsserver_send_frame(client, ws_binary, payload, 2 + 2 * data->channels);
+	mm_free(payload);
+	return rv;
+}
+
+//announce the set identifier and channel indices, followed by the current values
+static int wsserver_subscribe(wsserver_client* client, size_t index){
+	wsserver_instance_data* data = (wsserver_instance_data*) set[index]->impl;
+	size_t u, length = strlen(set[index]->name) + 16, offset;
+	char* description = NULL;
+	int rv;
+
+	for(u = 0; u < data->channels; u++){
+		length += strlen(data->channel_name[u]) + 16;
+	}
+
+	description = mm_calloc(length, sizeof(char));
+	if(!description){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	offset = snprintf(description, length, "set %" PRIsize_t " %s\n", index, set[index]->name);
+	for(u = 0; u < data->channels; u++){
+		offset += snprintf(description + offset, length - offset, "channel %" PRIsize_t " %s\n", u, data->channel_name[u]);
+	}
+
+	client->subscribed[index / 8] |= 1 << (index % 8);
+	rv = wsserver_send_text(client, description);
+	mm_free(description);
+	return rv || wsserver_snapshot(client, index);
+}
+
+static int wsserver_handle_command(wsserver_client* client, char* command){
+	size_t u;
+	char* name = strchr(command, ' ');
+
+	if(name){
+		for(u = 0; u < sets; u++){
+			if(!strcmp(name + 1, set[u]->name)){
+				break;
+			}
+		}
+
+		if(u == sets){
+			return wsserver_send_text(client, "error unknown set");
+		}
+
+		if(!strncmp(command, "subscribe ", 10)){
+			return wsserver_subscribe(client, u);
+		}
+		else if(!strncmp(command, "unsubscribe ", 12)){
+			client->subscribed[u / 8] &= ~(1 << (u % 8));
+			return 0;
+		}
+	}
+
+	return wsserver_send_text(client, "error unknown command");
+}
+
+//delta messages from clients generate events on the referenced channels
+static int wsserver_handle_input(uint8_t* payload, size_t length){
+	wsserver_instance_data* data = NULL;
+	channel_value value = {
+		.raw = {0}
+	};
+	channel* chan = NULL;
+	size_t u, index;
+
+	if(length < 2 || payload[0] != msg_delta || payload[1] >= sets || (length - 2) % 4){
+		fprintf(stderr, "wsserver received invalid input message\n");
+		return 0;
+	}
+
+	data = (wsserver_instance_data*) set[payload[1]]->impl;
+	for(u = 2; u < length; u += 4){
+		index = (payload[u] << 8) | payload[u + 1];
+		if(index >= data->channels){
+			continue;
+		}
+
+		value.raw.u64 = (payload[u + 2] << 8) | payload[u + 3];
+		value.normalised = value.raw.u64 / 65535.0;
+		//other viewers are notified with the next batch
+		wsserver_update(data, index, value.raw.u64);
+
+		chan = mm_channel(set[payload[1]], index, 0);
+		if(chan){
+			mm_channel_event(chan, value);
+		}
+	}
+	return 0;
+}
+
+static ssize_t wsserver_handle_http(wsserver_client* client){
+	char* request = (char*) client->in, *end = NULL, *line = NULL, *key = NULL;
+	char key_buffer[128], accept_key[32], response[256];
+	uint8_t digest[20];
+	size_t key_length;
+
+	client->in[client->in_length] = 0;
+	end = strstr(request, "\r\n\r\n");
+	if(!end){
+		return 0;
+	}
+
+	//find the handshake key
+	for(line = strstr(request, "\r\n"); line && line < end; line = strstr(line + 2, "\r\n")){
+		if(!strncasecmp(line + 2, "Sec-WebSocket-Key:", 18)){
+			key = line + 20;
+			break;
+		}
+	}
+
+	if(strncmp(request, "GET ", 4) || !key){
+		fprintf(stderr, "wsserver received invalid handshake request\n");
+		wsserver_queue(client, (uint8_t*) "HTTP/1.1 400 Bad Request\r\n\r\n", 28);
+		wsserver_flush(client);
+		return -1;
+	}
+
+	for(; *key == ' '; key++){
+	}
+	for(key_length = 0; key[key_length] && key[key_length] != '\r' && key[key_length] != ' '; key_length++){
+	}
+
+	if(key_length > sizeof(key_buffer) - strlen(WSSERVER_GUID) - 1){
+		fprintf(stderr, "wsserver received invalid handshake key\n");
+		return -1;
+	}
+
+	//the accept key is the base64 encoded SHA-1 digest of the client key and a fixed GUID
+	snprintf(key_buffer, sizeof(key_buffer), "%.*s%s", (int) key_length, key, WSSERVER_GUID);
+	wsserver_sha1((uint8_t*) key_buffer, strlen(key_buffer), digest);
+	wsserver_base64(digest, sizeof(digest), accept_key);
+
+	snprintf(response, sizeof(response), "HTTP/1.1 101 Switching Protocols\r\n"
+			"Upgrade: websocket\r\n"
+			"Connection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: %s\r\n\r\n", accept_key);
+	if(wsserver_queue(client, (uint8_t*) response, strlen(response))
+			|| wsserver_flush(client)){
+		return -1;
+	}
+
+	client->state = client_open;
+	return end + 4 - request;
+}
+
+static ssize_t wsserver_handle_frame(wsserver_client* client){
+	size_t header_length = 2, u;
+	uint64_t length;
+	uint8_t* mask = NULL, *payload = NULL, terminator;
+	int rv = 0;
+
+	if(client->in_length < 2){
+		return 0;
+	}
+
+	length = WS_LEN(client->in[1]);
+	if(length == 126){
+		if(client->in_length < 4){
+			return 0;
+		}
+		length = (client->in[2] << 8) | client->in[3];
+		header_length = 4;
+	}
+	else if(length == 127){
+		if(client->in_length < 10){
+			return 0;
+		}
+		for(length = 0, u = 0; u < 8; u++){
+			length = (length << 8) | client->in[2 + u];
+		}
+		header_length = 10;
+	}
+
+	//all client frames must be masked
+	if(!(client->in[1] & WS_FLAG_MASK) || length > WSSERVER_MAX_MESSAGE){
+		fprintf(stderr, "wsserver received invalid frame\n");
+		return -1;
+	}
+
+	if(client->in_length < header_length + 4 + length){
+		return 0;
+	}
+
+	mask = client->in + header_length;
+	payload = mask + 4;
+	for(u = 0; u < length; u++){
+		payload[u] ^= mask[u % 4];
+	}
+
+	if(!(client->in[0] & WS_FLAG_FIN) || WS_OP(client->in[0]) == ws_continuation){
+		fprintf(stderr, "wsserver does not support fragmented messages\n");
+		return -1;
+	}
+
+	switch(WS_OP(client->in[0])){
+		case ws_text:
+			//terminate the command, the buffer has space for at least one additional byte
+			terminator = payload[length];
+			payload[length] = 0;
+			rv = wsserver_handle_command(client, (char*) payload);
+			payload[length] = terminator;
+			break;
+		case ws_binary:
+			rv = wsserver_handle_input(payload, length);
+			break;
+		case ws_ping:
+			rv = wsserver_send_frame(client, ws_pong, payload, length);
+			break;
+		case ws_pong:
+			break;
+		case ws_close:
+			//echo the close frame and drop the connection
+			wsserver_send_frame(client, ws_close, payload, length);
+			return -1;
+		default:
+			fprintf(stderr, "wsserver received unknown frame type %02X\n", WS_OP(client->in[0]));
+			return -1;
+	}
+
+	return rv ? -1 : header_length + 4 + length;
+}
+
+//read and process all available data, returns 1 if the client is to be closed
+static int wsserver_receive(wsserver_client* client){
+	ssize_t bytes_read, bytes_handled;
+
+	do{
+		//keep space for terminating the data
+		if(client->in_alloc - client->in_length < WSSERVER_RECV_CHUNK){
+			if(client->in_alloc >= WSSERVER_MAX_MESSAGE + 2 * WSSERVER_RECV_CHUNK){
+				fprintf(stderr, "wsserver client message too large\n");
+				return 1;
+			}
+
+			client->in = mm_realloc(client->in, client->in_alloc + WSSERVER_RECV_CHUNK);
+			if(!client->in){
+				fprintf(stderr, "Failed to allocate memory\n");
+				client->in_alloc = client->in_length = 0;
+				return 1;
+			}
+			client->in_alloc += WSSERVER_RECV_CHUNK;
+		}
+
+		bytes_read = recv(client->fd, client->in + client->in_length, client->in_alloc - client->in_length - 1, 0);
+		if(bytes_read == 0){
+			return 1;
+		}
+		else if(bytes_read < 0){
+			#ifdef _WIN32
+			if(WSAGetLastError() == WSAEWOULDBLOCK){
+			#else
+			if(errno == EAGAIN || errno == EWOULDBLOCK){
+			#endif
+				return 0;
+			}
+			fprintf(stderr, "wsserver failed to receive data: %s\n", strerror(errno));
+			return 1;
+		}
+		client->in_length += bytes_read;
+
+		//process complete requests and frames
+		do{
+			bytes_handled = (client->state == client_http) ? wsserver_handle_http(client) : wsserver_handle_frame(client);
+			if(bytes_handled < 0){
+				return 1;
+			}
+
+			memmove(client->in, client->in + bytes_handled, client->in_length - bytes_handled);
+			client->in_length -= bytes_handled;
+		} while(bytes_handled && client->in_length);
+	} while(bytes_read > 0);
+	return 0;
+}
+
+static int wsserver_accept(){
+	size_t u;
+	int fd;
+
+	for(fd = accept(listen_fd, NULL, NULL); fd >= 0; fd = accept(listen_fd, NULL, NULL)){
+		for(u = 0; u < WSSERVER_MAX_CLIENTS; u++){
+			if(client[u].state == client_unused){
+				break;
+			}
+		}
+
+		if(u == WSSERVER_MAX_CLIENTS){
+			fprintf(stderr, "wsserver client limit reached, rejecting connection\n");
+			close(fd);
+			continue;
+		}
+
+		//client sockets never block the core
+		#ifdef _WIN32
+		u_long mode = 1;
+		if(ioctlsocket(fd, FIONBIO, &mode) != NO_ERROR){
+		#else
+		if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK) < 0){
+		#endif
+			fprintf(stderr, "Failed to set wsserver client socket nonblocking\n");
+			close(fd);
+			continue;
+		}
+
+		if(mm_manage_fd(fd, BACKEND_NAME, 1, client + u)){
+			close(fd);
+			continue;
+		}
+
+		memset(client + u, 0, sizeof(wsserver_client));
+		client[u].fd = fd;
+		client[u].state = client_http;
+	}
+	return 0;
+}
+
+//encode the changes of a set once and queue them for all subscribers
+static int wsserver_transmit(size_t index){
+	wsserver_instance_data* data = (wsserver_instance_data*) set[index]->impl;
+	size_t u, payload_length = 2 + 4 * data->changes, header_length;
+	uint8_t* frame = NULL, *payload = NULL;
+
+	if(!data->changes){
+		return 0;
+	}
+
+	frame = mm_calloc(WSSERVER_FRAME_HEADER_LENGTH + payload_length, sizeof(uint8_t));
+	if(!frame){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	header_length = wsserver_frame_header(frame, ws_binary, payload_length);
+	payload = frame + header_length;
+	payload[0] = msg_delta;
+	payload[1] = index;
+	for(u = 0; u < data->changes; u++){
+		payload[2 + u * 4] = data->changed[u] >> 8;
+		payload[3 + u * 4] = data->changed[u] & 0xFF;
+		payload[4 + u * 4] = data->value[data->changed[u]] >> 8;
+		payload[5 + u * 4] = data->value[data->changed[u]] & 0xFF;
+		data->dirty[data->changed[u]] = 0;
+	}
+	data->changes = 0;
+
+	for(u = 0; u < WSSERVER_MAX_CLIENTS; u++){
+		if(client[u].state != client_open || !WSSERVER_SUBSCRIBED(client + u, index) || client[u].stale){
+			continue;
+		}
+
+		//slow clients skip deltas and are resynchronized with a snapshot once their backlog is sent
+		if(client[u].out_length > WSSERVER_MAX_BACKLOG){
+			client[u].stale = 1;
+			continue;
+		}
+
+		if(wsserver_queue(client + u, frame, header_length + payload_length)){
+			wsserver_close(client + u);
+		}
+	}
+
+	mm_free(frame);
+	return 0;
+}
+
+static int wsserver_handle(size_t num, managed_fd* fds){
+	size_t u, p;
+	uint64_t now = mm_timestamp();
+
+	for(u = 0; u < num; u++){
+		if(!fds[u].impl){
+			wsserver_accept();
+		}
+		else if(wsserver_receive((wsserver_client*) fds[u].impl)){
+			wsserver_close((wsserver_client*) fds[u].impl);
+		}
+	}
+
+	if(now - last_batch >= batch_interval){
+		last_batch = now;
+		for(u = 0; u < sets; u++){
+			wsserver_transmit(u);
+		}
+	}
+
+	//continue sending pending output
+	for(u = 0; u < WSSERVER_MAX_CLIENTS; u++){
+		if(client[u].state != client_open){
+			continue;
+		}
+
+		if(wsserver_flush(client + u)){
+			wsserver_close(client + u);
+			continue;
+		}
+
+		if(client[u].stale && !client[u].out_length){
+			client[u].stale = 0;
+			for(p = 0; p < sets; p++){
+				if(WSSERVER_SUBSCRIBED(client + u, p) && wsserver_snapshot(client + u, p)){
+					wsserver_close(client + u);
+					break;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static uint32_t wsserver_interval(){
+	size_t u;
+	uint64_t now = mm_timestamp();
+	uint8_t pending = 0;
+
+	for(u = 0; !pending && u < sets; u++){
+		pending = ((wsserver_instance_data*) set[u]->impl)->changes ? 1 : 0;
+	}
+
+	for(u = 0; !pending && u < WSSERVER_MAX_CLIENTS; u++){
+		pending = (client[u].state == client_open && client[u].out_length) ? 1 : 0;
+	}
+
+	if(!pending){
+		return 1000;
+	}
+	return (now - last_batch >= batch_interval) ? 0 : batch_interval - (now - last_batch);
+}
+
+static int wsserver_start(){
+	if(mm_backend_instances(BACKEND_NAME, &sets, &set)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	if(!sets){
+		return 0;
+	}
+
+	if(sets > WSSERVER_MAX_SETS){
+		fprintf(stderr, "The wsserver backend supports at most %d instances\n", WSSERVER_MAX_SETS);
+		return 1;
+	}
+
+	if(listen_fd < 0){
+		fprintf(stderr, "The wsserver backend requires a bind address\n");
+		return 1;
+	}
+
+	fprintf(stderr, "wsserver backend registering 1 descriptor to core\n");
+	return mm_manage_fd(listen_fd, BACKEND_NAME, 1, NULL);
+}
+
+static int wsserver_shutdown(){
+	size_t n, u, p;
+	instance** inst = NULL;
+	wsserver_instance_data* data = NULL;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst)){
+		fprintf(stderr, "Failed to fetch instance list\n");
+		return 1;
+	}
+
+	for(u = 0; u < WSSERVER_MAX_CLIENTS; u++){
+		if(client[u].state != client_unused){
+			close(client[u].fd);
+		}
+		mm_free(client[u].in);
+		mm_free(client[u].out);
+	}
+
+	for(u = 0; u < n; u++){
+		data = (wsserver_instance_data*) inst[u]->impl;
+		for(p = 0; p < data->channels; p++){
+			mm_free(data->channel_name[p]);
+		}
+		mm_free(data->channel_name);
+		mm_free(data->value);
+		mm_free(data->changed);
+		mm_free(data->dirty);
+		mm_free(inst[u]->impl);
+	}
+	free(inst);
+	free(set);
+	set = NULL;
+	sets = 0;
+
+	if(listen_fd >= 0){
+		close(listen_fd);
+	}
+	listen_fd = -1;
+
+	fprintf(stderr, "wsserver backend shut down\n");
+	return 0;
+}
@@ -0,0 +1,85 @@
+#include "midimonster.h"
+
+int init();
+static int wsserver_configure(char* option, char* value);
+static int wsserver_configure_instance(instance* inst, char* option, char* value);
+static instance* wsserver_instance();
+static channel* wsserver_channel(instance* inst, char* spec);
+static int wsserver_set(instance* inst, size_t num, channel** c, channel_value* v);
+static int wsserver_handle(size_t num, managed_fd* fds);
+static uint32_t wsserver_interval();
+static int wsserver_start();
+static int wsserver_shutdown();
+
+#define WSSERVER_DEFAULT_PORT "8080"
+#define WSSERVER_DEFAULT_INTERVAL 50
+#define WSSERVER_MAX_CLIENTS 64
+#define WSSERVER_MAX_CHANNELS 65536
+#define WSSERVER_MAX_SETS 256
+#define WSSERVER_RECV_CHUNK 1024
+/* Maximum size of the HTTP request and of incoming messages */
+#define WSSERVER_MAX_MESSAGE 65536
+/* Clients with more pending output skip delta frames until they caught up */
+#define WSSERVER_MAX_BACKLOG (1024 * 1024)
+/* Clients with more pending output are disconnected */
+#define WSSERVER_MAX_QUEUE (8 * 1024 * 1024)
+#define WSSERVER_FRAME_HEADER_LENGTH 10
+#define WSSERVER_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+#define WS_LEN(a) ((a) & 0x7F)
+#define WS_OP(a) ((a) & 0x0F)
+#define WS_FLAG_FIN 0x80
+#define WS_FLAG_MASK 0x80
+
+typedef enum /*_wsserver_frame_op*/ {
+	ws_continuation = 0,
+	ws_text = 1,
+	ws_binary = 2,
+	ws_close = 8,
+	ws_ping = 9,
+	ws_pong = 10
+} wsserver_operation;
+
+/* Binary message types, followed by the set identifier */
+typedef enum /*_wsserver_message_type*/ {
+	//all values of a set in channel order
+	msg_snapshot = 0,
+	//pairs of channel index and value
+	msg_delta = 1
+} wsserver_message_type;
+
+typedef enum /*_wsserver_client_state*/ {
+	client_unused = 0,
+	client_http,
+	client_open
+} wsserver_client_state;
+
+typedef struct /*_wsserver_client*/ {
+	int fd;
+	wsserver_client_state state;
+	uint8_t stale;
+	uint8_t subscribed[WSSERVER_MAX_SETS / 8];
+
+	//incoming data not yet processed
+	size_t in_length;
+	size_t in_alloc;
+	uint8_t* in;
+
+	//outgoing data not yet accepted by the socket
+	size_t out_length;
+	size_t out_alloc;
+	uint8_t* out;
+} wsserver_client;
+
+typedef struct /*_wsserver_instance_data*/ {
+	size_t channels;
+	char** channel_name;
+	uint16_t* value;
+
+	//channels changed since the last delta frame
+	size_t changes;
+	uint32_t* changed;
+	uint8_t* dirty;
+} wsserver_instance_data;
+
+#define WSSERVER_SUBSCRIBED(client, set) ((client)->subscribed[(set) / 8] & (1 << ((set) % 8)))
@@ -5,12 +5,14 @@
 #include "midimonster.h"
 #include "config.h"
 #include "backend.h"
+#include "merge.h"
 
 static enum {
 	none,
 	backend_cfg,
 	instance_cfg,
-	map
+	map,
+	core_cfg
 } parser_state = none;
 
 typedef enum {
@@ -216,7 +218,9 @@ static channel* config_glob_resolve(instance* inst, channel_spec* spec, uint64_t
 		}
 	}
 
+	memory_owner(instance_memory(inst));
 	result = inst->backend->channel(inst, resolved_spec);
+	memory_owner(NULL);
 	if(spec->globs && !result){
 		fprintf(stderr, "Failed to match multichannel evaluation %s to a channel\n", resolved_spec);
 	}
@@ -226,6 +230,66 @@ bail:
 	return result;
 }
 
+//assign a merge policy or latency class to a set of channels
+static int config_assign(char* target_raw, char* value){
+	//create a copy because the original pointer may be used multiple times
+	char* target = strdup(target_raw);
+	channel_spec spec = {
+		.spec = target
+	};
+	instance* inst = NULL;
+	channel* resolved = NULL;
+	latency_class class;
+	uint64_t n = 0;
+	int rv = 1;
+
+	if(!target){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	for(class = latency_realtime; class < latency_classes && strcmp(value, latency_name(class)); class++){
+	}
+
+	//separate channel spec from instance
+	for(; *(spec.spec) && *(spec.spec) != '.'; spec.spec++){
+	}
+
+	if(!spec.spec[0]){
+		fprintf(stderr, "Channel assignment does not contain a proper instance specification\n");
+		goto done;
+	}
+
+	spec.spec[0] = 0;
+	spec.spec++;
+
+	inst = instance_match(target);
+	if(!inst){
+		fprintf(stderr, "No such instance %s\n", target);
+		goto done;
+	}
+
+	if(config_glob_scan(inst, &spec)){
+		goto done;
+	}
+
+	//iterate, resolve globs and set policy or class
+	rv = 0;
+	for(n = 0; !rv && n < spec.channels; n++){
+		resolved = config_glob_resolve(inst, &spec, n);
+		if(!resolved){
+			rv = 1;
+			goto done;
+		}
+		rv |= (class < latency_classes) ? channel_latency_set(resolved, class) : merge_channel(resolved, value);
+	}
+
+done:
+	free(spec.glob);
+	free(target);
+	return rv;
+}
+
 static int config_map(char* to_raw, char* from_raw){
 	//create a copy because the original pointer may be used multiple times
 	char* to = strdup(to_raw), *from = strdup(from_raw);
@@ -318,6 +382,7 @@ int config_read(char* cfg_filepath){
 	ssize_t status;
 	map_type mapping_type = map_rtl;
 	char* line_raw = NULL, *line, *separator;
+	FILE* source = NULL;
 
 	//create heap copy of file name because original might be in readonly memory
 	char* source_dir = strdup(cfg_filepath), *source_file = NULL;
@@ -346,7 +411,7 @@ int config_read(char* cfg_filepath){
 		source_file = source_dir;
 	}
 
-	FILE* source = fopen(source_file, "r");
+	source = fopen(source_file, "r");
 
 	if(!source){
 		fprintf(stderr, "Failed to open configuration file for reading\n");
@@ -375,6 +440,10 @@ int config_read(char* cfg_filepath){
 				//mapping configuration
 				parser_state = map;
 			}
+			else if(!strcmp(line, "[core]")){
+				//core configuration
+				parser_state = core_cfg;
+			}
 			else{
 				//backend instance configuration
 				parser_state = instance_cfg;
@@ -410,7 +479,10 @@ int config_read(char* cfg_filepath){
 					goto bail;
 				}
 
+				//allocations after mm_instance() are charged to the new instance
+				memory_owner(backend_memory(current_backend));
 				current_instance = current_backend->create();
+				memory_owner(NULL);
 				if(!current_instance){
 					fprintf(stderr, "Failed to instantiate backend %s\n", line);
 					goto bail;
@@ -437,6 +509,18 @@ int config_read(char* cfg_filepath){
 					break;
 				case 0:
 				default:
+					//merge policy or latency class assignment
+					separator = strchr(line, '=');
+					if(separator){
+						*separator = 0;
+						separator = config_trim_line(separator + 1);
+						line = config_trim_line(line);
+						if(config_assign(line, separator)){
+							fprintf(stderr, "Failed to assign %s to %s\n", separator, line);
+							goto bail;
+						}
+						continue;
+					}
 					fprintf(stderr, "Not a channel mapping: %s\n", line);
 					goto bail;
 			}
@@ -477,19 +561,39 @@ int config_read(char* cfg_filepath){
 			line = config_trim_line(line);
 			separator = config_trim_line(separator);
 
+			if(parser_state == backend_cfg){
+				memory_owner(backend_memory(current_backend));
+			}
+			else if(parser_state == instance_cfg){
+				memory_owner(instance_memory(current_instance));
+			}
+
 			if(parser_state == backend_cfg && current_backend->conf(line, separator)){
 				fprintf(stderr, "Failed to configure backend %s\n", current_backend->name);
 				goto bail;
 			}
+			else if(parser_state == instance_cfg && !strncmp(line, "core.", 5)){
+				//core options for this instance
+				if(mm_core_instance_configure(current_instance, line + 5, separator)){
+					fprintf(stderr, "Failed to configure instance %s\n", current_instance->name);
+					goto bail;
+				}
+			}
 			else if(parser_state == instance_cfg && current_backend->conf_instance(current_instance, line, separator)){
 				fprintf(stderr, "Failed to configure instance %s\n", current_instance->name);
 				goto bail;
 			}
+			else if(parser_state == core_cfg && mm_core_configure(line, separator)){
+				fprintf(stderr, "Failed to configure core option %s\n", line);
+				goto bail;
+			}
+			memory_owner(NULL);
 		}
 	}
 
 	rv = 0;
 bail:
+	memory_owner(NULL);
 	free(source_dir);
 	if(source){
 		fclose(source);
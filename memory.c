@@ -0,0 +1,152 @@
+#include <string.h>
+#ifndef _WIN32
+#define MM_API __attribute__((visibility("default")))
+#else
+#define MM_API __attribute__((dllexport))
+#endif
+#include "midimonster.h"
+#include "memory.h"
+
+/* Accounting data stored in front of every accounted allocation */
+typedef union /*_mm_memory_header*/ {
+	struct {
+		memory_account* account;
+		size_t size;
+	} info;
+	max_align_t align;
+} memory_header;
+
+static memory_account core_account[memory_subsystems] = {
+	{0}
+};
+
+static char* core_name[memory_subsystems] = {
+	"unattributed",
+	"routing table",
+	"event queues",
+	"value store",
+	"merge state",
+	"instances",
+	"trace buffers"
+};
+
+/* Owner charged for allocations made through the backend API, set by the main thread while calling into backends */
+static _Thread_local memory_account* owner = NULL;
+
+memory_account* memory_core(memory_subsystem subsystem){
+	return core_account + subsystem;
+}
+
+memory_account* memory_owner(memory_account* account){
+	memory_account* previous = owner;
+	owner = account;
+	return previous;
+}
+
+//allocations may happen in backend threads, so the counters are updated atomically
+static void memory_charge(memory_account* account, size_t size){
+	size_t current = __atomic_add_fetch(&account->current, size, __ATOMIC_RELAXED);
+	__atomic_add_fetch(&account->allocations, 1, __ATOMIC_RELAXED);
+	if(current > account->peak){
+		account->peak = current;
+	}
+}
+
+static void memory_release(memory_account* account, size_t size){
+	__atomic_sub_fetch(&account->current, size, __ATOMIC_RELAXED);
+}
+
+void* memory_calloc(memory_account* account, size_t n, size_t size){
+	memory_header* header = NULL;
+
+	if(size && n > (SIZE_MAX - sizeof(memory_header)) / size){
+		return NULL;
+	}
+
+	header = calloc(1, sizeof(memory_header) + n * size);
+	if(!header){
+		return NULL;
+	}
+
+	header->info.account = account ? account : (owner ? owner : core_account + memory_unattributed);
+	header->info.size = n * size;
+	memory_charge(header->info.account, header->info.size);
+	return header + 1;
+}
+
+void* memory_realloc(memory_account* account, void* ptr, size_t size){
+	memory_header* header = ptr ? ((memory_header*) ptr) - 1 : NULL;
+	memory_header* resized = NULL;
+
+	if(!ptr){
+		return memory_calloc(account, 1, size);
+	}
+
+	if(size > SIZE_MAX - sizeof(memory_header)){
+		return NULL;
+	}
+
+	//reallocated memory stays charged to its original owner
+	resized = realloc(header, sizeof(memory_header) + size);
+	if(!resized){
+		return NULL;
+	}
+
+	memory_release(resized->info.account, resized->info.size);
+	resized->info.size = size;
+	memory_charge(resized->info.account, size);
+	return resized + 1;
+}
+
+void memory_free(void* ptr){
+	memory_header* header = NULL;
+
+	if(!ptr){
+		return;
+	}
+
+	header = ((memory_header*) ptr) - 1;
+	memory_release(header->info.account, header->info.size);
+	free(header);
+}
+
+void memory_print(char* name, memory_account* account){
+	fprintf(stderr, "\t%-32s %12" PRIsize_t " %12" PRIsize_t " %12" PRIu64 "\n", name, account->current, account->peak, account->allocations);
+}
+
+void memory_report(){
+	size_t u;
+
+	fprintf(stderr, "\t%-32s %12s %12s %12s\n", "Memory", "Current", "Peak", "Allocations");
+	for(u = 0; u < memory_subsystems; u++){
+		memory_print(core_name[u], core_account + u);
+	}
+}
+
+//mark the owner of a new allocation as using the accounted allocator
+static void* memory_requested(void* ptr){
+	if(ptr){
+		__atomic_add_fetch(&(((memory_header*) ptr) - 1)->info.account->requests, 1, __ATOMIC_RELAXED);
+	}
+	return ptr;
+}
+
+MM_API void* mm_calloc(size_t n, size_t size){
+	return memory_requested(memory_calloc(NULL, n, size));
+}
+
+MM_API void* mm_realloc(void* ptr, size_t size){
+	return ptr ? memory_realloc(NULL, ptr, size) : memory_requested(memory_calloc(NULL, 1, size));
+}
+
+MM_API char* mm_strdup(char* s){
+	char* copy = memory_requested(memory_calloc(NULL, strlen(s) + 1, 1));
+	if(copy){
+		memcpy(copy, s, strlen(s));
+	}
+	return copy;
+}
+
+MM_API void mm_free(void* ptr){
+	memory_free(ptr);
+}
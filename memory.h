@@ -0,0 +1,31 @@
+#include <stddef.h>
+
+/* Allocation statistics of one owner of memory */
+typedef struct /*_mm_memory_account*/ {
+	size_t current;
+	size_t peak;
+	uint64_t allocations;
+	//allocations requested by backends through the mm_* API
+	uint64_t requests;
+} memory_account;
+
+/* Core subsystems accounted separately */
+typedef enum /*_mm_memory_subsystem*/ {
+	memory_unattributed = 0,
+	memory_routing,
+	memory_events,
+	memory_values,
+	memory_merge,
+	memory_instances,
+	memory_trace,
+	memory_subsystems
+} memory_subsystem;
+
+/* Internal API */
+memory_account* memory_core(memory_subsystem subsystem);
+memory_account* memory_owner(memory_account* account);
+void* memory_calloc(memory_account* account, size_t n, size_t size);
+void* memory_realloc(memory_account* account, void* ptr, size_t size);
+void memory_free(void* ptr);
+void memory_print(char* name, memory_account* account);
+void memory_report();
@@ -0,0 +1,382 @@
+#include <string.h>
+#include "midimonster.h"
+#include "merge.h"
+#include "backend.h"
+
+/* Policies for combining events from multiple sources mapped to one channel */
+typedef enum /*_mm_merge_policy*/ {
+	merge_none = 0,
+	merge_ltp,
+	merge_htp,
+	merge_priority,
+	merge_average
+} merge_policy;
+
+/* Per-instance merge settings, applying to channels of the instance as target or source */
+typedef struct /*_mm_merge_instance*/ {
+	instance* inst;
+	merge_policy policy;
+	uint32_t priority;
+} merge_instance;
+
+/* Last value seen from one source of a merged channel, a sequence of 0 marks no value yet */
+typedef struct /*_mm_merge_input*/ {
+	channel_value value;
+	uint64_t sequence;
+	size_t target;
+	uint32_t priority;
+} merge_input;
+
+/* Merge state for one target channel, inputs are stored contiguously in the shared input pool */
+typedef struct /*_mm_merge_target*/ {
+	channel_value output;
+	size_t input;
+	uint32_t inputs;
+	uint8_t policy;
+	uint8_t components;
+	uint8_t valid;
+} merge_target;
+
+static size_t ninstances = 0;
+static merge_instance* instances = NULL;
+
+/* Explicit channel policies by channel id */
+static size_t policies_alloc = 0;
+static uint8_t* policies = NULL;
+
+static size_t ntargets = 0;
+static merge_target* targets = NULL;
+static size_t ninputs = 0;
+static merge_input* inputs = NULL;
+static uint64_t sequence = 0;
+
+static int merge_parse_policy(char* name, merge_policy* policy){
+	if(!strcmp(name, "none")){
+		*policy = merge_none;
+	}
+	else if(!strcmp(name, "ltp")){
+		*policy = merge_ltp;
+	}
+	else if(!strcmp(name, "htp")){
+		*policy = merge_htp;
+	}
+	else if(!strcmp(name, "priority")){
+		*policy = merge_priority;
+	}
+	else if(!strcmp(name, "average")){
+		*policy = merge_average;
+	}
+	else{
+		fprintf(stderr, "Unknown merge policy %s\n", name);
+		return 1;
+	}
+	return 0;
+}
+
+static merge_instance* merge_instance_find(instance* inst, uint8_t create){
+	size_t u;
+	for(u = 0; u < ninstances; u++){
+		if(instances[u].inst == inst){
+			return instances + u;
+		}
+	}
+
+	if(!create){
+		return NULL;
+	}
+
+	instances = memory_realloc(memory_core(memory_merge), instances, (ninstances + 1) * sizeof(merge_instance));
+	if(!instances){
+		fprintf(stderr, "Failed to allocate memory\n");
+		ninstances = 0;
+		return NULL;
+	}
+
+	memset(instances + ninstances, 0, sizeof(merge_instance));
+	instances[ninstances].inst = inst;
+	return instances + (ninstances++);
+}
+
+int merge_configure_instance(instance* inst, char* option, char* value){
+	merge_instance* settings = merge_instance_find(inst, 1);
+	if(!settings){
+		return 1;
+	}
+
+	if(!strcmp(option, "merge")){
+		return merge_parse_policy(value, &settings->policy);
+	}
+	else if(!strcmp(option, "priority")){
+		settings->priority = strtoul(value, NULL, 10);
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown core instance option %s\n", option);
+	return 1;
+}
+
+int merge_channel(channel* c, char* policy){
+	size_t alloc = policies_alloc;
+	merge_policy parsed;
+	uint8_t* new_policies = NULL;
+
+	if(merge_parse_policy(policy, &parsed)){
+		return 1;
+	}
+
+	if(!c->id){
+		fprintf(stderr, "Merge policies can not be applied to channels not managed by the core\n");
+		return 1;
+	}
+
+	if(c->id >= policies_alloc){
+		for(alloc = max(policies_alloc, 64); alloc <= c->id; alloc *= 2){
+		}
+
+		new_policies = memory_realloc(memory_core(memory_merge), policies, alloc * sizeof(uint8_t));
+		if(!new_policies){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		memset(new_policies + policies_alloc, 0, alloc - policies_alloc);
+		policies = new_policies;
+		policies_alloc = alloc;
+	}
+
+	//store with an offset so unset entries can be told apart from an explicit `none`
+	policies[c->id] = parsed + 1;
+	return 0;
+}
+
+static merge_policy merge_policy_find(channel* c){
+	merge_instance* settings = NULL;
+
+	if(c->id < policies_alloc && policies[c->id]){
+		return policies[c->id] - 1;
+	}
+
+	settings = merge_instance_find(c->instance, 0);
+	return settings ? settings->policy : merge_none;
+}
+
+int merge_enabled(channel* c){
+	return merge_policy_find(c) != merge_none;
+}
+
+/*
+ * Set up merge state for all mapping targets with a merge policy and
+ * annotate the mapping destinations with the input slot they feed.
+ */
+int merge_build(size_t mappings, channel_mapping* map){
+	size_t u, p, max_id = 0, input = 0;
+	size_t* index = NULL;
+	merge_instance* source = NULL;
+	merge_target* target = NULL;
+	int rv = 1;
+
+	for(u = 0; u < mappings; u++){
+		for(p = 0; p < map[u].destinations; p++){
+			max_id = max(max_id, map[u].to[p]->id);
+		}
+	}
+
+	//target index (+1) by channel id
+	index = calloc(max_id + 1, sizeof(size_t));
+	if(!index){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	//number the merged targets
+	for(u = 0; u < mappings; u++){
+		for(p = 0; p < map[u].destinations; p++){
+			if(map[u].to[p]->id && !index[map[u].to[p]->id] && merge_policy_find(map[u].to[p]) != merge_none){
+				index[map[u].to[p]->id] = ++ntargets;
+			}
+		}
+	}
+
+	if(!ntargets){
+		rv = 0;
+		goto bail;
+	}
+
+	targets = memory_calloc(memory_core(memory_merge), ntargets, sizeof(merge_target));
+	if(!targets){
+		fprintf(stderr, "Failed to allocate memory\n");
+		ntargets = 0;
+		goto bail;
+	}
+
+	//count the sources per target
+	for(u = 0; u < mappings; u++){
+		for(p = 0; p < map[u].destinations; p++){
+			if(!map[u].to[p]->id || !index[map[u].to[p]->id]){
+				continue;
+			}
+
+			target = targets + (index[map[u].to[p]->id] - 1);
+			if(!target->inputs){
+				target->policy = merge_policy_find(map[u].to[p]);
+				target->components = channel_components(map[u].to[p]);
+			}
+			target->inputs++;
+			ninputs++;
+		}
+	}
+
+	//lay out the input slots per target
+	for(u = 0; u < ntargets; u++){
+		targets[u].input = input;
+		input += targets[u].inputs;
+		targets[u].inputs = 0;
+	}
+
+	inputs = memory_calloc(memory_core(memory_merge), ninputs, sizeof(merge_input));
+	if(!inputs){
+		fprintf(stderr, "Failed to allocate memory\n");
+		goto bail;
+	}
+
+	//assign the slots to the mapping destinations
+	for(u = 0; u < mappings; u++){
+		source = merge_instance_find(map[u].from->instance, 0);
+		for(p = 0; p < map[u].destinations; p++){
+			if(!map[u].to[p]->id || !index[map[u].to[p]->id]){
+				continue;
+			}
+
+			if(!map[u].merge){
+				map[u].merge = memory_calloc(memory_core(memory_merge), map[u].destinations, sizeof(size_t));
+				if(!map[u].merge){
+					fprintf(stderr, "Failed to allocate memory\n");
+					goto bail;
+				}
+			}
+
+			target = targets + (index[map[u].to[p]->id] - 1);
+			input = target->input + target->inputs;
+			inputs[input].target = index[map[u].to[p]->id] - 1;
+			inputs[input].priority = source ? source->priority : 0;
+			target->inputs++;
+			map[u].merge[p] = input + 1;
+		}
+	}
+
+	fprintf(stderr, "Merging %" PRIsize_t " sources into %" PRIsize_t " channels\n", ninputs, ntargets);
+	rv = 0;
+bail:
+	free(index);
+	return rv;
+}
+
+/*
+ * Update a merge input with a new value and calculate the target value.
+ * Returns 0 if the merged value changed and should be output, 1 otherwise.
+ */
+int merge_apply(size_t slot, channel_value* v, channel_value* out){
+	merge_target* target = targets + inputs[slot].target;
+	merge_input* input = inputs + target->input;
+	channel_value result = *v;
+	size_t u, best = slot - target->input, valid = 0;
+	uint64_t raw = 0, component[MM_VECTOR_COMPONENTS] = {0};
+	uint8_t c;
+	double sum = 0.0;
+
+	inputs[slot].value = *v;
+	inputs[slot].sequence = ++sequence;
+
+	switch(target->policy){
+		case merge_htp:
+			if(target->components > 1){
+				//packed vector components are merged separately
+				for(u = 0; u < target->inputs; u++){
+					for(c = 0; input[u].sequence && c < target->components; c++){
+						result.raw.component[c] = max(result.raw.component[c], input[u].value.raw.component[c]);
+					}
+				}
+				result.normalised = result.raw.component[0] / 65535.0;
+				break;
+			}
+
+			for(u = 0; u < target->inputs; u++){
+				if(input[u].sequence && input[u].value.normalised > input[best].value.normalised){
+					best = u;
+				}
+			}
+			result = input[best].value;
+			break;
+		case merge_priority:
+			for(u = 0; u < target->inputs; u++){
+				//latest input wins between sources of equal priority
+				if(input[u].sequence
+						&& (input[u].priority > input[best].priority
+							|| (input[u].priority == input[best].priority && input[u].sequence > input[best].sequence))){
+					best = u;
+				}
+			}
+			result = input[best].value;
+			break;
+		case merge_average:
+			for(u = 0; u < target->inputs; u++){
+				if(input[u].sequence){
+					sum += input[u].value.normalised;
+					valid++;
+					if(target->components < 2){
+						raw += input[u].value.raw.u64;
+						continue;
+					}
+					for(c = 0; c < target->components; c++){
+						component[c] += input[u].value.raw.component[c];
+					}
+				}
+			}
+
+			if(target->components > 1){
+				//packed vector components are averaged separately
+				for(c = 0; c < target->components; c++){
+					result.raw.component[c] = (component[c] + valid / 2) / valid;
+				}
+				result.normalised = result.raw.component[0] / 65535.0;
+				break;
+			}
+
+			//inputs have been converted to the target resolution, so raw values share a common scale for targets declaring one
+			result.normalised = sum / valid;
+			result.raw.u64 = (raw + valid / 2) / valid;
+			break;
+		case merge_ltp:
+		case merge_none:
+			break;
+	}
+
+	//vector targets also change when only later components do
+	if(target->valid && target->output.normalised == result.normalised
+			&& (target->components < 2 || target->output.raw.u64 == result.raw.u64)){
+		return 1;
+	}
+
+	target->output = result;
+	target->valid = 1;
+	*out = result;
+	return 0;
+}
+
+void merge_free(){
+	memory_free(instances);
+	instances = NULL;
+	ninstances = 0;
+
+	memory_free(policies);
+	policies = NULL;
+	policies_alloc = 0;
+
+	memory_free(targets);
+	targets = NULL;
+	ntargets = 0;
+
+	memory_free(inputs);
+	inputs = NULL;
+	ninputs = 0;
+	sequence = 0;
+}
@@ -0,0 +1,7 @@
+/* Internal API */
+int merge_configure_instance(instance* inst, char* option, char* value);
+int merge_channel(channel* c, char* policy);
+int merge_enabled(channel* c);
+int merge_build(size_t mappings, channel_mapping* map);
+int merge_apply(size_t slot, channel_value* v, channel_value* out);
+void merge_free();
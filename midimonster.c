@@ -13,6 +13,9 @@
 #include "config.h"
 #include "backend.h"
 #include "plugin.h"
+#include "realtime.h"
+#include "merge.h"
+#include "trace.h"
 
 typedef struct /*_event_collection*/ {
 	size_t alloc;
@@ -21,18 +24,61 @@ typedef struct /*_event_collection*/ {
 	channel_value* value;
 } event_collection;
 
+/* Core value store entry, indexed by channel id */
+typedef struct /*_mm_channel_state*/ {
+	channel_value value;
+	uint64_t timestamp;
+} channel_state;
+
+/* Maximum number of mapping hops an event may travel within one core iteration */
+#define MM_DEFAULT_HOPS 32
+/* Maximum number of mapping cycles reported individually */
+#define MM_CYCLE_REPORTS 8
+
 static size_t mappings = 0;
+static size_t mappings_alloc = 0;
 static channel_mapping* map = NULL;
+/* Mapping index (+1) by channel id, 0 for channels without outgoing mappings */
+static size_t routes_alloc = 0;
+static size_t* route = NULL;
 static size_t fds = 0;
 static managed_fd* fd = NULL;
 static volatile sig_atomic_t fd_set_dirty = 1;
 static uint64_t global_timestamp = 0;
 
-static event_collection event_pool[2] = {
-	{0},
+static size_t max_hops = MM_DEFAULT_HOPS;
+static uint64_t events_dropped = 0;
+static uint64_t drop_warning = 0;
+
+static size_t states_alloc = 0;
+static channel_state* state[2] = {
+	NULL,
+	NULL
+};
+
+/* Double-buffered event queues per latency class */
+static event_collection event_pool[latency_classes][2] = {
+	{{0}}
+};
+static event_collection* primary[latency_classes] = {
+	event_pool[latency_realtime],
+	event_pool[latency_normal],
+	event_pool[latency_bulk]
+};
+/* Dispatch rounds per latency class within the current iteration */
+static size_t dispatch_hops[latency_classes] = {
+	0
+};
+
+/* Time from the start of an iteration to the delivery of events, per latency class */
+typedef struct /*_mm_latency_stats*/ {
+	uint64_t rounds;
+	uint64_t total;
+	uint64_t max;
+} latency_stats;
+static latency_stats dispatch_latency[latency_classes] = {
 	{0}
 };
-static event_collection* primary = event_pool;
 
 volatile static sig_atomic_t shutdown_requested = 0;
 
@@ -44,6 +90,19 @@ MM_API uint64_t mm_timestamp(){
 	return global_timestamp;
 }
 
+//monotonic clock in microseconds for latency measurements
+static uint64_t core_clock(){
+	#ifdef _WIN32
+	return ((uint64_t) GetTickCount()) * 1000;
+	#else
+	struct timespec current;
+	if(clock_gettime(CLOCK_MONOTONIC, &current)){
+		return 0;
+	}
+	return current.tv_sec * 1000000 + current.tv_nsec / 1000;
+	#endif
+}
+
 static void update_timestamp(){
 	#ifdef _WIN32
 	global_timestamp = GetTickCount();
@@ -58,22 +117,73 @@ static void update_timestamp(){
 	#endif
 }
 
-int mm_map_channel(channel* from, channel* to){
-	size_t u, m;
-	//find existing source mapping
+//find the mapping index for a source channel, returns `mappings` if the channel is not mapped
+static size_t route_find(channel* c){
+	size_t u;
+
+	if(c->id){
+		return (c->id < routes_alloc && route[c->id]) ? route[c->id] - 1 : mappings;
+	}
+
+	//channels not allocated via mm_channel are not indexed
 	for(u = 0; u < mappings; u++){
-		if(map[u].from == from){
+		if(map[u].from == c){
 			break;
 		}
 	}
+	return u;
+}
+
+static int route_add(channel* c, size_t index){
+	size_t alloc = routes_alloc;
+	size_t* new_route = NULL;
+
+	if(!c->id){
+		return 0;
+	}
+
+	if(c->id >= routes_alloc){
+		for(alloc = max(routes_alloc, 64); alloc <= c->id; alloc *= 2){
+		}
+
+		new_route = memory_realloc(memory_core(memory_routing), route, alloc * sizeof(size_t));
+		if(!new_route){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		memset(new_route + routes_alloc, 0, (alloc - routes_alloc) * sizeof(size_t));
+		route = new_route;
+		routes_alloc = alloc;
+	}
+
+	route[c->id] = index + 1;
+	return 0;
+}
+
+int mm_map_channel(channel* from, channel* to){
+	size_t u, m;
+	channel_mapping* new_map = NULL;
+	channel** new_to = NULL;
+
+	//find existing source mapping
+	u = route_find(from);
 
 	//create new entry
 	if(u == mappings){
-		map = realloc(map, (mappings + 1) * sizeof(channel_mapping));
-		if(!map){
-			fprintf(stderr, "Failed to allocate memory\n");
+		if(route_add(from, mappings)){
 			return 1;
 		}
+
+		//grow the mapping table geometrically
+		if(mappings == mappings_alloc){
+			new_map = memory_realloc(memory_core(memory_routing), map, (mappings_alloc ? mappings_alloc * 2 : 16) * sizeof(channel_mapping));
+			if(!new_map){
+				fprintf(stderr, "Failed to allocate memory\n");
+				return 1;
+			}
+			map = new_map;
+			mappings_alloc = mappings_alloc ? mappings_alloc * 2 : 16;
+		}
 		memset(map + mappings, 0, sizeof(channel_mapping));
 		mappings++;
 		map[u].from = from;
@@ -86,11 +196,14 @@ int mm_map_channel(channel* from, channel* to){
 		}
 	}
 
-	map[u].to = realloc(map[u].to, (map[u].destinations + 1) * sizeof(channel*));
-	if(!map[u].to){
-		fprintf(stderr, "Failed to allocate memory\n");
-		map[u].destinations = 0;
-		return 1;
+	if(map[u].destinations == map[u].alloc){
+		new_to = memory_realloc(memory_core(memory_routing), map[u].to, (map[u].alloc ? map[u].alloc * 2 : 4) * sizeof(channel*));
+		if(!new_to){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		map[u].to = new_to;
+		map[u].alloc = map[u].alloc ? map[u].alloc * 2 : 4;
 	}
 
 	map[u].to[map[u].destinations] = to;
@@ -101,11 +214,274 @@ int mm_map_channel(channel* from, channel* to){
 static void map_free(){
 	size_t u;
 	for(u = 0; u < mappings; u++){
-		free(map[u].to);
+		memory_free(map[u].to);
+		memory_free(map[u].via);
+		memory_free(map[u].merge);
+		memory_free(map[u].convert);
 	}
-	free(map);
-	mappings = 0;
+	memory_free(map);
+	mappings = mappings_alloc = 0;
 	map = NULL;
+
+	memory_free(route);
+	routes_alloc = 0;
+	route = NULL;
+}
+
+static void map_cycle_report(size_t* stack, size_t depth, size_t target){
+	size_t u;
+
+	//find the start of the cycle on the current search path
+	for(u = 0; u < depth && stack[2 * u] != target; u++){
+	}
+
+	fprintf(stderr, "Mapping cycle detected: ");
+	for(; u < depth; u++){
+		fprintf(stderr, "%s:%" PRIu64 " -> ", map[stack[2 * u]].from->instance->name, map[stack[2 * u]].from->ident);
+	}
+	fprintf(stderr, "%s:%" PRIu64 "\n", map[target].from->instance->name, map[target].from->ident);
+}
+
+/*
+ * Find cycles in the mapping graph. Events sent to channels of passthrough
+ * backends re-enter the core as input events on the same channel, so such
+ * channels connect their incoming mappings to their outgoing ones.
+ */
+static int map_check_cycles(){
+	size_t u, next, depth = 0, cycles = 0;
+	uint8_t* visited = NULL;
+	size_t* stack = NULL;
+	channel* target = NULL;
+
+	if(!mappings){
+		return 0;
+	}
+
+	//0 - unvisited, 1 - on the current search path, 2 - done
+	visited = calloc(mappings, sizeof(uint8_t));
+	//pairs of mapping index and next destination to inspect
+	stack = calloc(2 * mappings, sizeof(size_t));
+	if(!visited || !stack){
+		fprintf(stderr, "Failed to allocate memory\n");
+		free(visited);
+		free(stack);
+		return 1;
+	}
+
+	for(u = 0; u < mappings; u++){
+		if(visited[u]){
+			continue;
+		}
+
+		visited[u] = 1;
+		stack[0] = u;
+		stack[1] = 0;
+		depth = 1;
+
+		while(depth){
+			if(stack[2 * depth - 1] == map[stack[2 * depth - 2]].destinations){
+				//all destinations inspected
+				visited[stack[2 * depth - 2]] = 2;
+				depth--;
+				continue;
+			}
+
+			target = map[stack[2 * depth - 2]].to[stack[2 * depth - 1]];
+			stack[2 * depth - 1]++;
+			if(!target->instance->backend->passthrough){
+				continue;
+			}
+
+			next = route_find(target);
+			if(next == mappings || visited[next] == 2){
+				continue;
+			}
+
+			if(visited[next] == 1){
+				if(cycles < MM_CYCLE_REPORTS){
+					map_cycle_report(stack, depth, next);
+				}
+				cycles++;
+				continue;
+			}
+
+			visited[next] = 1;
+			stack[2 * depth] = next;
+			stack[2 * depth + 1] = 0;
+			depth++;
+		}
+	}
+
+	if(cycles){
+		fprintf(stderr, "Detected %" PRIu64 " mapping cycles, events in a cycle will be routed to each of its channels once\n", (uint64_t) cycles);
+	}
+
+	free(visited);
+	free(stack);
+	return 0;
+}
+
+static int map_append(channel*** list, size_t* n, channel* c){
+	channel** new_list = memory_realloc(memory_core(memory_routing), *list, (*n + 1) * sizeof(channel*));
+	if(!new_list){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+	new_list[*n] = c;
+	*list = new_list;
+	(*n)++;
+	return 0;
+}
+
+//mark the destinations of each route whose values need to be converted for the target channel
+static int map_conversions(){
+	size_t u, p;
+
+	for(u = 0; u < mappings; u++){
+		memory_free(map[u].convert);
+		map[u].convert = NULL;
+
+		for(p = 0; p < map[u].destinations; p++){
+			if(!channel_needs_conversion(map[u].from, map[u].to[p])){
+				continue;
+			}
+
+			if(!map[u].convert){
+				map[u].convert = memory_calloc(memory_core(memory_routing), map[u].destinations, sizeof(uint8_t));
+				if(!map[u].convert){
+					fprintf(stderr, "Failed to allocate memory\n");
+					return 1;
+				}
+			}
+			map[u].convert[p] = 1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Resolve mappings through passthrough channels into direct routes, so events
+ * are delivered to all transitively mapped channels within a single dispatch round.
+ * The passthrough channels passed on the way are stored separately for the value store.
+ */
+static int map_compile(){
+	size_t u, p, v, top, next, max_id = 0, count = 0;
+	size_t* seen = NULL, *expanded = NULL, *stack = NULL;
+	channel_mapping* compiled = NULL;
+	channel* target = NULL;
+	int rv = 1;
+
+	for(u = 0; u < mappings; u++){
+		max_id = max(max_id, map[u].from->id);
+		for(p = 0; p < map[u].destinations; p++){
+			max_id = max(max_id, map[u].to[p]->id);
+		}
+	}
+
+	//channel and mapping visit markers are stamped with the source mapping index + 1
+	seen = calloc(max_id + 1, sizeof(size_t));
+	expanded = calloc(mappings + 1, sizeof(size_t));
+	stack = calloc(mappings + 1, sizeof(size_t));
+	compiled = calloc(mappings + 1, sizeof(channel_mapping));
+	if(!seen || !expanded || !stack || !compiled){
+		fprintf(stderr, "Failed to allocate memory\n");
+		goto bail;
+	}
+
+	for(u = 0; u < mappings; u++){
+		expanded[u] = u + 1;
+		stack[0] = u;
+		top = 1;
+
+		while(top){
+			v = stack[--top];
+			for(p = 0; p < map[v].destinations; p++){
+				target = map[v].to[p];
+
+				//deliver each channel only once per source event
+				if(target->id){
+					if(seen[target->id] == u + 1){
+						continue;
+					}
+					seen[target->id] = u + 1;
+				}
+
+				//merged passthrough channels are delivered to their backend, which re-emits the merged value
+				if(!target->instance->backend->passthrough || merge_enabled(target)){
+					if(map_append(&compiled[u].to, &compiled[u].destinations, target)){
+						goto bail;
+					}
+					continue;
+				}
+
+				if(map_append(&compiled[u].via, &compiled[u].passthrough, target)){
+					goto bail;
+				}
+
+				//continue along the mappings of the passthrough channel
+				next = route_find(target);
+				if(next != mappings && expanded[next] != u + 1){
+					expanded[next] = u + 1;
+					stack[top++] = next;
+				}
+			}
+		}
+	}
+
+	for(u = 0; u < mappings; u++){
+		count += compiled[u].passthrough;
+		memory_free(map[u].to);
+		map[u].to = compiled[u].to;
+		map[u].destinations = map[u].alloc = compiled[u].destinations;
+		map[u].via = compiled[u].via;
+		map[u].passthrough = compiled[u].passthrough;
+		map[u].latency = channel_latency(map[u].from);
+		compiled[u].to = compiled[u].via = NULL;
+	}
+
+	if(count){
+		DBGPF("Resolved %" PRIsize_t " routes through passthrough channels\n", count);
+	}
+
+	if(map_conversions()){
+		goto bail;
+	}
+	rv = 0;
+bail:
+	if(compiled){
+		for(u = 0; u < mappings; u++){
+			memory_free(compiled[u].to);
+			memory_free(compiled[u].via);
+		}
+	}
+	free(compiled);
+	free(stack);
+	free(expanded);
+	free(seen);
+	return rv;
+}
+
+int mm_core_configure(char* option, char* value){
+	if(!strcmp(option, "max-hops")){
+		max_hops = strtoul(value, NULL, 10);
+		if(!max_hops){
+			fprintf(stderr, "The max-hops option requires a positive value\n");
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strncmp(option, "trace", 5)){
+		return trace_configure(option, value);
+	}
+
+	return realtime_configure(option, value);
+}
+
+int mm_core_instance_configure(instance* inst, char* option, char* value){
+	if(!strcmp(option, "budget") || !strcmp(option, "overload") || !strcmp(option, "latency")){
+		return instance_configure(inst, option, value);
+	}
+	return merge_configure_instance(inst, option, value);
 }
 
 MM_API int mm_manage_fd(int new_fd, char* back, int manage, void* impl){
@@ -172,55 +548,258 @@ static void fds_free(){
 	fd = NULL;
 }
 
-MM_API int mm_channel_event(channel* c, channel_value v){
-	size_t u, p;
+static int value_reserve(size_t id){
+	size_t u, alloc = states_alloc;
+	channel_state* new_state = NULL;
 
-	//find mapped channels
-	for(u = 0; u < mappings; u++){
-		if(map[u].from == c){
-			break;
+	//grow the store to cover channels created since the last update
+	if(id >= states_alloc){
+		for(alloc = max(states_alloc, 64); alloc <= id; alloc *= 2){
 		}
+
+		for(u = 0; u < sizeof(state) / sizeof(channel_state*); u++){
+			new_state = memory_realloc(memory_core(memory_values), state[u], alloc * sizeof(channel_state));
+			if(!new_state){
+				fprintf(stderr, "Failed to allocate memory\n");
+				return 1;
+			}
+			memset(new_state + states_alloc, 0, (alloc - states_alloc) * sizeof(channel_state));
+			state[u] = new_state;
+		}
+		states_alloc = alloc;
+	}
+	return 0;
+}
+
+static int value_store(channel* c, channel_direction direction, channel_value* v){
+	if(!c->id){
+		return 0;
 	}
 
+	if(value_reserve(c->id)){
+		return 1;
+	}
+
+	state[direction][c->id].value = *v;
+	state[direction][c->id].timestamp = global_timestamp;
+	return 0;
+}
+
+static void value_free(){
+	size_t u;
+	for(u = 0; u < sizeof(state) / sizeof(channel_state*); u++){
+		memory_free(state[u]);
+		state[u] = NULL;
+	}
+	states_alloc = 0;
+}
+
+MM_API int mm_channel_value(channel* c, channel_direction direction, channel_value* value, uint64_t* timestamp){
+	//timestamps are never 0 after the first core iteration, so they double as validity marker
+	if(!c || !c->id || c->id >= states_alloc || direction > mm_direction_output
+			|| !state[direction][c->id].timestamp){
+		return 1;
+	}
+
+	if(value){
+		*value = state[direction][c->id].value;
+	}
+	if(timestamp){
+		*timestamp = state[direction][c->id].timestamp;
+	}
+	return 0;
+}
+
+static int event_reserve(event_collection* pool, size_t n){
+	size_t alloc;
+
+	if(n >= pool->alloc){
+		alloc = max(pool->alloc * 2, n + 1);
+		pool->channel = memory_realloc(memory_core(memory_events), pool->channel, alloc * sizeof(channel*));
+		pool->value = memory_realloc(memory_core(memory_events), pool->value, alloc * sizeof(channel_value));
+
+		if(!pool->channel || !pool->value){
+			fprintf(stderr, "Failed to allocate memory\n");
+			pool->alloc = 0;
+			pool->n = 0;
+			return 1;
+		}
+
+		pool->alloc = alloc;
+	}
+	return 0;
+}
+
+MM_API int mm_channel_event(channel* c, channel_value v){
+	size_t u, p;
+	uint64_t normalised;
+	event_collection* queue = NULL;
+	channel_value converted;
+
+	//record the normalised value bit-for-bit for the trace decoder
+	memcpy(&normalised, &v.normalised, sizeof(normalised));
+	mm_trace(mm_trace_event, c->id, normalised);
+	if(value_store(c, mm_direction_input, &v)){
+		return 1;
+	}
+
+	//find mapped channels
+	u = route_find(c);
 	if(u == mappings){
 		//target-only channel
 		return 0;
 	}
 
 	//resize event structures to fit additional events
-	if(primary->n + map[u].destinations >= primary->alloc){
-		primary->channel = realloc(primary->channel, (primary->alloc + map[u].destinations) * sizeof(channel*));
-		primary->value = realloc(primary->value, (primary->alloc + map[u].destinations) * sizeof(channel_value));
+	queue = primary[map[u].latency];
+	if(event_reserve(queue, queue->n + map[u].destinations)){
+		return 1;
+	}
 
-		if(!primary->channel || !primary->value){
-			fprintf(stderr, "Failed to allocate memory\n");
-			primary->alloc = 0;
-			primary->n = 0;
+	//record values for passthrough channels routed through
+	for(p = 0; p < map[u].passthrough; p++){
+		if(value_store(map[u].via[p], mm_direction_output, &v)
+				|| value_store(map[u].via[p], mm_direction_input, &v)){
 			return 1;
 		}
-
-		primary->alloc += map[u].destinations;
 	}
 
 	//enqueue channel events
 	//FIXME this might lead to one channel being mentioned multiple times in an apply call
 	for(p = 0; p < map[u].destinations; p++){
-		primary->channel[primary->n + p] = map[u].to[p];
-		primary->value[primary->n + p] = v;
-	}
+		converted = v;
+		if(map[u].convert && map[u].convert[p]){
+			channel_convert(c, map[u].to[p], &converted);
+		}
 
-	primary->n += map[u].destinations;
+		if(map[u].merge && map[u].merge[p]){
+			//merged targets are only output when their merged value changes
+			if(merge_apply(map[u].merge[p] - 1, &converted, queue->value + queue->n)){
+				continue;
+			}
+		}
+		else{
+			queue->value[queue->n] = converted;
+		}
+		queue->channel[queue->n] = map[u].to[p];
+		queue->n++;
+	}
 	return 0;
 }
 
 static void event_free(){
+	size_t u, p;
+
+	for(u = 0; u < latency_classes; u++){
+		for(p = 0; p < 2; p++){
+			memory_free(event_pool[u][p].channel);
+			memory_free(event_pool[u][p].value);
+			event_pool[u][p].alloc = 0;
+		}
+	}
+}
+
+//deliver the queued events of all latency classes up to `limit`, most urgent class first
+static int core_dispatch(latency_class limit, uint64_t start){
+	event_collection* secondary = NULL;
+	latency_class class = latency_realtime;
+	uint64_t delay;
+	size_t u, hops;
+
+	while(class <= limit){
+		if(!primary[class]->n){
+			class++;
+			continue;
+		}
+
+		//swap primary and secondary event collectors
+		DBGPF("Swapping event collectors, %lu events in primary\n", primary[class]->n);
+		secondary = primary[class];
+		primary[class] = (secondary == event_pool[class]) ? event_pool[class] + 1 : event_pool[class];
+		hops = dispatch_hops[class]++;
+
+		//drop events caught in a mapping loop
+		if(hops >= max_hops){
+			events_dropped += secondary->n;
+			if(global_timestamp - drop_warning > 1000){
+				fprintf(stderr, "Dropped %" PRIu64 " events exceeding %" PRIsize_t " mapping hops so far, check the configuration for mapping loops\n", events_dropped, max_hops);
+				drop_warning = global_timestamp;
+			}
+			secondary->n = 0;
+			continue;
+		}
+
+		//update the output value store
+		for(u = 0; u < secondary->n; u++){
+			if(value_store(secondary->channel[u], mm_direction_output, secondary->value + u)){
+				return 1;
+			}
+		}
+
+		//push collected events to target backends
+		mm_trace(mm_trace_dispatch, hops, secondary->n);
+		if(backends_notify(secondary->n, secondary->channel, secondary->value)){
+			fprintf(stderr, "Backends failed to handle output\n");
+			return 1;
+		}
+
+		//reset the event count
+		secondary->n = 0;
+
+		delay = core_clock() - start;
+		dispatch_latency[class].rounds++;
+		dispatch_latency[class].total += delay;
+		dispatch_latency[class].max = max(dispatch_latency[class].max, delay);
+
+		//handling the events may have generated events for a more urgent class
+		class = latency_realtime;
+	}
+	return 0;
+}
+
+static void latency_report(){
 	size_t u;
 
-	for(u = 0; u < sizeof(event_pool) / sizeof(event_collection); u++){
-		free(event_pool[u].channel);
-		free(event_pool[u].value);
-		event_pool[u].alloc = 0;
+	fprintf(stderr, "\t%-32s %12s %12s %12s\n", "Latency class", "Rounds", "Average (us)", "Max (us)");
+	for(u = 0; u < latency_classes; u++){
+		if(dispatch_latency[u].rounds){
+			fprintf(stderr, "\t%-32s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 "\n", latency_name(u),
+					dispatch_latency[u].rounds,
+					dispatch_latency[u].total / dispatch_latency[u].rounds,
+					dispatch_latency[u].max);
+		}
+	}
+}
+
+//preallocate and touch the event and value buffers so the main loop does not fault on them in realtime mode
+static int core_prefault(){
+	size_t u, p, max_id = 0;
+	size_t events[latency_classes] = {
+		0
+	};
+
+	for(u = 0; u < mappings; u++){
+		events[map[u].latency] += map[u].destinations;
+		max_id = max(max_id, map[u].from->id);
+		for(p = 0; p < map[u].destinations; p++){
+			max_id = max(max_id, map[u].to[p]->id);
+		}
+		for(p = 0; p < map[u].passthrough; p++){
+			max_id = max(max_id, map[u].via[p]->id);
+		}
 	}
+
+	for(u = 0; u < latency_classes; u++){
+		for(p = 0; p < 2; p++){
+			if(event_reserve(event_pool[u] + p, max(events[u], 64))){
+				return 1;
+			}
+			memset(event_pool[u][p].channel, 0, event_pool[u][p].alloc * sizeof(channel*));
+			memset(event_pool[u][p].value, 0, event_pool[u][p].alloc * sizeof(channel_value));
+		}
+	}
+
+	return value_reserve(max_id);
 }
 
 static int usage(char* fn){
@@ -265,9 +844,10 @@ static int platform_initialize(){
 
 int main(int argc, char** argv){
 	fd_set all_fds, read_fds;
-	event_collection* secondary = NULL;
 	struct timeval tv;
 	size_t u, n;
+	uint64_t start;
+	latency_class class;
 	managed_fd* signaled_fds = NULL;
 	int rv = EXIT_FAILURE, error, maxfd = -1;
 	char* cfg_file = DEFAULT_CFG;
@@ -294,11 +874,17 @@ int main(int argc, char** argv){
 		channels_free();
 		instances_free();
 		map_free();
+		merge_free();
 		fds_free();
 		plugins_close();
 		return usage(argv[0]);
 	}
 	
+	//analyze the mapping graph and resolve passthrough routes
+	if(map_check_cycles() || map_compile() || merge_build(mappings, map)){
+		goto bail;
+	}
+
 	//load an initial timestamp
 	update_timestamp();
 
@@ -307,6 +893,14 @@ int main(int argc, char** argv){
 		goto bail;
 	}
 
+	//apply realtime options
+	if(realtime_memlock() && core_prefault()){
+		goto bail;
+	}
+	if(realtime_start() || trace_start()){
+		goto bail;
+	}
+
 	signal(SIGINT, signal_handler);
 
 	//process events
@@ -327,8 +921,12 @@ int main(int argc, char** argv){
 		tv = backend_timeout();
 		error = select(maxfd + 1, &read_fds, NULL, NULL, &tv);
 		if(error < 0){
-			fprintf(stderr, "select failed: %s\n", strerror(errno));
-			break;
+			if(errno != EINTR){
+				fprintf(stderr, "select failed: %s\n", strerror(errno));
+				break;
+			}
+			//interrupted by a signal, the descriptor set is undefined
+			FD_ZERO(&read_fds);
 		}
 
 		//find all signaled fds
@@ -336,43 +934,50 @@ int main(int argc, char** argv){
 		for(u = 0; u < fds; u++){
 			if(fd[u].fd >= 0 && FD_ISSET(fd[u].fd, &read_fds)){
 				signaled_fds[n] = fd[u];
+				mm_trace(mm_trace_fd_ready, fd[u].fd, 0);
 				n++;
 			}
 		}
 
 		//update this iteration's timestamp
 		update_timestamp();
+		start = core_clock();
+		memset(dispatch_hops, 0, sizeof(dispatch_hops));
 
-		//run backend processing, collect events
-		DBGPF("%lu backend FDs signaled\n", n);
-		if(backends_handle(n, signaled_fds)){
+		//deliver events deferred by overloaded instances in the previous round
+		if(backends_deferred() && backends_notify(0, NULL, NULL)){
 			goto bail;
 		}
 
-		while(primary->n){
-			//swap primary and secondary event collectors
-			DBGPF("Swapping event collectors, %lu events in primary\n", primary->n);
-			for(u = 0; u < sizeof(event_pool) / sizeof(event_collection); u++){
-				if(primary != event_pool + u){
-					secondary = primary;
-					primary = event_pool + u;
-					break;
-				}
-			}
-
-			//push collected events to target backends
-			if(secondary->n && backends_notify(secondary->n, secondary->channel, secondary->value)){
-				fprintf(stderr, "Backends failed to handle output\n");
+		//run backend processing and deliver the collected events, most urgent class first
+		DBGPF("%lu backend FDs signaled\n", n);
+		for(class = latency_realtime; class < latency_classes; class++){
+			if(backends_handle(n, signaled_fds, class)
+					|| core_dispatch(class, start)){
 				goto bail;
 			}
+		}
 
-			//reset the event count
-			secondary->n = 0;
+		//write the trace and memory statistics if requested
+		if(trace_poll()){
+			memory_report();
+			backends_memory_report();
+			latency_report();
 		}
 	}
 
 	rv = EXIT_SUCCESS;
 bail:
+	if(events_dropped){
+		fprintf(stderr, "%" PRIu64 " events were dropped for exceeding %" PRIsize_t " mapping hops\n", events_dropped, max_hops);
+	}
+
+	//per-class latencies are only of interest when classes are in use
+	if(dispatch_latency[latency_realtime].rounds || dispatch_latency[latency_bulk].rounds){
+		latency_report();
+	}
+
+
 	//free all data
 	free(signaled_fds);
 	backends_stop();
@@ -381,7 +986,11 @@ bail:
 	map_free();
 	fds_free();
 	event_free();
+	value_free();
+	merge_free();
 	plugins_close();
+	trace_stop();
+	realtime_stop();
 
 	return rv;
 }
@@ -81,6 +81,11 @@ struct _managed_fd;
  * 		or to update runtime-specific data in the various data structures.
  * 		Returning a non-zero value signals an error starting the backend
  * 		and stops further progress.
+ * 		Backends are started sequentially, so this call should not block
+ * 		waiting for remote peers. Connections to external hardware or daemons
+ * 		should be established asynchronously (e.g. via nonblocking sockets),
+ * 		with affected instances going live once the connection completes.
+ * 		The time taken by each backend to start is reported by the core.
  * 	* Normal processing loop starts here
  * 		* mmbackend_process_fd
  * 			Handle data from signaled fds registered via mm_manage_fd.
@@ -115,11 +120,20 @@ typedef int (*mmbackend_start)();
 typedef uint32_t (*mmbackend_interval)();
 typedef int (*mmbackend_shutdown)();
 
-/* Channel event value, .normalised is used by backends to determine channel values */
+/* Maximum number of components carried by a vector channel */
+#define MM_VECTOR_COMPONENTS 4
+
+/*
+ * Channel event value, .normalised is used by backends to determine channel values
+ * Events on vector channels (see mm_channel_components) carry all components
+ * as 16-bit fixed-point values in .raw.component, with .normalised set to
+ * the value of the first component.
+ */
 typedef struct _channel_value {
 	union {
 		double dbl;
 		uint64_t u64;
+		uint16_t component[MM_VECTOR_COMPONENTS];
 	} raw;
 	double normalised;
 } channel_value;
@@ -127,6 +141,13 @@ typedef struct _channel_value {
 /* 
  * Backend callback structure
  * Used to register a backend with the core using mm_backend_register()
+ * Backends that re-emit every event they receive for output as an input event
+ * on the same channel (such as the loopback backend) should set `passthrough`.
+ * The core then resolves mappings through their channels into direct routes
+ * when the configuration is loaded and only records the values passing through
+ * in the value store. Events routed this way are not passed to the backend,
+ * except for channels with a merge policy, which are delivered to the backend
+ * to be re-emitted with the merged value.
  */
 typedef struct /*_mm_backend*/ {
 	char* name;
@@ -140,6 +161,7 @@ typedef struct /*_mm_backend*/ {
 	mmbackend_shutdown shutdown;
 	mmbackend_free_channel channel_free;
 	mmbackend_interval interval;
+	uint8_t passthrough;
 } backend;
 
 /* 
@@ -180,13 +202,25 @@ typedef struct /*_mm_channel_spec*/ {
  * Instance channel structure
  * Backends may either manage their own channel registry
  * or use the memory returned by mm_channel()
+ * The `id` member is assigned by the core for channels returned
+ * by mm_channel() and must not be modified by backends. Channels
+ * from other sources should set it to 0.
+ * The `ident` member of channels returned by mm_channel() may only
+ * be changed by backends until their start() call returns.
  */
 typedef struct _backend_channel {
 	instance* instance;
 	uint64_t ident;
 	void* impl;
+	size_t id;
 } channel;
 
+/* Value directions tracked by the core value store */
+typedef enum /*_mm_channel_direction*/ {
+	mm_direction_input = 0,
+	mm_direction_output
+} channel_direction;
+
 /*
  * File descriptor management structure
  * Register for the core event loop using mm_manage_fd()
@@ -201,7 +235,17 @@ typedef struct _managed_fd {
 typedef struct /*_mm_channel_mapping*/ {
 	channel* from;
 	size_t destinations;
+	size_t alloc;
 	channel** to;
+	/* Passthrough channels routed through, only tracked in the value store */
+	size_t passthrough;
+	channel** via;
+	/* Merge input slot (+1) per destination, NULL if no destination is merged */
+	size_t* merge;
+	/* Latency class of events routed through this mapping */
+	uint8_t latency;
+	/* Nonzero per destination requiring a value conversion, NULL if no destination does */
+	uint8_t* convert;
 } channel_mapping;
 
 /*
@@ -247,6 +291,29 @@ MM_API instance* mm_instance_find(char* backend, uint64_t ident);
  * function.
  */
 MM_API channel* mm_channel(instance* i, uint64_t ident, uint8_t create);
+
+/*
+ * Declare a channel allocated via mm_channel() as a vector channel carrying
+ * `components` values (up to MM_VECTOR_COMPONENTS) per event, such as the
+ * color components of a pixel. Events on vector channels are transported
+ * as one event, and converted by the core when mapped to channels with
+ * a different number of components (scalar values are applied to all
+ * components, scalar targets receive the first component).
+ * Returns 0 on success.
+ */
+MM_API int mm_channel_components(channel* c, uint8_t components);
+
+/*
+ * Declare the native resolution of a channel allocated via mm_channel(),
+ * for backends using unsigned integer values of `bits` bits (up to 32).
+ * Events generated on the channel must then carry the integer value in
+ * .raw.u64, and events delivered to the channel are guaranteed to carry
+ * the value in the declared resolution in .raw.u64. Values are passed
+ * between channels of the same resolution without conversion and are only
+ * converted from the normalised value when the resolutions differ.
+ * Returns 0 on success.
+ */
+MM_API int mm_channel_resolution(channel* c, uint8_t bits);
 //TODO channel* mm_channel_find()
 
 /*
@@ -262,6 +329,18 @@ MM_API int mm_manage_fd(int fd, char* backend, int manage, void* impl);
  */
 MM_API int mm_channel_event(channel* c, channel_value v);
 
+/*
+ * Query the last value seen by the core for a channel.
+ * The input direction stores the last event generated by the
+ * channel's instance via mm_channel_event, the output direction
+ * stores the last value delivered to the instance for output.
+ * If `timestamp` is not NULL, it receives the mm_timestamp() value
+ * of the update.
+ * Returns 0 if a value is known, 1 otherwise (no value seen yet or
+ * channel not allocated via mm_channel).
+ */
+MM_API int mm_channel_value(channel* c, channel_direction direction, channel_value* value, uint64_t* timestamp);
+
 /*
  * Query all active instances for a given backend.
  * *i will need to be freed by the caller.
@@ -275,9 +354,73 @@ MM_API int mm_backend_instances(char* backend, size_t* n, instance*** i);
  */
 MM_API uint64_t mm_timestamp();
 
+/*
+ * Apply the CPU affinity configured with the `backend-cpus` option
+ * of the `[core]` section to the calling thread.
+ * Backends running their own processing threads should call this
+ * from within those threads. Does nothing if no affinity was configured.
+ * Returns 0 on success.
+ */
+MM_API int mm_thread_affinity();
+
+/* Tracepoints recorded by the core event tracer */
+typedef enum /*_mm_trace_point*/ {
+	mm_trace_fd_ready = 1,
+	mm_trace_process_enter,
+	mm_trace_process_exit,
+	mm_trace_event,
+	mm_trace_dispatch,
+	mm_trace_handle_enter,
+	mm_trace_handle_exit,
+	mm_trace_transmit
+} trace_point;
+
+/*
+ * Record a tracepoint in the event trace of the calling thread.
+ * Returns immediately while tracing is disabled, and never blocks
+ * or allocates memory except on the first record of a thread.
+ * Backends should mark their output with mm_trace_transmit, passing
+ * the descriptor written to as `id` and the number of bytes as `arg`.
+ */
+MM_API void mm_trace(trace_point point, uint64_t id, uint64_t arg);
+
+/*
+ * Accounted memory allocation. Memory allocated while the core calls
+ * into a backend is charged to the instance or backend being called,
+ * and reported in the statistics output. Allocations made in threads
+ * created by a backend are reported as unattributed. Memory obtained
+ * from these functions must only be released or resized with
+ * mm_free / mm_realloc, but may be released from any context.
+ */
+MM_API void* mm_calloc(size_t n, size_t size);
+MM_API void* mm_realloc(void* ptr, size_t size);
+MM_API char* mm_strdup(char* s);
+MM_API void mm_free(void* ptr);
+
+/*
+ * Report the amount of memory managed by an instance outside of
+ * the accounted allocator (e.g. by an embedded interpreter).
+ * Each call replaces the previously reported value.
+ */
+MM_API void mm_memory_external(instance* inst, size_t bytes);
+
 /*
  * Create a channel-to-channel mapping. This API should not
  * be used by backends. It is only exported for core modules.
  */
 int mm_map_channel(channel* from, channel* to);
+
+/*
+ * Set a core configuration option from the `[core]` section.
+ * This API should not be used by backends. It is only exported
+ * for core modules.
+ */
+int mm_core_configure(char* option, char* value);
+
+/*
+ * Set a core option for an instance, specified as `core.<option>` in the
+ * instance configuration section. This API should not be used by backends.
+ * It is only exported for core modules.
+ */
+int mm_core_instance_configure(instance* inst, char* option, char* value);
 #endif
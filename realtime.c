@@ -0,0 +1,277 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <malloc.h>
+#endif
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#define MM_API __attribute__((visibility("default")))
+#else
+#define MM_API __attribute__((dllexport))
+#endif
+#include "midimonster.h"
+#include "realtime.h"
+
+/* Amount of stack to touch before locking memory, so the main loop does not fault on stack growth */
+#define REALTIME_STACK_PREFAULT (256 * 1024)
+#define REALTIME_PAGE 4096
+
+static struct /*_mm_realtime_config*/ {
+	uint8_t configured;
+	uint8_t memlock;
+	uint8_t locked;
+	int policy;
+	int priority;
+	#ifdef __linux__
+	uint8_t cpus_set;
+	cpu_set_t cpus;
+	uint8_t backend_cpus_set;
+	cpu_set_t backend_cpus;
+	#endif
+} rt_config = {
+	.policy = -1
+};
+
+#ifdef __linux__
+static int realtime_parse_cpus(char* spec, cpu_set_t* set){
+	char* next = spec;
+	unsigned long first, last;
+
+	CPU_ZERO(set);
+	while(*next){
+		first = last = strtoul(next, &next, 10);
+		if(*next == '-'){
+			last = strtoul(next + 1, &next, 10);
+		}
+
+		if(last < first || last >= CPU_SETSIZE){
+			fprintf(stderr, "Invalid CPU range in set %s\n", spec);
+			return 1;
+		}
+
+		for(; first <= last; first++){
+			CPU_SET(first, set);
+		}
+
+		if(*next == ','){
+			next++;
+		}
+		else if(*next){
+			fprintf(stderr, "Invalid CPU set specification %s\n", spec);
+			return 1;
+		}
+	}
+
+	if(!CPU_COUNT(set)){
+		fprintf(stderr, "Empty CPU set specified\n");
+		return 1;
+	}
+	return 0;
+}
+
+static void realtime_print_cpus(char* prefix, cpu_set_t* set){
+	size_t u, n = 0;
+	fprintf(stderr, "%s", prefix);
+	for(u = 0; u < CPU_SETSIZE; u++){
+		if(CPU_ISSET(u, set)){
+			fprintf(stderr, "%s%" PRIsize_t, n++ ? "," : "", u);
+		}
+	}
+	fprintf(stderr, "\n");
+}
+#endif
+
+int realtime_configure(char* option, char* value){
+	char* token = value;
+	rt_config.configured = 1;
+
+	#ifdef _WIN32
+	fprintf(stderr, "Realtime option %s is not supported on this platform\n", option);
+	return 1;
+	#else
+	if(!strcmp(option, "memlock")){
+		rt_config.memlock = strcmp(value, "on") ? 0 : 1;
+		return 0;
+	}
+	else if(!strcmp(option, "scheduler")){
+		token = strchr(value, ' ');
+		if(token){
+			*token = 0;
+			rt_config.priority = strtoul(token + 1, NULL, 10);
+		}
+
+		if(!strcmp(value, "fifo")){
+			rt_config.policy = SCHED_FIFO;
+		}
+		else if(!strcmp(value, "rr")){
+			rt_config.policy = SCHED_RR;
+		}
+		else if(!strcmp(value, "other")){
+			rt_config.policy = SCHED_OTHER;
+			rt_config.priority = 0;
+			return 0;
+		}
+		else{
+			fprintf(stderr, "Unknown scheduling policy %s\n", value);
+			return 1;
+		}
+
+		if(rt_config.priority < sched_get_priority_min(rt_config.policy)
+				|| rt_config.priority > sched_get_priority_max(rt_config.policy)){
+			fprintf(stderr, "Scheduling priority %d out of range for policy %s (%d - %d)\n", rt_config.priority, value,
+					sched_get_priority_min(rt_config.policy), sched_get_priority_max(rt_config.policy));
+			return 1;
+		}
+		return 0;
+	}
+	#ifdef __linux__
+	else if(!strcmp(option, "cpus")){
+		rt_config.cpus_set = 1;
+		return realtime_parse_cpus(value, &rt_config.cpus);
+	}
+	else if(!strcmp(option, "backend-cpus")){
+		rt_config.backend_cpus_set = 1;
+		return realtime_parse_cpus(value, &rt_config.backend_cpus);
+	}
+	#endif
+
+	fprintf(stderr, "Realtime option %s is not supported on this platform\n", option);
+	return 1;
+	#endif
+}
+
+uint8_t realtime_memlock(){
+	return rt_config.memlock;
+}
+
+#ifndef _WIN32
+static void realtime_prefault_stack(){
+	volatile uint8_t stack[REALTIME_STACK_PREFAULT];
+	size_t u;
+
+	for(u = 0; u < sizeof(stack); u += REALTIME_PAGE){
+		stack[u] = 0;
+	}
+}
+
+static char* realtime_policy_name(int policy){
+	switch(policy){
+		case SCHED_FIFO:
+			return "SCHED_FIFO";
+		case SCHED_RR:
+			return "SCHED_RR";
+		case SCHED_OTHER:
+			return "SCHED_OTHER";
+		default:
+			return "unknown";
+	}
+}
+#endif
+
+int realtime_start(){
+	#ifndef _WIN32
+	int policy = SCHED_OTHER;
+	struct rlimit limit;
+	struct sched_param param = {
+		0
+	};
+
+	if(!rt_config.configured){
+		return 0;
+	}
+
+	if(rt_config.memlock){
+		#if defined(M_TRIM_THRESHOLD) && defined(M_MMAP_MAX)
+		//keep released heap memory locked instead of returning it to the system
+		mallopt(M_TRIM_THRESHOLD, -1);
+		mallopt(M_MMAP_MAX, 0);
+		#endif
+
+		if(mlockall(MCL_CURRENT | MCL_FUTURE)){
+			fprintf(stderr, "Realtime: Failed to lock memory: %s\n", strerror(errno));
+		}
+		else{
+			rt_config.locked = 1;
+			realtime_prefault_stack();
+		}
+	}
+
+	if(rt_config.policy >= 0){
+		param.sched_priority = rt_config.priority;
+		errno = pthread_setschedparam(pthread_self(), rt_config.policy, &param);
+		if(errno){
+			fprintf(stderr, "Realtime: Failed to set main loop scheduling policy: %s\n", strerror(errno));
+		}
+	}
+
+	#ifdef __linux__
+	if(rt_config.cpus_set && sched_setaffinity(0, sizeof(cpu_set_t), &rt_config.cpus)){
+		fprintf(stderr, "Realtime: Failed to set main loop CPU affinity: %s\n", strerror(errno));
+	}
+	#endif
+
+	//report the achieved configuration
+	if(rt_config.memlock){
+		if(getrlimit(RLIMIT_MEMLOCK, &limit)){
+			limit.rlim_cur = 0;
+		}
+		if(limit.rlim_cur == RLIM_INFINITY){
+			fprintf(stderr, "Realtime: Memory %slocked (RLIMIT_MEMLOCK unlimited)\n", rt_config.locked ? "" : "not ");
+		}
+		else{
+			fprintf(stderr, "Realtime: Memory %slocked (RLIMIT_MEMLOCK %lu bytes)\n", rt_config.locked ? "" : "not ", (unsigned long) limit.rlim_cur);
+		}
+	}
+
+	if(!pthread_getschedparam(pthread_self(), &policy, &param)){
+		fprintf(stderr, "Realtime: Main loop running with policy %s, priority %d\n", realtime_policy_name(policy), param.sched_priority);
+		if(rt_config.policy >= 0 && (policy != rt_config.policy || param.sched_priority != rt_config.priority)){
+			#ifdef RLIMIT_RTPRIO
+			if(!getrlimit(RLIMIT_RTPRIO, &limit)){
+				fprintf(stderr, "Realtime: Requested policy %s priority %d not achieved (RLIMIT_RTPRIO %lu)\n",
+						realtime_policy_name(rt_config.policy), rt_config.priority, (unsigned long) limit.rlim_cur);
+			}
+			#else
+			fprintf(stderr, "Realtime: Requested policy %s priority %d not achieved\n",
+					realtime_policy_name(rt_config.policy), rt_config.priority);
+			#endif
+		}
+	}
+
+	#ifdef __linux__
+	if(rt_config.cpus_set){
+		cpu_set_t current;
+		if(!sched_getaffinity(0, sizeof(current), &current)){
+			realtime_print_cpus("Realtime: Main loop CPU affinity ", &current);
+		}
+	}
+	if(rt_config.backend_cpus_set){
+		realtime_print_cpus("Realtime: Backend thread CPU affinity ", &rt_config.backend_cpus);
+	}
+	#endif
+	#endif
+	return 0;
+}
+
+void realtime_stop(){
+	#ifndef _WIN32
+	if(rt_config.locked){
+		munlockall();
+		rt_config.locked = 0;
+	}
+	#endif
+}
+
+MM_API int mm_thread_affinity(){
+	#ifdef __linux__
+	if(rt_config.backend_cpus_set && sched_setaffinity(0, sizeof(cpu_set_t), &rt_config.backend_cpus)){
+		fprintf(stderr, "Failed to set backend thread CPU affinity: %s\n", strerror(errno));
+		return 1;
+	}
+	#endif
+	return 0;
+}
@@ -0,0 +1,5 @@
+/* Internal API */
+int realtime_configure(char* option, char* value);
+uint8_t realtime_memlock();
+int realtime_start();
+void realtime_stop();
@@ -0,0 +1,294 @@
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MICROBENCH_CYCLES
+#endif
+#include "microbench.h"
+#include "backends/libmmbackend.h"
+
+#ifndef MICROBENCH_REVISION
+	#define MICROBENCH_REVISION "unknown"
+#endif
+
+static char* filter = NULL;
+static size_t results = 0;
+static volatile uint64_t allocations = 0;
+static volatile double sink_value = 0.0;
+
+/* Playback update as sent by a grandMA2 onPC for one page of faders, as handled by the maweb backend */
+static char maweb_playbacks[] = "{\"responseType\":\"playbacks\",\"responseSubType\":2,\"iPage\":1,\"itemGroups\":[{\"itemsType\":2,\"cntPages\":10000,\"items\":["
+	"[{\"i\":{\"t\":\"1\",\"c\":\"#000000\"},\"oType\":{\"t\":\"Exec\",\"c\":\"#000000\"},\"oI\":{\"t\":\"1\",\"c\":\"#C0C0C0\"},\"tt\":{\"t\":\"Chaser 1\",\"c\":\"#FFFF80\"},\"bC\":\"#3D3D3D\",\"bdC\":\"#3D3D3D\",\"cues\":{\"bC\":\"#2E2E2E\",\"items\":[{\"t\":\"\",\"c\":\"#FFFFFF\",\"pgs\":{}},{\"t\":\"1 Cue\",\"c\":\"#FFFFFF\",\"pgs\":{\"v\":0,\"bC\":\"#003300\"}}]},\"combinedItems\":1,\"iExec\":0,\"isRun\":1,"
+		"\"executorBlocks\":[{\"button1\":{\"id\":0,\"t\":\"Go\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button2\":{\"id\":0,\"t\":\"Pause\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button3\":{\"id\":0,\"t\":\"Flash\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"fader\":{\"bdC\":\"#3D3D3D\",\"v\":0.75,\"vT\":\"75%\",\"min\":0,\"max\":1}}]}],"
+	"[{\"i\":{\"t\":\"2\",\"c\":\"#000000\"},\"oType\":{\"t\":\"Exec\",\"c\":\"#000000\"},\"oI\":{\"t\":\"2\",\"c\":\"#C0C0C0\"},\"tt\":{\"t\":\"Sequence 2\",\"c\":\"#FFFF80\"},\"bC\":\"#3D3D3D\",\"bdC\":\"#3D3D3D\",\"cues\":{\"bC\":\"#2E2E2E\",\"items\":[{\"t\":\"\",\"c\":\"#FFFFFF\",\"pgs\":{}}]},\"combinedItems\":1,\"iExec\":1,\"isRun\":0,"
+		"\"executorBlocks\":[{\"button1\":{\"id\":0,\"t\":\"Go\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button2\":{\"id\":0,\"t\":\"Pause\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button3\":{\"id\":0,\"t\":\"Flash\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"fader\":{\"bdC\":\"#3D3D3D\",\"v\":0.0,\"vT\":\"0%\",\"min\":0,\"max\":1}}]}],"
+	"[{\"i\":{\"t\":\"3\",\"c\":\"#000000\"},\"oType\":{\"t\":\"Exec\",\"c\":\"#000000\"},\"oI\":{\"t\":\"3\",\"c\":\"#C0C0C0\"},\"tt\":{\"t\":\"Effect 3\",\"c\":\"#FFFF80\"},\"bC\":\"#3D3D3D\",\"bdC\":\"#3D3D3D\",\"cues\":{\"bC\":\"#2E2E2E\",\"items\":[{\"t\":\"\",\"c\":\"#FFFFFF\",\"pgs\":{}}]},\"combinedItems\":2,\"iExec\":2,\"isRun\":1,"
+		"\"executorBlocks\":[{\"button1\":{\"id\":0,\"t\":\"Go\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button2\":{\"id\":0,\"t\":\"Pause\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button3\":{\"id\":0,\"t\":\"Flash\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"fader\":{\"bdC\":\"#3D3D3D\",\"v\":0.5,\"vT\":\"50%\",\"min\":0,\"max\":1}},"
+		"{\"button1\":{\"id\":0,\"t\":\"Go\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button2\":{\"id\":0,\"t\":\"Pause\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"button3\":{\"id\":0,\"t\":\"Flash\",\"s\":false,\"c\":\"#C0C0C0\",\"bdC\":\"#3D3D3D\",\"bC\":\"#000000\"},\"fader\":{\"bdC\":\"#3D3D3D\",\"v\":0.25,\"vT\":\"25%\",\"min\":0,\"max\":1}}]}]"
+	"]}],\"worldIndex\":0}";
+
+#ifdef MICROBENCH_ALLOCATIONS
+/* Allocation counters, linked in with --wrap for all objects of the harness */
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+char* __real_strdup(const char* s);
+
+void* __wrap_malloc(size_t size){
+	allocations++;
+	return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size){
+	allocations++;
+	return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size){
+	allocations++;
+	return __real_realloc(ptr, size);
+}
+
+char* __wrap_strdup(const char* s){
+	allocations++;
+	return __real_strdup(s);
+}
+#endif
+
+static uint64_t microbench_time(){
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static uint64_t microbench_cycles(){
+	#ifdef MICROBENCH_CYCLES
+	return __rdtsc();
+	#else
+	return 0;
+	#endif
+}
+
+int microbench_run(char* name, microbench_call call, void* arg, size_t bytes){
+	size_t u, iterations = 16;
+	uint64_t start, cycles, allocated, elapsed = 0;
+
+	if(filter && !strstr(name, filter)){
+		return 0;
+	}
+
+	//warm up caches and lazily allocated buffers
+	for(u = 0; u < iterations; u++){
+		if(call(arg)){
+			fprintf(stderr, "Benchmark %s failed\n", name);
+			return 1;
+		}
+	}
+
+	//double the iteration count until the measurement takes long enough
+	for(; iterations <= MICROBENCH_MAX_ITERATIONS; iterations *= 2){
+		allocated = allocations;
+		cycles = microbench_cycles();
+		start = microbench_time();
+		for(u = 0; u < iterations; u++){
+			call(arg);
+		}
+		elapsed = microbench_time() - start;
+		cycles = microbench_cycles() - cycles;
+		allocated = allocations - allocated;
+
+		if(elapsed >= MICROBENCH_MIN_TIME){
+			break;
+		}
+	}
+	iterations = min(iterations, MICROBENCH_MAX_ITERATIONS);
+	elapsed = max(elapsed, 1);
+
+	printf("%s\n\t\t{\"name\": \"%s\", \"iterations\": %" PRIsize_t ", \"ns_per_call\": %.2f", results ? "," : "", name, iterations, (double) elapsed / iterations);
+	#ifdef MICROBENCH_CYCLES
+	printf(", \"cycles_per_call\": %.2f", (double) cycles / iterations);
+	#else
+	printf(", \"cycles_per_call\": null");
+	#endif
+	printf(", \"calls_per_second\": %.0f", iterations * 1e9 / elapsed);
+	if(bytes){
+		printf(", \"bytes_per_second\": %.0f", bytes * iterations * 1e9 / elapsed);
+	}
+	else{
+		printf(", \"bytes_per_second\": null");
+	}
+	#ifdef MICROBENCH_ALLOCATIONS
+	printf(", \"allocations_per_call\": %.3f}", (double) allocated / iterations);
+	#else
+	printf(", \"allocations_per_call\": null}");
+	#endif
+	fflush(stdout);
+	results++;
+	return 0;
+}
+
+/* Event sink backend, used as the mapping target for all benchmarked inputs */
+static int sink_configure(char* option, char* value){
+	fprintf(stderr, "The bench backend does not take any global configuration\n");
+	return 1;
+}
+
+static int sink_configure_instance(instance* inst, char* option, char* value){
+	fprintf(stderr, "The bench backend does not take any instance configuration\n");
+	return 1;
+}
+
+static instance* sink_instance(){
+	return mm_instance();
+}
+
+static channel* sink_channel(instance* inst, char* spec){
+	uint64_t ident = strtoul(spec, NULL, 10);
+	if(!ident){
+		fprintf(stderr, "Invalid bench channel %s\n", spec);
+		return NULL;
+	}
+	return mm_channel(inst, ident, 1);
+}
+
+static int sink_set(instance* inst, size_t num, channel** c, channel_value* v){
+	size_t u;
+	for(u = 0; u < num; u++){
+		sink_value += v[u].normalised;
+	}
+	return 0;
+}
+
+static int sink_handle(size_t num, managed_fd* fds){
+	return 0;
+}
+
+static int sink_start(){
+	return 0;
+}
+
+static int sink_shutdown(){
+	return 0;
+}
+
+static int sink_register(){
+	backend sink = {
+		.name = "bench",
+		.conf = sink_configure,
+		.create = sink_instance,
+		.conf_instance = sink_configure_instance,
+		.channel = sink_channel,
+		.handle = sink_set,
+		.process = sink_handle,
+		.start = sink_start,
+		.shutdown = sink_shutdown
+	};
+	return mm_backend_register(sink);
+}
+
+static int json_validate_call(void* arg){
+	char* payload = (char*) arg;
+	return json_validate(payload, strlen(payload)) ? 0 : 1;
+}
+
+//the traversal performed by the maweb backend for playback updates
+static int json_playbacks_call(void* arg){
+	char* payload = (char*) arg;
+	size_t base = json_obj_offset(payload, "itemGroups"), group_offset, subgroup_offset, item_offset, blocks, block_offset, control;
+	uint64_t group, subgroup, item, block;
+
+	for(group = 0; (group_offset = json_array_offset(payload + base, group)); group++){
+		sink_value += json_obj_int(payload + base + group_offset, "itemsType", 0);
+		group_offset += base + json_obj_offset(payload + base + group_offset, "items");
+		for(subgroup = 0; (subgroup_offset = json_array_offset(payload + group_offset, subgroup)); subgroup++){
+			subgroup_offset += group_offset;
+			for(item = 0; (item_offset = json_array_offset(payload + subgroup_offset, item)); item++){
+				item_offset += subgroup_offset;
+				sink_value += json_obj_int(payload + item_offset, "iExec", 191);
+				blocks = item_offset + json_obj_offset(payload + item_offset, "executorBlocks");
+				for(block = 0; (block_offset = json_array_offset(payload + blocks, block)); block++){
+					control = blocks + block_offset + json_obj_offset(payload + blocks + block_offset, "fader");
+					sink_value += json_obj_double(payload + control, "v", 0.0);
+					sink_value += json_obj_int(payload + item_offset, "isRun", 0);
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+static int microbench_json(){
+	return microbench_run("json_validate", json_validate_call, maweb_playbacks, strlen(maweb_playbacks))
+		|| microbench_run("json_maweb_playbacks", json_playbacks_call, maweb_playbacks, strlen(maweb_playbacks));
+}
+
+typedef struct /*_quantize_bench*/ {
+	size_t current;
+	channel_value in[2][512];
+	uint8_t out[512];
+	uint64_t changed[512 / 64];
+} quantize_bench;
+
+//convert a universe worth of values, alternating between two inputs so every value changes
+static int quantize_call(void* arg){
+	quantize_bench* bench = (quantize_bench*) arg;
+	sink_value += mmbackend_quantize_u8(512, bench->in[bench->current], 255, bench->out, bench->changed);
+	bench->current ^= 1;
+	return 0;
+}
+
+static int microbench_quantize(){
+	quantize_bench bench = {
+		0
+	};
+	size_t u;
+
+	for(u = 0; u < 512; u++){
+		bench.in[0][u].normalised = (double) u / 511.0;
+		bench.in[1][u].normalised = 1.0 - bench.in[0][u].normalised;
+	}
+
+	return microbench_run("mmbackend_quantize_u8", quantize_call, &bench, sizeof(bench.in[0]));
+}
+
+int main(int argc, char** argv){
+	int rv = EXIT_FAILURE;
+	char* cfg = MICROBENCH_CONFIG;
+
+	if(argc > 1){
+		filter = argv[1];
+	}
+	if(argc > 2){
+		cfg = argv[2];
+	}
+
+	if(sink_register()
+			|| microbench_artnet_register()
+			|| microbench_sacn_register()
+			|| microbench_osc_register()){
+		fprintf(stderr, "Failed to register benchmarked backends\n");
+		return EXIT_FAILURE;
+	}
+
+	if(microbench_core_setup(cfg)){
+		fprintf(stderr, "Failed to set up benchmark configuration %s\n", cfg);
+		return EXIT_FAILURE;
+	}
+
+	printf("{\n\t\"revision\": \"%s\",\n\t\"benchmarks\": [", MICROBENCH_REVISION);
+	if(microbench_artnet()
+			|| microbench_sacn()
+			|| microbench_osc()
+			|| microbench_json()
+			|| microbench_quantize()
+			|| microbench_config()
+			|| microbench_core()){
+		goto bail;
+	}
+	rv = EXIT_SUCCESS;
+
+bail:
+	printf("\n\t]\n}\n");
+	return rv;
+}
@@ -0,0 +1,39 @@
+#include "midimonster.h"
+
+/*
+ * Microbenchmark harness for the hot paths of the core and the network backends.
+ * The backend and core sources are compiled directly into the harness so that
+ * their internal functions can be called without going through the plugin loader.
+ */
+
+/* Setup configuration read by the harness, relative to the working directory */
+#define MICROBENCH_CONFIG "tools/microbench.cfg"
+/* Minimum measurement time per benchmark in nanoseconds */
+#define MICROBENCH_MIN_TIME 200000000
+/* Upper bound for the iteration count per benchmark */
+#define MICROBENCH_MAX_ITERATIONS (1 << 26)
+
+/* Benchmarked call, returns nonzero on failure */
+typedef int (*microbench_call)(void* arg);
+
+/*
+ * Time `call` with an automatically calibrated number of iterations and report
+ * the results. `bytes` is the amount of input data processed per call, used to
+ * calculate the throughput, and may be 0.
+ * Returns nonzero if the call failed.
+ */
+int microbench_run(char* name, microbench_call call, void* arg, size_t bytes);
+
+/* Backend registration, the renamed init() of each included backend */
+int microbench_artnet_register();
+int microbench_sacn_register();
+int microbench_osc_register();
+
+/* Core setup and benchmark sets, each returning nonzero on failure */
+int microbench_core_setup(char* cfg);
+void microbench_core_reset();
+int microbench_core();
+int microbench_config();
+int microbench_artnet();
+int microbench_sacn();
+int microbench_osc();
@@ -0,0 +1,60 @@
+/* The backend is compiled into the harness to reach its internal functions */
+#define init microbench_artnet_register
+#include "../backends/artnet.c"
+#undef init
+#include "microbench.h"
+
+typedef struct /*_artnet_bench*/ {
+	instance* inst;
+	size_t current;
+	artnet_pkt frame[2];
+	struct sockaddr_storage sender;
+	socklen_t sender_len;
+} artnet_bench;
+
+static int artnet_frame_call(void* arg){
+	artnet_bench* bench = (artnet_bench*) arg;
+	//alternate between two frames so every channel changes with each call
+	int rv = artnet_process_frame(bench->inst, bench->frame + bench->current, &bench->sender, bench->sender_len);
+	bench->current ^= 1;
+	microbench_core_reset();
+	return rv;
+}
+
+int microbench_artnet(){
+	artnet_bench bench = {
+		0
+	};
+	struct sockaddr_in* sender = (struct sockaddr_in*) &bench.sender;
+	instance** inst = NULL;
+	size_t n, u, p;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst) || !n){
+		fprintf(stderr, "No artnet instance configured for the artnet benchmarks\n");
+		goto bail;
+	}
+	bench.inst = inst[0];
+
+	//all frames originate from one fixed sender, so no merging takes place
+	sender->sin_family = AF_INET;
+	sender->sin_port = htobe16(6454);
+	sender->sin_addr.s_addr = htobe32(0x7F000001);
+	bench.sender_len = sizeof(struct sockaddr_in);
+
+	for(u = 0; u < 2; u++){
+		memcpy(bench.frame[u].magic, "Art-Net", 8);
+		bench.frame[u].opcode = htobe16(OpDmx);
+		bench.frame[u].version = htobe16(ARTNET_VERSION);
+		bench.frame[u].length = htobe16(512);
+		for(p = 0; p < 512; p++){
+			bench.frame[u].data[p] = u ? 255 - p % 256 : p % 256;
+		}
+	}
+
+	rv = microbench_run("artnet_process_frame", artnet_frame_call, &bench, sizeof(artnet_pkt));
+
+bail:
+	free(inst);
+	return rv;
+}
@@ -0,0 +1,45 @@
+/* The configuration parser is compiled into the harness to reach its internal functions */
+#include "../config.c"
+#include "microbench.h"
+
+typedef struct /*_microbench_glob*/ {
+	instance* inst;
+	channel_spec spec;
+	uint64_t n;
+} microbench_glob;
+
+static int glob_resolve_call(void* arg){
+	microbench_glob* glob = (microbench_glob*) arg;
+	channel* result = config_glob_resolve(glob->inst, &glob->spec, glob->n);
+	glob->n = (glob->n + 1) % glob->spec.channels;
+	return result ? 0 : 1;
+}
+
+int microbench_config(){
+	char spec[] = "{1..512}";
+	microbench_glob glob = {
+		.spec = {
+			.spec = spec
+		}
+	};
+	instance** inst = NULL;
+	size_t n;
+	int rv = 1;
+
+	if(mm_backend_instances("bench", &n, &inst) || !n){
+		fprintf(stderr, "No bench instance configured for the configuration benchmarks\n");
+		goto bail;
+	}
+	glob.inst = inst[0];
+
+	if(config_glob_scan(glob.inst, &glob.spec)){
+		goto bail;
+	}
+
+	rv = microbench_run("config_glob_resolve", glob_resolve_call, &glob, 0);
+
+bail:
+	free(glob.spec.glob);
+	free(inst);
+	return rv;
+}
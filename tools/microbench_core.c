@@ -0,0 +1,95 @@
+/* The core is compiled into the harness to reach its internal state */
+#define main midimonster_main
+#include "../midimonster.c"
+#undef main
+#include "microbench.h"
+
+/* Number of sink instances receiving events in the backends_notify benchmark */
+#define MICROBENCH_SINKS 4
+/* Events delivered per backends_notify call */
+#define MICROBENCH_NOTIFY_EVENTS 512
+
+typedef struct /*_microbench_notify*/ {
+	channel* channel[MICROBENCH_NOTIFY_EVENTS];
+	channel_value value[MICROBENCH_NOTIFY_EVENTS];
+} microbench_notify;
+
+int microbench_core_setup(char* cfg){
+	if(config_read(cfg)
+			|| map_check_cycles()
+			|| map_compile()
+			|| merge_build(mappings, map)){
+		return 1;
+	}
+	update_timestamp();
+	return 0;
+}
+
+void microbench_core_reset(){
+	size_t u;
+	for(u = 0; u < latency_classes; u++){
+		primary[u]->n = 0;
+	}
+}
+
+static int channel_event_call(void* arg){
+	channel_value v = {
+		.normalised = 0.5,
+		.raw.u64 = 128
+	};
+	int rv = mm_channel_event((channel*) arg, v);
+	microbench_core_reset();
+	return rv;
+}
+
+static int notify_call(void* arg){
+	microbench_notify* events = (microbench_notify*) arg;
+	return backends_notify(MICROBENCH_NOTIFY_EVENTS, events->channel, events->value);
+}
+
+int microbench_core(){
+	microbench_notify events;
+	instance* sink[MICROBENCH_SINKS] = {
+		NULL
+	};
+	channel* input = NULL;
+	instance** inst = NULL;
+	size_t n, u;
+	int rv = 1;
+
+	if(mm_backend_instances("artnet", &n, &inst) || !n){
+		fprintf(stderr, "No artnet instance configured for the core benchmarks\n");
+		goto bail;
+	}
+	input = mm_channel(inst[0], 0, 0);
+	free(inst);
+	inst = NULL;
+
+	if(mm_backend_instances("bench", &n, &inst) || n < MICROBENCH_SINKS){
+		fprintf(stderr, "The core benchmarks require %d bench instances\n", MICROBENCH_SINKS);
+		goto bail;
+	}
+	memcpy(sink, inst, sizeof(sink));
+
+	//interleave the events for all sinks
+	for(u = 0; u < MICROBENCH_NOTIFY_EVENTS; u++){
+		events.channel[u] = mm_channel(sink[u % MICROBENCH_SINKS], u / MICROBENCH_SINKS + 1, 1);
+		events.value[u].normalised = (double) u / MICROBENCH_NOTIFY_EVENTS;
+		events.value[u].raw.u64 = u;
+		if(!events.channel[u]){
+			goto bail;
+		}
+	}
+
+	if(!input){
+		fprintf(stderr, "No mapped input channel for the core benchmarks\n");
+		goto bail;
+	}
+
+	rv = microbench_run("mm_channel_event", channel_event_call, input, 0)
+		|| microbench_run("backends_notify", notify_call, &events, MICROBENCH_NOTIFY_EVENTS * sizeof(channel_value));
+
+bail:
+	free(inst);
+	return rv;
+}
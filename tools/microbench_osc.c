@@ -0,0 +1,55 @@
+/* The backend is compiled into the harness to reach its internal functions */
+#define init microbench_osc_register
+#include "../backends/osc.c"
+#undef init
+#include "microbench.h"
+
+typedef struct /*_osc_bench*/ {
+	instance* inst;
+	size_t current;
+	uint8_t payload[2][4];
+} osc_bench;
+
+static int osc_packet_call(void* arg){
+	osc_bench* bench = (osc_bench*) arg;
+	int rv = osc_process_packet(bench->inst, "/1/fader5", "f", bench->payload[bench->current], sizeof(bench->payload[bench->current]));
+	bench->current ^= 1;
+	microbench_core_reset();
+	return rv;
+}
+
+static int osc_match_call(void* arg){
+	//a typical set of patterns checked against an incoming path
+	return !(osc_path_match("/1/fader[0-9]", "/1/fader5")
+			&& osc_path_match("/*/fader?", "/1/fader5")
+			&& !osc_path_match("/{2,3}/fader5", "/1/fader5")
+			&& !osc_path_match("/1/rotary[!5]", "/1/fader5"));
+}
+
+int microbench_osc(){
+	osc_bench bench = {
+		0
+	};
+	instance** inst = NULL;
+	osc_parameter_value value;
+	size_t n, u;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst) || !n){
+		fprintf(stderr, "No osc instance configured for the osc benchmarks\n");
+		goto bail;
+	}
+	bench.inst = inst[0];
+
+	for(u = 0; u < 2; u++){
+		value.f = u ? 0.25 : 0.75;
+		osc_deparse(float32, value, bench.payload[u]);
+	}
+
+	rv = microbench_run("osc_process_packet", osc_packet_call, &bench, sizeof(bench.payload[0]))
+		|| microbench_run("osc_path_match", osc_match_call, NULL, 0);
+
+bail:
+	free(inst);
+	return rv;
+}
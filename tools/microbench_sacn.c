@@ -0,0 +1,52 @@
+/* The backend is compiled into the harness to reach its internal functions */
+#define init microbench_sacn_register
+#include "../backends/sacn.c"
+#undef init
+#include "microbench.h"
+
+typedef struct /*_sacn_bench*/ {
+	instance* inst;
+	size_t current;
+	sacn_data_pdu frame[2];
+} sacn_bench;
+
+static int sacn_frame_call(void* arg){
+	sacn_bench* bench = (sacn_bench*) arg;
+	//alternate between two frames so every channel changes with each call
+	int rv = sacn_process_frame(bench->inst, &bench->frame[bench->current].root, &bench->frame[bench->current].data);
+	bench->current ^= 1;
+	microbench_core_reset();
+	return rv;
+}
+
+int microbench_sacn(){
+	sacn_bench bench = {
+		0
+	};
+	instance** inst = NULL;
+	size_t n, u, p;
+	int rv = 1;
+
+	if(mm_backend_instances(BACKEND_NAME, &n, &inst) || !n){
+		fprintf(stderr, "No sacn instance configured for the sacn benchmarks\n");
+		goto bail;
+	}
+	bench.inst = inst[0];
+
+	for(u = 0; u < 2; u++){
+		memcpy(bench.frame[u].root.magic, SACN_PDU_MAGIC, sizeof(bench.frame[u].root.magic));
+		bench.frame[u].data.priority = 100;
+		bench.frame[u].data.format = 0xa1;
+		bench.frame[u].data.address_increment = htobe16(1);
+		bench.frame[u].data.channels = htobe16(513);
+		for(p = 1; p < 513; p++){
+			bench.frame[u].data.data[p] = u ? 255 - p % 256 : p % 256;
+		}
+	}
+
+	rv = microbench_run("sacn_process_frame", sacn_frame_call, &bench, sizeof(sacn_data_pdu));
+
+bail:
+	free(inst);
+	return rv;
+}
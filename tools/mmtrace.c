@@ -0,0 +1,281 @@
+#include <string.h>
+#include <errno.h>
+#include "midimonster.h"
+#include "trace.h"
+
+/*
+ * Offline decoder for MIDIMonster event traces.
+ * Prints a per-thread timeline of the recorded tracepoints, following
+ * each batch of channel events through dispatch, output handling and
+ * transmission, or exports the trace in the Chrome trace event format.
+ */
+
+/* Maximum enter/exit nesting depth tracked per thread */
+#define MMTRACE_DEPTH 16
+
+typedef struct /*_mmtrace_thread*/ {
+	size_t depth;
+	uint64_t enter[MMTRACE_DEPTH];
+	//time of the first event not yet dispatched and of the event batch being output
+	uint64_t pending;
+	uint64_t origin;
+} mmtrace_thread;
+
+static char* point_name(uint32_t point){
+	switch(point){
+		case mm_trace_fd_ready:
+			return "fd-ready";
+		case mm_trace_process_enter:
+		case mm_trace_process_exit:
+			return "process";
+		case mm_trace_event:
+			return "event";
+		case mm_trace_dispatch:
+			return "dispatch";
+		case mm_trace_handle_enter:
+		case mm_trace_handle_exit:
+			return "handle";
+		case mm_trace_transmit:
+			return "transmit";
+	}
+	return "unknown";
+}
+
+static int usage(char* fn){
+	fprintf(stderr, "MIDIMonster trace decoder\n");
+	fprintf(stderr, "Usage:\n");
+	fprintf(stderr, "\t%s [-c] [-i <channel id>] <tracefile>\n", fn);
+	fprintf(stderr, "\t-c\tExport Chrome trace event JSON instead of a timeline\n");
+	fprintf(stderr, "\t-i\tOnly show events of one channel in the timeline\n");
+	return EXIT_FAILURE;
+}
+
+/* Records being sorted by record_compare, ordered by time and then by file position */
+static trace_record* sort_base = NULL;
+
+static int record_compare(const void* a, const void* b){
+	size_t ia = *((const size_t*) a), ib = *((const size_t*) b);
+
+	if(sort_base[ia].time != sort_base[ib].time){
+		return (sort_base[ia].time < sort_base[ib].time) ? -1 : 1;
+	}
+	//keep the recorded order of simultaneous records
+	return (ia < ib) ? -1 : (ia > ib);
+}
+
+static double record_value(trace_record* r){
+	double value;
+	memcpy(&value, &r->arg, sizeof(value));
+	return value;
+}
+
+static void export_chrome(trace_record* record, size_t n){
+	size_t u;
+	uint64_t base = n ? record[0].time : 0;
+	double ts;
+
+	printf("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for(u = 0; u < n; u++){
+		ts = (record[u].time - base) / 1000.0;
+		printf("%s\n{\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%.3f,", u ? "," : "", record[u].thread, ts);
+		switch(record[u].point){
+			case mm_trace_process_enter:
+			case mm_trace_handle_enter:
+				printf("\"ph\":\"B\",\"name\":\"%s %s %" PRIu64 "\",\"args\":{\"events\":%" PRIu64 "}}",
+						point_name(record[u].point),
+						(record[u].point == mm_trace_process_enter) ? "backend" : "instance",
+						record[u].id, record[u].arg);
+				break;
+			case mm_trace_process_exit:
+			case mm_trace_handle_exit:
+				printf("\"ph\":\"E\"}");
+				break;
+			case mm_trace_event:
+				printf("\"ph\":\"i\",\"s\":\"t\",\"name\":\"event\",\"args\":{\"channel\":%" PRIu64 ",\"value\":%f}}",
+						record[u].id, record_value(record + u));
+				break;
+			default:
+				printf("\"ph\":\"i\",\"s\":\"t\",\"name\":\"%s\",\"args\":{\"id\":%" PRIu64 ",\"arg\":%" PRIu64 "}}",
+						point_name(record[u].point), record[u].id, record[u].arg);
+				break;
+		}
+	}
+	printf("\n]}\n");
+}
+
+static int print_timeline(trace_record* record, size_t n, uint32_t threads, uint64_t filter){
+	size_t u;
+	uint64_t base = n ? record[0].time : 0;
+	mmtrace_thread* state = calloc(threads, sizeof(mmtrace_thread));
+	mmtrace_thread* t = NULL;
+	trace_record* r = NULL;
+
+	if(!state){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	for(u = 0; u < n; u++){
+		r = record + u;
+		t = state + r->thread;
+
+		if(r->point == mm_trace_event && filter && r->id != filter){
+			t->pending = t->pending ? t->pending : r->time;
+			continue;
+		}
+
+		printf("%14.3f us  [%2" PRIu32 "] %*s", (r->time - base) / 1000.0, r->thread, (int) (2 * t->depth), "");
+
+		switch(r->point){
+			case mm_trace_fd_ready:
+				printf("fd %" PRIu64 " ready\n", r->id);
+				break;
+			case mm_trace_process_enter:
+			case mm_trace_handle_enter:
+				printf("%s %s %" PRIu64 " with %" PRIu64 " %s\n", point_name(r->point),
+						(r->point == mm_trace_process_enter) ? "backend" : "instance",
+						r->id, r->arg, (r->point == mm_trace_process_enter) ? "descriptors" : "events");
+				if(t->depth < MMTRACE_DEPTH){
+					t->enter[t->depth] = r->time;
+				}
+				t->depth++;
+				break;
+			case mm_trace_process_exit:
+			case mm_trace_handle_exit:
+				if(t->depth){
+					t->depth--;
+				}
+				printf("%s done", point_name(r->point));
+				if(t->depth < MMTRACE_DEPTH && t->enter[t->depth]){
+					printf(" after %.3f us", (r->time - t->enter[t->depth]) / 1000.0);
+					t->enter[t->depth] = 0;
+				}
+				printf("\n");
+				break;
+			case mm_trace_event:
+				t->pending = t->pending ? t->pending : r->time;
+				printf("event on channel %" PRIu64 ": %f\n", r->id, record_value(r));
+				break;
+			case mm_trace_dispatch:
+				printf("dispatch round %" PRIu64 " with %" PRIu64 " events", r->id, r->arg);
+				if(t->pending){
+					printf(", %.3f us after the first event", (r->time - t->pending) / 1000.0);
+					t->origin = t->pending;
+					t->pending = 0;
+				}
+				printf("\n");
+				break;
+			case mm_trace_transmit:
+				printf("transmit %" PRIu64 " bytes on fd %" PRIu64, r->arg, r->id);
+				if(t->origin){
+					printf(", %.3f us after the first event", (r->time - t->origin) / 1000.0);
+				}
+				printf("\n");
+				break;
+			default:
+				printf("unknown tracepoint %" PRIu32 "\n", r->point);
+		}
+	}
+
+	free(state);
+	return 0;
+}
+
+int main(int argc, char** argv){
+	trace_header header;
+	trace_record* record = NULL;
+	trace_record* sorted = NULL;
+	size_t* order = NULL;
+	uint8_t chrome = 0;
+	uint64_t filter = 0;
+	uint32_t threads = 0;
+	char* file = NULL;
+	FILE* in = NULL;
+	size_t u;
+	int rv = EXIT_FAILURE;
+
+	for(u = 1; u < argc; u++){
+		if(!strcmp(argv[u], "-c")){
+			chrome = 1;
+		}
+		else if(!strcmp(argv[u], "-i") && u + 1 < argc){
+			filter = strtoull(argv[++u], NULL, 10);
+		}
+		else if(!file && argv[u][0] != '-'){
+			file = argv[u];
+		}
+		else{
+			return usage(argv[0]);
+		}
+	}
+
+	if(!file){
+		return usage(argv[0]);
+	}
+
+	in = fopen(file, "rb");
+	if(!in){
+		fprintf(stderr, "Failed to open %s: %s\n", file, strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if(fread(&header, sizeof(header), 1, in) != 1
+			|| memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic))
+			|| header.record_size != sizeof(trace_record)){
+		fprintf(stderr, "%s is not a MIDIMonster trace file or was written by an incompatible version\n", file);
+		goto bail;
+	}
+
+	record = calloc(header.records ? header.records : 1, sizeof(trace_record));
+	if(!record){
+		fprintf(stderr, "Failed to allocate memory\n");
+		goto bail;
+	}
+
+	if(fread(record, sizeof(trace_record), header.records, in) != header.records){
+		fprintf(stderr, "Trace file %s is truncated\n", file);
+		goto bail;
+	}
+
+	for(u = 0; u < header.records; u++){
+		threads = max(threads, record[u].thread + 1);
+	}
+
+	//rings are stored one after another, merge them into one timeline
+	order = calloc(header.records ? header.records : 1, sizeof(size_t));
+	sorted = calloc(header.records ? header.records : 1, sizeof(trace_record));
+	if(!order || !sorted){
+		fprintf(stderr, "Failed to allocate memory\n");
+		goto bail;
+	}
+
+	for(u = 0; u < header.records; u++){
+		order[u] = u;
+	}
+	sort_base = record;
+	qsort(order, header.records, sizeof(size_t), record_compare);
+	for(u = 0; u < header.records; u++){
+		sorted[u] = record[order[u]];
+	}
+	free(record);
+	record = sorted;
+	sorted = NULL;
+
+	if(chrome){
+		export_chrome(record, header.records);
+	}
+	else{
+		fprintf(stderr, "%" PRIu64 " records of %" PRIu32 " threads, %" PRIu64 " overwritten or lost\n", header.records, header.threads, header.lost);
+		if(print_timeline(record, header.records, threads, filter)){
+			goto bail;
+		}
+	}
+
+	rv = EXIT_SUCCESS;
+bail:
+	free(record);
+	free(sorted);
+	free(order);
+	fclose(in);
+	return rv;
+}
@@ -0,0 +1,282 @@
+#include <string.h>
+#include <signal.h>
+#include <errno.h>
+#include <time.h>
+#ifndef _WIN32
+#define MM_API __attribute__((visibility("default")))
+#else
+#define MM_API __attribute__((dllexport))
+#endif
+#include "midimonster.h"
+#include "trace.h"
+#include "memory.h"
+
+/* Records per thread ring, rounded up to a power of two */
+#define TRACE_DEFAULT_RECORDS 65536
+/* Maximum number of threads recording traces */
+#define TRACE_MAX_THREADS 64
+#define TRACE_DEFAULT_FILE "midimonster.trace"
+
+/* Per-thread ring, only ever written by the owning thread */
+typedef struct /*_mm_trace_ring*/ {
+	uint32_t thread;
+	uint64_t head;
+	trace_record* record;
+} trace_ring;
+
+static struct /*_mm_trace_config*/ {
+	uint8_t configured;
+	volatile sig_atomic_t enabled;
+	volatile sig_atomic_t dump;
+	size_t size;
+	char* file;
+	uint32_t threads;
+	trace_ring* ring[TRACE_MAX_THREADS];
+	uint64_t lost;
+	#ifdef _WIN32
+	uint64_t frequency;
+	#endif
+} trace = {
+	.size = TRACE_DEFAULT_RECORDS
+};
+
+static _Thread_local trace_ring* local_ring = NULL;
+static _Thread_local uint8_t local_failed = 0;
+
+int trace_configure(char* option, char* value){
+	size_t size;
+
+	if(!strcmp(option, "trace")){
+		trace.configured = strcmp(value, "on") ? 0 : 1;
+		return 0;
+	}
+	else if(!strcmp(option, "trace-file")){
+		free(trace.file);
+		trace.file = strdup(value);
+		if(!trace.file){
+			fprintf(stderr, "Failed to allocate memory\n");
+			return 1;
+		}
+		return 0;
+	}
+	else if(!strcmp(option, "trace-size")){
+		size = strtoul(value, NULL, 10);
+		if(!size){
+			fprintf(stderr, "The trace-size option requires a positive value\n");
+			return 1;
+		}
+		for(trace.size = 1; trace.size < size; trace.size *= 2){
+		}
+		return 0;
+	}
+
+	fprintf(stderr, "Unknown trace option %s\n", option);
+	return 1;
+}
+
+static uint64_t trace_time(){
+	#ifdef _WIN32
+	LARGE_INTEGER count;
+	QueryPerformanceCounter(&count);
+	return (count.QuadPart / trace.frequency) * 1000000000 + ((count.QuadPart % trace.frequency) * 1000000000) / trace.frequency;
+	#else
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t) now.tv_sec * 1000000000 + now.tv_nsec;
+	#endif
+}
+
+//allocate and register the ring of the calling thread
+static int trace_ring_create(){
+	trace_ring* ring = NULL;
+	uint32_t slot = __atomic_fetch_add(&trace.threads, 1, __ATOMIC_ACQ_REL);
+
+	if(slot >= TRACE_MAX_THREADS){
+		fprintf(stderr, "Trace: Too many threads, not recording events of thread %" PRIu32 "\n", slot);
+		local_failed = 1;
+		return 1;
+	}
+
+	ring = memory_calloc(memory_core(memory_trace), 1, sizeof(trace_ring));
+	if(ring){
+		ring->record = memory_calloc(memory_core(memory_trace), trace.size, sizeof(trace_record));
+	}
+	if(!ring || !ring->record){
+		fprintf(stderr, "Failed to allocate memory\n");
+		memory_free(ring);
+		local_failed = 1;
+		return 1;
+	}
+
+	ring->thread = slot;
+	local_ring = ring;
+	__atomic_store_n(trace.ring + slot, ring, __ATOMIC_RELEASE);
+	return 0;
+}
+
+MM_API void mm_trace(trace_point point, uint64_t id, uint64_t arg){
+	trace_record* record = NULL;
+	uint64_t head;
+
+	if(!trace.enabled){
+		return;
+	}
+
+	if(!local_ring && (local_failed || trace_ring_create())){
+		__atomic_fetch_add(&trace.lost, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	head = local_ring->head;
+	record = local_ring->record + (head & (trace.size - 1));
+	record->time = trace_time();
+	record->id = id;
+	record->arg = arg;
+	record->point = point;
+	record->thread = local_ring->thread;
+
+	//publish the record to the dumping thread
+	__atomic_store_n(&local_ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+//write the contents of all rings to the trace file, oldest records of each ring first
+static int trace_dump(){
+	trace_header header = {
+		.magic = TRACE_FILE_MAGIC,
+		.record_size = sizeof(trace_record)
+	};
+	char* file = trace.file ? trace.file : TRACE_DEFAULT_FILE;
+	uint32_t u, threads = min(__atomic_load_n(&trace.threads, __ATOMIC_ACQUIRE), TRACE_MAX_THREADS);
+	uint64_t head, first, limit, n, p, skip;
+	trace_record* copy = calloc(trace.size, sizeof(trace_record));
+	trace_ring* ring = NULL;
+	FILE* out = NULL;
+	int rv = 1;
+
+	if(!copy){
+		fprintf(stderr, "Failed to allocate memory\n");
+		return 1;
+	}
+
+	out = fopen(file, "wb");
+	if(!out){
+		fprintf(stderr, "Trace: Failed to open %s: %s\n", file, strerror(errno));
+		goto bail;
+	}
+
+	//the header is rewritten once the record count is known
+	if(fwrite(&header, sizeof(header), 1, out) != 1){
+		goto write_fail;
+	}
+
+	for(u = 0; u < threads; u++){
+		ring = __atomic_load_n(trace.ring + u, __ATOMIC_ACQUIRE);
+		if(!ring){
+			continue;
+		}
+		header.threads++;
+
+		head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		first = (head > trace.size) ? head - trace.size : 0;
+		for(p = first, n = 0; p < head; p++, n++){
+			copy[n] = ring->record[p & (trace.size - 1)];
+		}
+
+		//discard records the owning thread may have overwritten while copying
+		limit = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) + 1;
+		skip = (limit > trace.size && limit - trace.size > first) ? min(limit - trace.size - first, n) : 0;
+
+		if(n - skip && fwrite(copy + skip, sizeof(trace_record), n - skip, out) != n - skip){
+			goto write_fail;
+		}
+		header.records += n - skip;
+		header.lost += first + skip;
+	}
+
+	header.lost += __atomic_load_n(&trace.lost, __ATOMIC_RELAXED);
+	if(fseek(out, 0, SEEK_SET) || fwrite(&header, sizeof(header), 1, out) != 1){
+		goto write_fail;
+	}
+
+	fprintf(stderr, "Trace: Wrote %" PRIu64 " records of %" PRIu32 " threads to %s (%" PRIu64 " overwritten or lost)\n", header.records, header.threads, file, header.lost);
+	rv = 0;
+	goto bail;
+
+write_fail:
+	fprintf(stderr, "Trace: Failed to write %s: %s\n", file, strerror(errno));
+bail:
+	if(out){
+		fclose(out);
+	}
+	free(copy);
+	return rv;
+}
+
+#ifdef SIGUSR2
+static void trace_signal(int signum){
+	if(signum == SIGUSR1){
+		trace.enabled = !trace.enabled;
+	}
+	else{
+		trace.dump = 1;
+	}
+}
+#endif
+
+int trace_start(){
+	#ifdef _WIN32
+	LARGE_INTEGER frequency;
+	QueryPerformanceFrequency(&frequency);
+	trace.frequency = frequency.QuadPart;
+	#endif
+
+	#ifdef SIGUSR2
+	//tracing can always be toggled and dumped at runtime
+	signal(SIGUSR1, trace_signal);
+	signal(SIGUSR2, trace_signal);
+	#endif
+
+	if(trace.configured){
+		//set up the main thread ring before entering the main loop
+		if(trace_ring_create()){
+			return 1;
+		}
+		trace.enabled = 1;
+		fprintf(stderr, "Trace: Recording up to %" PRIsize_t " events per thread to %s\n", trace.size, trace.file ? trace.file : TRACE_DEFAULT_FILE);
+	}
+	return 0;
+}
+
+int trace_poll(){
+	if(!trace.dump){
+		return 0;
+	}
+
+	//the dump signal also requests the statistics output, only write a trace file when recording
+	trace.dump = 0;
+	if(__atomic_load_n(&trace.threads, __ATOMIC_ACQUIRE)){
+		trace_dump();
+	}
+	return 1;
+}
+
+void trace_stop(){
+	uint32_t u;
+
+	if(trace.enabled){
+		trace.enabled = 0;
+		trace_dump();
+	}
+
+	for(u = 0; u < min(trace.threads, TRACE_MAX_THREADS); u++){
+		if(trace.ring[u]){
+			memory_free(trace.ring[u]->record);
+			memory_free(trace.ring[u]);
+			trace.ring[u] = NULL;
+		}
+	}
+	trace.threads = 0;
+	local_ring = NULL;
+	free(trace.file);
+	trace.file = NULL;
+}
@@ -0,0 +1,26 @@
+/* Trace file layout, shared with the offline decoder in tools/ */
+#define TRACE_FILE_MAGIC "MMTRACE1"
+
+typedef struct /*_mm_trace_header*/ {
+	char magic[8];
+	uint32_t record_size;
+	uint32_t threads;
+	uint64_t records;
+	uint64_t lost;
+} trace_header;
+
+/* Fixed-size trace record, timestamps in nanoseconds of a monotonic clock */
+typedef struct /*_mm_trace_record*/ {
+	uint64_t time;
+	uint64_t id;
+	uint64_t arg;
+	uint32_t point;
+	uint32_t thread;
+} trace_record;
+
+/* Internal API */
+int trace_configure(char* option, char* value);
+int trace_start();
+/* Returns nonzero if a statistics dump was requested by signal */
+int trace_poll();
+void trace_stop();